@@ -14,6 +14,7 @@
  *            [-makeSCRInput]
  *            [-verbose]
  *            [-pendIOTime=<seconds>]
+ *            [-connectThreads=<integer>]
  * ```
  *
  * @section Options
@@ -24,6 +25,7 @@
  * | `-makeSCRInput`              | Write file that can be used by sddspvasaverestore |
  * | `-verbose`                   | Enables verbose output.                           |
  * | `-pendIOTime`                | Specifies the time to wait for a response.        |
+ * | `-connectThreads`            | Connect in shards on this many threads.           |
  *
  * @copyright
  *   - (c) 2002 The University of Chicago, as Operator of Argonne National Laboratory.
@@ -60,14 +62,16 @@
 #define CLO_PENDIOTIME 2
 #define CLO_MAKE_LOGGER_INPUT 3
 #define CLO_MAKE_SCR_INPUT 4
-#define COMMANDLINE_OPTIONS 5
+#define CLO_CONNECTTHREADS 5
+#define COMMANDLINE_OPTIONS 6
 
 static char *commandline_option[COMMANDLINE_OPTIONS] = {
   (char*)"pipe",
   (char*)"verbose",
   (char*)"pendIOTime",
   (char*)"makeLoggerInput",
-  (char*)"makeSCRInput"
+  (char*)"makeSCRInput",
+  (char*)"connectThreads"
 };
 
 static const char *USAGE = 
@@ -75,7 +79,7 @@ static const char *USAGE =
   "       [-pipe=[input][,output]] \n"
   "       [-makeLoggerInput[=withStorageType]] \n"
   "       [-makeSCRInput] \n"
-  "       [-verbose] [-pendIOTime=<seconds>]\n"
+  "       [-verbose] [-pendIOTime=<seconds>] [-connectThreads=<integer>]\n"
   "\nRequired SDDS columns: ControlName (string)\n"
   "Program by Robert Soliday, ANL\n"
   "Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VERSION_STRING "\n";
@@ -114,6 +118,7 @@ typedef struct
   unsigned long pipeFlags;
   long tmpfile_used;
   double pendIOTime;
+  long connectThreads;
   SDDS_INPUT_DATA_PAGE *inputPage;
   SDDS_OUTPUT_DATA outputData;
   int32_t inputPages;
@@ -185,6 +190,7 @@ int ReadArguments(int argc, char **argv, PROG_DATA *prog_data) {
   prog_data->outputFile = NULL;
   prog_data->pipeFlags = 0;
   prog_data->pendIOTime = .5;
+  prog_data->connectThreads = 1;
 
   SDDS_RegisterProgramName("sddscainfo");
 
@@ -228,6 +234,14 @@ int ReadArguments(int argc, char **argv, PROG_DATA *prog_data) {
       case CLO_MAKE_SCR_INPUT:
         prog_data->makeSCRInput = true;
         break;
+      case CLO_CONNECTTHREADS:
+        if (s_arg[i_arg].n_items != 2 ||
+            !(get_long(&prog_data->connectThreads, s_arg[i_arg].list[1])) ||
+            (prog_data->connectThreads <= 0)) {
+          fprintf(stderr, "invalid -connectThreads syntax\n");
+          return (1);
+        }
+        break;
       }
     } else {
       if (!prog_data->inputFile)
@@ -690,6 +704,8 @@ int ConnectPVs(PVA_OVERALL *pva, PVA_OVERALL *pva_ca, PROG_DATA *prog_data) {
   pva->pvaProvider = freeze(providerNames);
   pva_ca->pvaProvider = freeze(providerNames_ca);
 
+  pva->connectThreads = pva_ca->connectThreads = prog_data->connectThreads;
+  pva->reportConnectProgress = pva_ca->reportConnectProgress = prog_data->verbose;
   ConnectPVA(pva, prog_data->pendIOTime);
   if (pvaThreadSleep(.1) == 1) {
     return (1);
@@ -692,6 +692,9 @@
 #  include <cadef.h>
 #endif
 #include <epicsVersion.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
 #ifdef USE_RUNCONTROL
 #  include <libruncontrol.h>
 #endif
@@ -704,9 +707,6 @@ void interrupt_handler(int sig);
 void interrupt_handler2(int sig);
 void sigint_interrupt_handler(int sig);
 
-#if defined(vxWorks)
-/*#define FLOAT_MATH 1*/
-#endif
 #define CLO_GAIN 0
 #define CLO_TIME_INTERVAL 1
 #define CLO_STEPS 2
@@ -749,7 +749,11 @@ void sigint_interrupt_handler(int sig);
 #define CLO_FILTERFILE 39
 #define CLO_TRIGGERPV 40
 #define CLO_ENDOFLOOPPV 41
-#define COMMANDLINE_OPTIONS 42
+#define CLO_PRECISION 42
+#define CLO_THREADS 43
+#define CLO_LATENCYSTATS 44
+#define CLO_SPARSE 45
+#define COMMANDLINE_OPTIONS 46
 
 #define CLO_READBACKWAVEFORM 0
 #define CLO_OFFSETWAVEFORM 1
@@ -773,6 +777,9 @@ void sigint_interrupt_handler(int sig);
 #define DEFAULT_UPDATE_INTERVAL 1
 #define DEFAULT_TIMEOUT_ERRORS 5
 
+#define KERNEL_PANEL 8    /* rows of the gain matrix interleaved in one panel */
+#define KERNEL_BLOCK 1024 /* columns of the gain matrix per cache block */
+
 #define DESPIKE_AVERAGEOF 0x0001U
 #define DESPIKE_STARTTHRESHOLD 0x0002U
 #define DESPIKE_ENDTHRESHOLD 0x0004U
@@ -790,7 +797,17 @@ typedef struct
   double value, *waveformData;
   /* used with channel access routines to give index via callback: */
   long usrValue, flag, *count;
+  /* latest value delivered by a monitor, see setupPVMonitors */
+  volatile double monitorValue;
+  volatile short monitorState;
+  long monitorTrigger; /* trigger count when the monitored value arrived */
+#if !defined(DBAccess)
+  evid monitorID;
+#endif
 } CHANNEL_INFO;
+#define PV_MONITOR_NONE 0
+#define PV_MONITOR_WAITING 1
+#define PV_MONITOR_VALID 2
 
 typedef struct
 {
@@ -836,6 +853,8 @@ typedef struct
 #endif
 
 /*for datastrobe trigger */
+#define TRIGGER_EVENT_DRIVEN 0x0001UL
+#define TRIGGER_READBACK_TIMEOUT 0x0002UL
 typedef struct
 {
   char *PV;
@@ -847,8 +866,23 @@ typedef struct
   long trigStep; /* trigStep: the Step where trigger occurs */
   long datastrobeMissed;
   long triggerCount, modulus;
+  /* eventDriven: readbacks come from their monitors and the loop does not
+     wait for -interval, so each iteration follows the trigger directly */
+  short eventDriven;
+  /* seconds to wait for the readback monitors to update after the trigger,
+     0 uses the latest monitored values */
+  double readbackTimeout;
+  epicsEventId event; /* signalled by the callback to wake the main loop */
+  epicsEventId readbackEvent; /* signalled when a monitored value arrives */
+  /* the CA callbacks run on their own threads, so the fields they set and
+     the monitored values are only touched with this held */
+  epicsMutexId mutex;
+  long takenCount; /* triggerCount of the trigger the loop is working on */
 } DATASTROBE_TRIGGER;
 void datastrobeTriggerEventHandler(struct event_handler_args event);
+void waitForTrigger(DATASTROBE_TRIGGER *datastrobeTrigger, double timeout);
+short triggerInitialized(DATASTROBE_TRIGGER *datastrobeTrigger);
+long takeTrigger(DATASTROBE_TRIGGER *datastrobeTrigger, long *missed);
 long setupDatastrobeTriggerCallbacks(DATASTROBE_TRIGGER *datastrobeTrigger);
 
 typedef struct
@@ -866,6 +900,8 @@ typedef struct
   DATASTROBE_TRIGGER trigger;
   CHANNEL_INFO *channelInfo, gainPVInfo, intervalPVInfo, averagePVInfo, launcherPVInfo[5], endOfLoopPVInfo;
   double *offsetPVvalue;
+  long singlePrecision, threads;
+  double sparseDensity;
 } LOOP_PARAM;
 
 typedef struct
@@ -880,6 +916,46 @@ typedef struct
   double *readbackValue; /*the index is consistent with that of readbacks */
 } WAVE_FORMS;
 
+/* phases of an iteration timed by the latency histograms */
+#define LATENCY_READ 0
+#define LATENCY_DESPIKE 1
+#define LATENCY_TESTS 2
+#define LATENCY_MULTIPLY 3
+#define LATENCY_FILTER 4
+#define LATENCY_DELTALIMIT 5
+#define LATENCY_WRITE 6
+#define LATENCY_OUTPUT 7
+#define LATENCY_SLEEP 8
+#define LATENCY_ITERATION 9
+#define LATENCY_PHASES 10
+#define LATENCY_DECADE_BINS 10 /* bins per decade */
+#define LATENCY_BINS 80        /* 1 us to 100 s */
+
+typedef struct
+{
+  char *file, *PVprefix;
+  double iterationStart, phaseStart, phaseTime[LATENCY_PHASES];
+  short ran[LATENCY_PHASES];
+  long count[LATENCY_PHASES], histogram[LATENCY_PHASES][LATENCY_BINS];
+  double sum[LATENCY_PHASES], max[LATENCY_PHASES];
+  char **PV;
+  CHANNEL_INFO *PVInfo;
+  double *PVvalue;
+  volatile int dump;
+  short enabled; /* -latencyStats was given */
+} LATENCY_STATS;
+
+/* packed copy of a gain matrix, see setupGainKernel */
+typedef struct
+{
+  long rows, columns, panels, singlePrecision;
+  double *dK, *dx, *dy;
+  float *fK, *fx, *fy;
+  /* compressed sparse row form: dK/fK hold the nonzero elements of each row in
+     column order, rowStart[i] is the index of the first one of row i */
+  long sparse, nonzeros, *rowStart, *columnIndex;
+} GAIN_KERNEL;
+
 typedef struct
 {
   char *file;
@@ -892,6 +968,7 @@ typedef struct
   MATRIX *K;
   MATRIX *aCoef;
   MATRIX *bCoef;
+  GAIN_KERNEL kernel;
 } CORRECTION;
 
 typedef struct
@@ -1012,7 +1089,22 @@ void checkRCParam(SDDS_TABLE *inputPage, char *file);
 void despikeTestValues(TESTS *test, DESPIKE_PARAM *despikeParam, long verbose);
 long checkOutOfRange(TESTS *test, BACKOFF *backoff, STATS *readbackStats, STATS *readbackAdjustedStats, STATS *controlStats, LOOP_PARAM *loopParam, double timeOfDay, long verbose, long warning);
 void apply_filter(CORRECTION *correction, long verbose);
+void setupGainKernel(CORRECTION *correction, LOOP_PARAM *loopParam, long verbose);
+void freeGainKernel(GAIN_KERNEL *kernel);
+void gainKernelMultiply(GAIN_KERNEL *kernel);
+void startGainKernelThreads(long threads);
+void stopGainKernelThreads(void);
+void requestGainKernelStop(void);
 void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correction, CORRECTION *overlapCompensation, long verbose, double pendIOTime);
+void startLatencyIteration(LATENCY_STATS *latency);
+void latencyMark(LATENCY_STATS *latency, long phase);
+void endLatencyIteration(LATENCY_STATS *latency);
+double latencyPercentile(LATENCY_STATS *latency, long phase, double fraction);
+void writeLatencyStats(LATENCY_STATS *latency);
+void setupLatencyPVs(LATENCY_STATS *latency, double pendIOTime);
+void writeLatencyPVs(LATENCY_STATS *latency, double pendIOTime);
+void freeLatencyStats(LATENCY_STATS *latency);
+void latencyDumpHandler(int sig);
 /* return factor which was applied to force the control
    under the limit */
 double applyDeltaLimit(LIMITS *delta, LOOP_PARAM *loopParam, CONTROL_NAME *control, long verbose, long warning);
@@ -1115,6 +1207,12 @@ int runControlPingWhileSleep(double sleepTime);
 long setStringPV(char *PV, char *value, CHANNEL_INFO channelInfo, long exitOnError);
 long setEnumPV(char *PV, long value, CHANNEL_INFO channelInfo, long exitOnError);
 long readEnumPV(char *PV, long *value, CHANNEL_INFO channelInfo, double pendIoTime, long exitOnError);
+void monitoredPVEventHandler(struct event_handler_args event);
+long setupPVMonitors(char **PVs, CHANNEL_INFO *channelInfo, long n);
+void clearPVMonitors(CHANNEL_INFO *channelInfo, long n);
+long readMonitoredPVs(char **PVs, double *value, CHANNEL_INFO *channelInfo, long n, double pendIOTime);
+long readTriggeredPVs(char **PVs, double *value, CHANNEL_INFO *channelInfo, long n, DATASTROBE_TRIGGER *trigger, double pendIOTime);
+void updateMonitoredPVs(double *value, CHANNEL_INFO *channelInfo, long n);
 void oag_ca_exception_handler(struct exception_handler_args args);
 
 /* need to be global because some quantities are used
@@ -1139,12 +1237,15 @@ typedef struct
   LOGHANDLE logHandle;
   long useLogDaemon;
 #endif
+  LATENCY_STATS latency;
   char *pidFile;
   long reparseFromFile;
   int32_t *sortIndex;
   int argc;
   char ***argv;
   volatile int sigint;
+  /* set while FreeEverything runs from a signal handler */
+  volatile int inSignalHandler;
 } SDDSCONTROLLAW_GLOBAL;
 SDDSCONTROLLAW_GLOBAL *sddscontrollawGlobal;
 
@@ -1166,6 +1267,7 @@ int main(int argc, char **argv)
   char *outputRoot = NULL, *compensationOutputFile = NULL;
   long i, outputRow, compensationOutputRow, statsRow, glitchRow, firstTime, icontrol;
   long skipIteration = 0, outOfRange, prevOutOfRange = 0, waveformOutOfRange, testOutOfRange;
+  long missed = 0;
   char *timeStamp = NULL;
   double startTime, startHour, timeOfDay, targetTime, timeLeft, sleepTime = 0;
   BACKOFF backoff;
@@ -1228,7 +1330,11 @@ int main(int argc, char **argv)
     "postChangeExecution",
     "filterFile",
     "triggerPV",
-    "endOfLoopPV"
+    "endOfLoopPV",
+    "precision",
+    "threads",
+    "latencyStats",
+    "sparse"
   };
   char *waveformOption[WAVEFORMOPTIONS] = {
     "readback", "offset", "actuator", "ffSetpoint", "test"};
@@ -1239,7 +1345,7 @@ int main(int argc, char **argv)
        [-generations[=digits=<integer>][,delimiter=<string>][,rowlimit=<number>][,timelimit=<secs>] | \n\
        -dailyFiles] [-controlQuantityDefinition=<file>]\n\
        [-gain={<real-value>|PVname=<name>}]\n\
-       {[-interval={<real-value>|PVname=<name>}] | -triggerPV=<PVname>[,modulus=<integer>]} [-steps=<integer=value>]\n\
+       {[-interval={<real-value>|PVname=<name>}] | -triggerPV=<PVname>[,modulus=<integer>][,eventDriven[,readbackTimeout=<seconds>]]} [-steps=<integer=value>]\n\
        [-updateInterval=<integer=value>]\n\
        [{-integration | -proportional}]\n\
        [-holdPresentValues] [-offsets=<offsetFile>] [-PVOffsets=<filename>] \n\
@@ -1259,7 +1365,9 @@ int main(int argc, char **argv)
        [-servermode=pid=<file>,command=<file>]\n\
        [-controlLogFile=<file>] \n\
        [-glitchLogFile=file=<string>,[readbackRmsThreshold=<value>][,controlRmsThreshold=<value>][,rows=<integer]]\n\
-       [-CASecurityTest] [-waveforms=<filename>,<type>] [-postChangeExecution=<string>] \n\n";
+       [-CASecurityTest] [-waveforms=<filename>,<type>] [-postChangeExecution=<string>] \n\
+       [-precision={single|double}] [-threads=<integer>]\n\
+       [-latencyStats=[file=<filename>][,PVprefix=<string>]] [-sparse=density=<fraction>]\n\n";
   char *USAGE2 = "Perform simple feedback on APS control system process variables using ca calls.\n\
 <inputfile>    gain matrix in sdds format\n\
 <searchPath>   the directory path for the input files.\n\
@@ -1289,7 +1397,15 @@ gain           quantity multiplying the inputfile matrix.\n\
 interval       time interval between each correction.\n\
 triggerPV      Names a process variable that must change to start each\n\
                cycle. If modulus=n is given, only every nth trigger is\n\
-               recognized.\n\
+               recognized. With eventDriven, the readbacks are taken from\n\
+               their monitors instead of being read again, and the loop\n\
+               does not wait for the interval after each correction, so\n\
+               each iteration starts as soon as the trigger arrives.\n\
+               A readback monitor may not have updated yet when the\n\
+               trigger arrives. readbackTimeout waits up to that many\n\
+               seconds for each readback to update after the trigger and\n\
+               reads the ones that did not with a get. Without it the\n\
+               latest monitored values are used.\n\
 steps          total number of corrections.\n\
 postChangeExecution run given execution after changing the setpoints.\n";
 char *USAGE4 = "\
@@ -1393,7 +1509,19 @@ waveforms=<filename>,<type> the waveform file name, and the type of\n\
                MaximumValue and MinimumValue, and one optional short column - Ignore: \n\
                which set the flags of whether ignore the pvs in the waveform. If Ignore column \n\
                does not exist, then the readbacks and controls will consider to be testing pvs \n\
-               in the waveforms. \n\n\
+               in the waveforms. \n\
+precision      arithmetic used for the matrix products; the default is double.\n\
+threads        number of threads sharing the matrix products; the default is 1.\n\
+latencyStats   the time of each phase of every iteration is kept in histograms, which\n\
+               are written to the file on SIGURG and at exit (to stderr if no file\n\
+               is given). With PVprefix the mean, 99th percentile and maximum of each\n\
+               phase are written to <prefix><phase>Mean, P99 and Max every\n\
+               updateInterval steps.\n\
+sparse         the gain matrices are multiplied in compressed sparse row form when the\n\
+               fraction of nonzero elements is at most the given density. The default\n\
+               of 0 always uses the dense product. For finite readbacks the result is\n\
+               identical to the dense product, but a NaN or Inf readback only reaches\n\
+               the controls that have a nonzero gain for it.\n\n\
 Program by Louis Emery, ANL\n\
 Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VERSION_STRING "\n";
 #  ifndef USE_RUNCONTROL
@@ -1409,12 +1537,6 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
   char *commandFile;
 #if defined(vxWorks)
   double wait = 0;
-#endif
-#ifdef DEBUGTIMES
-  int debugTimes = 0;
-  double debugTime[100];
-  for (i = 0; i < 99; i++)
-    debugTime[i] = 0;
 #endif
   outputRoot = NULL;
   caWriteError = 0;
@@ -1482,6 +1604,9 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
   signal(SIGTRAP, interrupt_handler);
   signal(SIGBUS, interrupt_handler);
 #endif
+#if defined(SIGURG)
+  signal(SIGURG, latencyDumpHandler);
+#endif
 
 #if !defined(DBAccess)
 #  ifdef EPICS313
@@ -1749,9 +1874,9 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
 #endif
   }
 
-  if (sddscontrollawGlobal->loopParam.triggerProvided && !sddscontrollawGlobal->loopParam.trigger.initialized) {
+  if (sddscontrollawGlobal->loopParam.triggerProvided && !triggerInitialized(&sddscontrollawGlobal->loopParam.trigger)) {
     fprintf(stderr, "Waiting for trigger connection event\n");
-    while (!sddscontrollawGlobal->loopParam.trigger.initialized) {
+    while (!triggerInitialized(&sddscontrollawGlobal->loopParam.trigger) && !sddscontrollawGlobal->sigint) {
 #ifdef USE_RUNCONTROL
       if (sddscontrollawGlobal->rcParam.PV) {
         if (runControlPingWhileSleep(0.0)) {
@@ -1759,24 +1884,19 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
           FreeEverything();
           return (1);
         }
-      } else
-        oag_ca_pend_event(1.0, &(sddscontrollawGlobal->sigint));
-#else
-    oag_ca_pend_event(1.0, &(sddscontrollawGlobal->sigint));
+      }
 #endif
+      waitForTrigger(&sddscontrollawGlobal->loopParam.trigger, 1.0);
     }
   }
   
   for (sddscontrollawGlobal->loopParam.step[0] = 0; sddscontrollawGlobal->loopParam.step[0] < sddscontrollawGlobal->loopParam.steps; sddscontrollawGlobal->loopParam.step[0]++) {
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[0] = getTimeInSecs();
-#endif
+    startLatencyIteration(&sddscontrollawGlobal->latency);
 
     if (sddscontrollawGlobal->loopParam.triggerProvided) {
       if (verbose)
         fprintf(stderr, "Waiting for trigger event\n");
-      while (!sddscontrollawGlobal->loopParam.trigger.triggered) {
+      while (!takeTrigger(&sddscontrollawGlobal->loopParam.trigger, &missed) && !sddscontrollawGlobal->sigint) {
 #ifdef USE_RUNCONTROL
         if (sddscontrollawGlobal->rcParam.PV) {
           if (runControlPingWhileSleep(0.0)) {
@@ -1784,17 +1904,19 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
             FreeEverything();
             return (1);
           }
-        } else
-          oag_ca_pend_event(0.001, &(sddscontrollawGlobal->sigint));
-#else
-        oag_ca_pend_event(0.001, &(sddscontrollawGlobal->sigint));
+        }
 #endif
+        waitForTrigger(&sddscontrollawGlobal->loopParam.trigger, 0.1);
+      }
+      if (sddscontrollawGlobal->sigint) {
+        FreeEverything();
+        return (1);
       }
-      sddscontrollawGlobal->loopParam.trigger.triggered = 0;
+      latencyMark(&sddscontrollawGlobal->latency, LATENCY_SLEEP);
       if (verbose)
-        fprintf(stderr, "Trigger event received\n");
+        fprintf(stderr, "Trigger event received (%ld missed so far)\n", missed);
       if (sddscontrollawGlobal->loopParam.trigger.modulus>1 &&
-          sddscontrollawGlobal->loopParam.trigger.triggerCount%sddscontrollawGlobal->loopParam.trigger.modulus!=0) {
+          sddscontrollawGlobal->loopParam.trigger.takenCount%sddscontrollawGlobal->loopParam.trigger.modulus!=0) {
         if (verbose)
           fprintf(stderr, "Trigger event skipped due to modulus setting of %ld\n",
                   sddscontrollawGlobal->loopParam.trigger.modulus);
@@ -1833,20 +1955,24 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
 #endif
     if (sddscontrollawGlobal->loopParam.averagePV) {
       pre_n = aveParam.n;
-      readPVs(&sddscontrollawGlobal->loopParam.averagePV, &aveParam.n2, &sddscontrollawGlobal->loopParam.averagePVInfo, 1, NULL, pendIOTime);
+      readMonitoredPVs(&sddscontrollawGlobal->loopParam.averagePV, &aveParam.n2, &sddscontrollawGlobal->loopParam.averagePVInfo, 1, pendIOTime);
       aveParam.n = round(aveParam.n2);
     }
     if (sddscontrollawGlobal->loopParam.intervalPV) {
-      readPVs(&sddscontrollawGlobal->loopParam.intervalPV, &sddscontrollawGlobal->loopParam.interval, &sddscontrollawGlobal->loopParam.intervalPVInfo, 1, NULL, pendIOTime);
+      readMonitoredPVs(&sddscontrollawGlobal->loopParam.intervalPV, &sddscontrollawGlobal->loopParam.interval, &sddscontrollawGlobal->loopParam.intervalPVInfo, 1, pendIOTime);
     }
     if (sddscontrollawGlobal->despikeParam.rampThresholdPV && sddscontrollawGlobal->despikeParam.startThreshold != sddscontrollawGlobal->despikeParam.endThreshold) {
-      readEnumPV(sddscontrollawGlobal->despikeParam.rampThresholdPV, &sddscontrollawGlobal->despikeParam.reramp, sddscontrollawGlobal->despikeParam.rampThresholdPVInfo, pendIOTime, 0);
+      if (sddscontrollawGlobal->despikeParam.rampThresholdPVInfo.monitorState == PV_MONITOR_VALID)
+        sddscontrollawGlobal->despikeParam.reramp = (long)sddscontrollawGlobal->despikeParam.rampThresholdPVInfo.monitorValue;
+      else
+        readEnumPV(sddscontrollawGlobal->despikeParam.rampThresholdPV, &sddscontrollawGlobal->despikeParam.reramp, sddscontrollawGlobal->despikeParam.rampThresholdPVInfo, pendIOTime, 0);
       if (sddscontrollawGlobal->despikeParam.reramp) {
         if (verbose)
           fprintf(stderr, "Re-ramp despike threshold.\n");
         sddscontrollawGlobal->despikeParam.reramp = 0;
         sddscontrollawGlobal->despikeParam.threshold = sddscontrollawGlobal->despikeParam.startThreshold - sddscontrollawGlobal->despikeParam.deltaThreshold;
         setEnumPV(sddscontrollawGlobal->despikeParam.rampThresholdPV, sddscontrollawGlobal->despikeParam.reramp, sddscontrollawGlobal->despikeParam.rampThresholdPVInfo, 0);
+        sddscontrollawGlobal->despikeParam.rampThresholdPVInfo.monitorValue = 0;
         rampDone = 0;
       }
     }
@@ -1860,20 +1986,17 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
       if (sddscontrollawGlobal->despikeParam.thresholdPV) {
         /* send the ramped value to the despiking PV */
         setPVs(&sddscontrollawGlobal->despikeParam.thresholdPV, &sddscontrollawGlobal->despikeParam.threshold, &sddscontrollawGlobal->despikeParam.thresholdPVInfo, 1, pendIOTime);
+        updateMonitoredPVs(&sddscontrollawGlobal->despikeParam.threshold, &sddscontrollawGlobal->despikeParam.thresholdPVInfo, 1);
       }
     }
 
     if (verbose)
       fprintf(stderr, "Despike threshold %f\n", sddscontrollawGlobal->despikeParam.threshold);
     if (sddscontrollawGlobal->despikeParam.thresholdPV) {
-      readPVs(&sddscontrollawGlobal->despikeParam.thresholdPV, &sddscontrollawGlobal->despikeParam.threshold, &sddscontrollawGlobal->despikeParam.thresholdPVInfo, 1, NULL, pendIOTime);
+      readMonitoredPVs(&sddscontrollawGlobal->despikeParam.thresholdPV, &sddscontrollawGlobal->despikeParam.threshold, &sddscontrollawGlobal->despikeParam.thresholdPVInfo, 1, pendIOTime);
     }
     if (sddscontrollawGlobal->despikeParam.threshold < 0)
       sddscontrollawGlobal->despikeParam.threshold = 0;
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[1] = getTimeInSecs();
-#endif
     if ((sddscontrollawGlobal->loopParam.intervalPV) || (sddscontrollawGlobal->loopParam.averagePV)) {
       if ((pre_n > 1) && (!sddscontrollawGlobal->loopParam.intervalPV))
         sddscontrollawGlobal->loopParam.interval += (pre_n - 1) * aveParam.interval;
@@ -1919,19 +2042,11 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
       if (verbose)
         fprintf(stderr, "average interval time: %f\n\n", averageTime);
     }
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[2] = getTimeInSecs();
-#endif
     if (getReadbackValues(readback, &aveParam, &sddscontrollawGlobal->loopParam, &readbackStats, &readbackDeltaStats, &sddscontrollawGlobal->readbackWaveforms, &sddscontrollawGlobal->offsetWaveforms, verbose, pendIOTime)) {
       FreeEverything();
       SDDS_Bomb("Error code return from getReadbackValues.");
     }
     sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[3] = getTimeInSecs();
-#endif
     if (sddscontrollawGlobal->overlapCompensation.file) {
       if (getReadbackValues(readbackComp, &aveParam, &sddscontrollawGlobal->loopParam, &readbackCompStats, &readbackCompDeltaStats, &sddscontrollawGlobal->controlWaveforms, NULL, verbose, pendIOTime)) {
         FreeEverything();
@@ -1941,20 +2056,14 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
 
     sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
     timeOfDay = startHour + sddscontrollawGlobal->loopParam.elapsedTime[0] / 3600.0;
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[4] = getTimeInSecs();
-#endif
+    latencyMark(&sddscontrollawGlobal->latency, LATENCY_READ);
 
     adjustReadbacks(readback, &sddscontrollawGlobal->readbackLimits, &sddscontrollawGlobal->despikeParam, &readbackAdjustedStats, verbose);
     for (i = 0; i < readback->n; i++)
       if (isnan(readback->value[0][i]))
         fprintf(stderr, "Error the value of PV %s (index=%ld) is not a number (nan)\n", readback->controlName[i], i);
     sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[5] = getTimeInSecs();
-#endif
+    latencyMark(&sddscontrollawGlobal->latency, LATENCY_DESPIKE);
 #ifdef USE_RUNCONTROL
     if (sddscontrollawGlobal->rcParam.PV) {
       if (getTimeInSecs() >= lastRCPingTime + 2) {
@@ -1982,10 +2091,6 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
       if (warning || verbose)
         fprintf(stderr, "Readback values are less than the action limit. Skipping correction.\n");
     }
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[6] = getTimeInSecs();
-#endif
 
     sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
     if (getControlDevices(control, &controlStats, &sddscontrollawGlobal->loopParam, &sddscontrollawGlobal->controlWaveforms, verbose, pendIOTime)) {
@@ -1993,20 +2098,13 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
       SDDS_Bomb("Error code return from getControlDevices");
     }
     sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[7] = getTimeInSecs();
-#endif
     if (sddscontrollawGlobal->overlapCompensation.file) {
       if (getControlDevices(controlComp, &controlCompStats, &sddscontrollawGlobal->loopParam, &sddscontrollawGlobal->ffSetpointWaveforms, verbose, pendIOTime)) {
         FreeEverything();
         SDDS_Bomb("Error code return from getControlDevices");
       }
     }
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[8] = getTimeInSecs();
-#endif
+    latencyMark(&sddscontrollawGlobal->latency, LATENCY_READ);
 #ifdef USE_RUNCONTROL
     if (sddscontrollawGlobal->rcParam.PV) {
       if (getTimeInSecs() >= lastRCPingTime + 2) {
@@ -2038,30 +2136,14 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
             pingSkipIteration = 1;
         }
       }
-#endif
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[9] = getTimeInSecs();
 #endif
       despikeTestValues(&sddscontrollawGlobal->test, &sddscontrollawGlobal->despikeParam, verbose);
       prevOutOfRange = outOfRange;
 
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[10] = getTimeInSecs();
-#endif
       if (sddscontrollawGlobal->test.file)
         testOutOfRange = checkOutOfRange(&sddscontrollawGlobal->test, &backoff, &readbackStats, &readbackAdjustedStats, &controlStats, &sddscontrollawGlobal->loopParam, timeOfDay, verbose, warning);
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[11] = getTimeInSecs();
-#endif
       sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
       waveformOutOfRange = CheckWaveformTest(&sddscontrollawGlobal->waveform_tests, &backoff, &sddscontrollawGlobal->loopParam, &sddscontrollawGlobal->despikeParam, verbose, warning, pendIOTime);
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[12] = getTimeInSecs();
-#endif
       if (waveformOutOfRange || testOutOfRange) {
         /*if out of range, set the control delta to 0 */
         outOfRange = 1;
@@ -2072,10 +2154,6 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
         calcControlDeltaStats(control, &controlStats, &controlDeltaStats);
       } else
         outOfRange = 0;
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[13] = getTimeInSecs();
-#endif
       if (outOfRange) {
         if (prevOutOfRange == 1) {
           if (sddscontrollawGlobal->loopParam.launcherPV[0]) {
@@ -2180,10 +2258,8 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
      \*********************/
     /* this skips an iteration if the previous step
          was out of range and averaging is requested. */
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[14] = getTimeInSecs();
-#endif
+    if (sddscontrollawGlobal->test.file || sddscontrollawGlobal->waveform_tests.waveformTests)
+      latencyMark(&sddscontrollawGlobal->latency, LATENCY_TESTS);
     if ((!(outOfRange || ((aveParam.n > 1) && prevOutOfRange))) && !(pingSkipIteration)) {
       if (prevOutOfRange && (sddscontrollawGlobal->test.holdOff || sddscontrollawGlobal->waveform_tests.holdOffPresent)) {
         sleepTime = MAX(sddscontrollawGlobal->test.longestHoldOff, sddscontrollawGlobal->waveform_tests.longestHoldOff);
@@ -2199,6 +2275,7 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
 #else
         oag_ca_pend_event(sleepTime, &(sddscontrollawGlobal->sigint));
 #endif
+        latencyMark(&sddscontrollawGlobal->latency, LATENCY_SLEEP);
         
         /* Re-check test conditions after holdoff sleep to ensure safety */
         if (sddscontrollawGlobal->test.file) {
@@ -2210,6 +2287,7 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
           testOutOfRange = checkOutOfRange(&sddscontrollawGlobal->test, &backoff, &readbackStats, &readbackAdjustedStats, &controlStats, &sddscontrollawGlobal->loopParam, timeOfDay, verbose, warning);
         }
         waveformOutOfRange = CheckWaveformTest(&sddscontrollawGlobal->waveform_tests, &backoff, &sddscontrollawGlobal->loopParam, &sddscontrollawGlobal->despikeParam, verbose, warning, pendIOTime);
+        latencyMark(&sddscontrollawGlobal->latency, LATENCY_TESTS);
         
         if (waveformOutOfRange || testOutOfRange) {
           /* Tests failed again during/after holdoff - abort control law execution */
@@ -2228,31 +2306,15 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
             fprintf(stderr, "Tests still passing after holdoff - proceeding with control law.\n");
         }
       }
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[15] = getTimeInSecs();
-#endif
       sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
       if (verbose)
         fprintf(stderr, "Calling controlLaw function at %f seconds.\n", sddscontrollawGlobal->loopParam.elapsedTime[0]);
       controlLaw(skipIteration, &sddscontrollawGlobal->loopParam, &sddscontrollawGlobal->correction, &sddscontrollawGlobal->overlapCompensation, verbose, pendIOTime);
 
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[16] = getTimeInSecs();
-#endif
       /* for now compensation doesn't work with applyDeltaLimit */
       factor = applyDeltaLimit(&sddscontrollawGlobal->delta, &sddscontrollawGlobal->loopParam, control, verbose, warning);
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[17] = getTimeInSecs();
-#endif
 
       calcControlDeltaStats(control, &controlStats, &controlDeltaStats);
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[18] = getTimeInSecs();
-#endif
       if (sddscontrollawGlobal->overlapCompensation.file) {
         if (factor < 1) {
           for (i = 0; i < controlComp->n; i++) {
@@ -2263,10 +2325,7 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
         }
         calcControlDeltaStats(controlComp, &controlCompStats, &controlCompDeltaStats);
       }
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[19] = getTimeInSecs();
-#endif
+      latencyMark(&sddscontrollawGlobal->latency, LATENCY_DELTALIMIT);
 
       if (!sddscontrollawGlobal->loopParam.dryRun) {
         sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
@@ -2276,10 +2335,6 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
         }
         caWriteError = 0;
 
-#ifdef DEBUGTIMES
-        if (debugTimes)
-          debugTime[20] = getTimeInSecs();
-#endif
         if (testCASecurity && (caWriteError = CheckCAWritePermissionMod(control->controlName, control->channelInfo, control->n))) {
           fprintf(stderr, "Write access denied to at least one PV.\n");
 
@@ -2324,10 +2379,6 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
           }
 #endif
         }
-#ifdef DEBUGTIMES
-        if (debugTimes)
-          debugTime[21] = getTimeInSecs();
-#endif
         if (!caWriteError) {
           sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
           if (verbose) {
@@ -2351,10 +2402,6 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
               return (1);
             }
           }
-#ifdef DEBUGTIMES
-          if (debugTimes)
-            debugTime[22] = getTimeInSecs();
-#endif
           if (sddscontrollawGlobal->overlapCompensation.file) {
             sddscontrollawGlobal->loopParam.elapsedTime[0] = (sddscontrollawGlobal->loopParam.epochTime[0] = getTimeInSecs()) - startTime;
             if (verbose) {
@@ -2371,20 +2418,14 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
               }
             }
           }
-#ifdef DEBUGTIMES
-          if (debugTimes)
-            debugTime[23] = getTimeInSecs();
-#endif
         }
       }
+      if (!sddscontrollawGlobal->loopParam.dryRun)
+        latencyMark(&sddscontrollawGlobal->latency, LATENCY_WRITE);
       if (sddscontrollawGlobal->controlLogFile) {
         getTimeBreakdown(NULL, NULL, NULL, NULL, NULL, NULL, &timeStamp);
         logActuator(sddscontrollawGlobal->controlLogFile, control, timeStamp);
       }
-#ifdef DEBUGTIMES
-      if (debugTimes)
-        debugTime[24] = getTimeInSecs();
-#endif
       if (verbose) {
         fprintf(stderr, "Stats                     Average       rms        "
                         "mad     Largest\n"
@@ -2450,16 +2491,13 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
     }
     writeToStatsFile(sddscontrollawGlobal->statsFile, &sddscontrollawGlobal->statsPage, &statsRow, &sddscontrollawGlobal->loopParam, &readbackStats, &readbackDeltaStats, &controlStats, &controlDeltaStats);
     writeToGlitchFile(&sddscontrollawGlobal->glitchParam, &sddscontrollawGlobal->glitchPage, &glitchRow, &sddscontrollawGlobal->loopParam, &readbackAdjustedStats, &controlDeltaStats, &sddscontrollawGlobal->correction, &sddscontrollawGlobal->overlapCompensation, &sddscontrollawGlobal->test);
+    latencyMark(&sddscontrollawGlobal->latency, LATENCY_OUTPUT);
 
   skip_control_law:
     /*******************************\
        * pause for iteration interval *
      \******************************/
     /* calculate time that is left to the iteration */
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[25] = getTimeInSecs();
-#endif
     timeLeft = targetTime - getTimeInSecs();
     if (timeLeft < 0) {
       /* if the runcontrol PV had been paused for a long time, say, the target
@@ -2470,6 +2508,11 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
       targetTime = getTimeInSecs();
       timeLeft = 0;
     }
+    if (sddscontrollawGlobal->loopParam.triggerProvided && sddscontrollawGlobal->loopParam.trigger.eventDriven) {
+      /* the next trigger paces the loop */
+      targetTime = getTimeInSecs();
+      timeLeft = 0;
+    }
     if (testOutOfRange)
       sleepTime = MAX(sddscontrollawGlobal->test.longestSleep, sddscontrollawGlobal->loopParam.interval);
     if (waveformOutOfRange)
@@ -2504,10 +2547,7 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
     oag_ca_pend_event((outOfRange ? sleepTime : timeLeft), &(sddscontrollawGlobal->sigint));
 #  endif
 #endif
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[26] = getTimeInSecs();
-#endif
+    latencyMark(&sddscontrollawGlobal->latency, LATENCY_SLEEP);
     if (verbose)
       fprintf(stderr, "\n");
     if (sddscontrollawGlobal->reparseFromFile) {
@@ -2600,19 +2640,14 @@ Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VER
       if (generations.timeLimit > 0 && getTimeInSecs() > generations.timeStop)
         newFileCountdown = 0;
     }
-#ifdef DEBUGTIMES
-    if (debugTimes)
-      debugTime[27] = getTimeInSecs();
-    if (sddscontrollawGlobal->loopParam.step[0] == 19)
-      debugTimes = 1;
-    if (sddscontrollawGlobal->loopParam.step[0] == 20) {
-      debugTimes = 0;
-      for (i = 0; i < 28; i++) {
-        if (debugTime[i] != 0)
-          fprintf(stderr, "debug time #%ld = %f\n", i, debugTime[i] - debugTime[0]);
-      }
+    endLatencyIteration(&sddscontrollawGlobal->latency);
+    if (sddscontrollawGlobal->latency.dump) {
+      sddscontrollawGlobal->latency.dump = 0;
+      if (sddscontrollawGlobal->latency.enabled)
+        writeLatencyStats(&sddscontrollawGlobal->latency);
     }
-#endif
+    if ((sddscontrollawGlobal->loopParam.updateInterval > 0) && !(sddscontrollawGlobal->loopParam.step[0] % sddscontrollawGlobal->loopParam.updateInterval))
+      writeLatencyPVs(&sddscontrollawGlobal->latency, pendIOTime);
     if (sddscontrollawGlobal->loopParam.endOfLoopPV) {
       if (ca_state(sddscontrollawGlobal->loopParam.endOfLoopPVInfo.channelID) != cs_conn) {
         fprintf(stderr, "Warning: end-of-loop PV %s not connected\n", sddscontrollawGlobal->loopParam.endOfLoopPV);
@@ -2704,6 +2739,172 @@ long readPVs(char **PVs, double *value, CHANNEL_INFO *channelInfo, long n, AVERA
   return 0;
 }
 
+/* Loop tunables (gain, interval, averaging, despike threshold) are monitored
+   so that each iteration reads the latest value from memory instead of doing
+   a ca_get/ca_pend_io round trip. */
+void monitoredPVEventHandler(struct event_handler_args event) {
+  CHANNEL_INFO *channelInfo;
+  DATASTROBE_TRIGGER *trigger = &sddscontrollawGlobal->loopParam.trigger;
+
+  channelInfo = (CHANNEL_INFO *)event.usr;
+  if (event.status != ECA_NORMAL || !event.dbr)
+    return;
+  if (!trigger->mutex) {
+    channelInfo->monitorValue = *((double *)event.dbr);
+    channelInfo->monitorState = PV_MONITOR_VALID;
+    return;
+  }
+  /* stamped with the trigger count, so readTriggeredPVs can tell whether
+     the value arrived after the trigger the loop is working on */
+  epicsMutexLock(trigger->mutex);
+  channelInfo->monitorValue = *((double *)event.dbr);
+  channelInfo->monitorState = PV_MONITOR_VALID;
+  channelInfo->monitorTrigger = trigger->triggerCount;
+  epicsMutexUnlock(trigger->mutex);
+  if (trigger->readbackEvent)
+    epicsEventSignal(trigger->readbackEvent);
+}
+
+long setupPVMonitors(char **PVs, CHANNEL_INFO *channelInfo, long n) {
+  long i;
+
+  for (i = 0; i < n; i++)
+    channelInfo[i].monitorState = PV_MONITOR_NONE;
+#if !defined(DBAccess)
+  for (i = 0; i < n; i++) {
+    if (ca_add_masked_array_event(DBR_DOUBLE, 1, channelInfo[i].channelID,
+                                  monitoredPVEventHandler, (void *)&channelInfo[i],
+                                  (ca_real)0, (ca_real)0, (ca_real)0, &channelInfo[i].monitorID, DBE_VALUE) != ECA_NORMAL) {
+      fprintf(stderr, "warning: unable to monitor %s, it will be read every iteration\n", PVs[i]);
+      continue;
+    }
+    channelInfo[i].monitorState = PV_MONITOR_WAITING;
+  }
+  ca_poll();
+#endif
+  return 0;
+}
+
+/* Returns the monitored values, falling back to a ca_get for any channel
+   that is not monitored, has not delivered a value since trigger count
+   since, or is disconnected. The fallback gets share a single ca_pend_io. */
+static long readMonitoredPVsSince(char **PVs, double *value, CHANNEL_INFO *channelInfo, long n, long since, double pendIOTime) {
+#if defined(DBAccess)
+  return readPVs(PVs, value, channelInfo, n, NULL, pendIOTime);
+#else
+  long i, missing = 0;
+  epicsMutexId mutex = sddscontrollawGlobal->loopParam.trigger.mutex;
+
+  if (mutex)
+    epicsMutexLock(mutex);
+  for (i = 0; i < n; i++) {
+    channelInfo[i].flag = 0;
+    if (channelInfo[i].monitorState == PV_MONITOR_VALID && channelInfo[i].monitorTrigger >= since) {
+      value[i] = channelInfo[i].monitorValue;
+      continue;
+    }
+    /* flag marks the channels whose value comes from a ca_get */
+    channelInfo[i].flag = 1;
+  }
+  if (mutex)
+    epicsMutexUnlock(mutex);
+  for (i = 0; i < n; i++) {
+    if (!channelInfo[i].flag && ca_state(channelInfo[i].channelID) == cs_conn)
+      continue;
+    if (ca_state(channelInfo[i].channelID) != cs_conn) {
+      fprintf(stderr, "Error, no connection for %s\n", PVs[i]);
+      FreeEverything();
+      exit(1);
+    }
+    if (ca_get(DBR_DOUBLE, channelInfo[i].channelID, &channelInfo[i].value) != ECA_NORMAL) {
+      fprintf(stderr, "error: unable to get value for %s.\n", PVs[i]);
+      FreeEverything();
+      exit(1);
+    }
+    channelInfo[i].flag = 1;
+    missing++;
+  }
+  if (missing && ca_pend_io(pendIOTime) != ECA_NORMAL) {
+    fprintf(stderr, "pendIOerror: unable to get PV values\n");
+    FreeEverything();
+    exit(1);
+  }
+  for (i = 0; i < n; i++) {
+    if (channelInfo[i].flag) {
+      value[i] = channelInfo[i].value;
+      channelInfo[i].flag = 0;
+    }
+    if (isnan(value[i]) || isinf(value[i])) {
+      fprintf(stderr, "Error: value for %s is NaN or Inf\n", PVs[i]);
+      FreeEverything();
+      exit(1);
+    }
+  }
+  return 0;
+#endif
+}
+
+long readMonitoredPVs(char **PVs, double *value, CHANNEL_INFO *channelInfo, long n, double pendIOTime) {
+  return readMonitoredPVsSince(PVs, value, channelInfo, n, 0, pendIOTime);
+}
+
+/* The trigger and the readbacks are served by different CA circuits, so the
+   readback monitors may not have updated yet when the trigger is taken.
+   With a readbackTimeout, waits that long for every monitored readback to
+   deliver a value newer than the trigger and reads the rest with ca_get.
+   Without one, the latest monitored values are used. */
+long readTriggeredPVs(char **PVs, double *value, CHANNEL_INFO *channelInfo, long n, DATASTROBE_TRIGGER *trigger, double pendIOTime) {
+  double timeLeft, deadline;
+  long i, waiting;
+
+  if (trigger->readbackTimeout <= 0 || !trigger->mutex)
+    return readMonitoredPVsSince(PVs, value, channelInfo, n, 0, pendIOTime);
+  deadline = getTimeInSecs() + trigger->readbackTimeout;
+  while (1) {
+    waiting = 0;
+    epicsMutexLock(trigger->mutex);
+    for (i = 0; i < n; i++) {
+      if (channelInfo[i].monitorState == PV_MONITOR_VALID && channelInfo[i].monitorTrigger < trigger->takenCount) {
+        waiting = 1;
+        break;
+      }
+    }
+    epicsMutexUnlock(trigger->mutex);
+    timeLeft = deadline - getTimeInSecs();
+    if (!waiting || timeLeft <= 0)
+      break;
+    epicsEventWaitWithTimeout(trigger->readbackEvent, timeLeft);
+  }
+  return readMonitoredPVsSince(PVs, value, channelInfo, n, trigger->takenCount, pendIOTime);
+}
+
+void clearPVMonitors(CHANNEL_INFO *channelInfo, long n) {
+  long i;
+
+  for (i = 0; i < n; i++) {
+#if !defined(DBAccess)
+    if (channelInfo[i].monitorState != PV_MONITOR_NONE)
+      ca_clear_subscription(channelInfo[i].monitorID);
+#endif
+    channelInfo[i].monitorState = PV_MONITOR_NONE;
+  }
+}
+
+/* Keeps the cache consistent with a value this program has just written,
+   so that it is not overridden by a monitor update that is still in flight. */
+void updateMonitoredPVs(double *value, CHANNEL_INFO *channelInfo, long n) {
+  long i;
+  epicsMutexId mutex = sddscontrollawGlobal->loopParam.trigger.mutex;
+
+  if (mutex)
+    epicsMutexLock(mutex);
+  for (i = 0; i < n; i++)
+    if (channelInfo[i].monitorState == PV_MONITOR_VALID)
+      channelInfo[i].monitorValue = value[i];
+  if (mutex)
+    epicsMutexUnlock(mutex);
+}
+
 long CheckCAWritePermissionMod(char **PVs, CHANNEL_INFO *channelInfo, long n) {
 #if defined(DBAccess)
   return 0;
@@ -2922,6 +3123,7 @@ void interrupt_handler()
 void interrupt_handler(int sig)
 #endif
 {
+  sddscontrollawGlobal->inSignalHandler = 1;
   FreeEverything();
   exit(1);
 }
@@ -4499,6 +4701,8 @@ void getInitialValues(CORRECTION *correction, AVERAGE_PARAM *aveParam, LOOP_PARA
     }
     SetupRawCAConnection(readback->controlName, readback->channelInfo, readback->n, pendIOTime);
     readPVs(readback->controlName, readback->value[0], readback->channelInfo, readback->n, aveParam, pendIOTime);
+    if (loopParam->triggerProvided && loopParam->trigger.eventDriven)
+      setupPVMonitors(readback->controlName, readback->channelInfo, readback->n);
   }
   for (i = 0; i < readback->n; i++)
     if (isnan(readback->value[0][i]))
@@ -4573,6 +4777,9 @@ long getReadbackValues(CONTROL_NAME *readback, AVERAGE_PARAM *aveParam, LOOP_PAR
       return 1;
     for (i = 0; i < readback->n; i++)
       readback->value[0][i] = readbackWaveforms->readbackValue[i];
+  } else if (loopParam->triggerProvided && loopParam->trigger.eventDriven && (!aveParam || aveParam->n <= 1)) {
+    /* use the values delivered with the trigger rather than reading them again */
+    readTriggeredPVs(readback->controlName, readback->value[0], readback->channelInfo, readback->n, &loopParam->trigger, pendIOTime);
   } else {
     readPVs(readback->controlName, readback->value[0], readback->channelInfo, readback->n, aveParam, pendIOTime);
   }
@@ -4961,18 +5168,16 @@ long checkOutOfRange(TESTS *test, BACKOFF *backoff, STATS *readbackStats, STATS
   for (i = 0; i < control->n; i++) {
     control->historyFiltered->a[0][i] = 0;
     for (k = 1; k <= aorder; k++) {
-#ifdef FLOAT_MATH
-      control->historyFiltered->a[0][i] -= ((float)A->a[k][i]) * ((float)control->historyFiltered->a[k][i]);
-#else
-      control->historyFiltered->a[0][i] -= A->a[k][i] * control->historyFiltered->a[k][i];
-#endif
+      if (correction->kernel.singlePrecision)
+        control->historyFiltered->a[0][i] -= ((float)A->a[k][i]) * ((float)control->historyFiltered->a[k][i]);
+      else
+        control->historyFiltered->a[0][i] -= A->a[k][i] * control->historyFiltered->a[k][i];
     }
     for (k = 0; k <= border; k++) {
-#ifdef FLOAT_MATH
-      control->historyFiltered->a[0][i] += ((float)B->a[k][i]) * ((float)control->history->a[k][i]);
-#else
-      control->historyFiltered->a[0][i] += B->a[k][i] * control->history->a[k][i];
-#endif
+      if (correction->kernel.singlePrecision)
+        control->historyFiltered->a[0][i] += ((float)B->a[k][i]) * ((float)control->history->a[k][i]);
+      else
+        control->historyFiltered->a[0][i] += B->a[k][i] * control->history->a[k][i];
     }
     control->historyFiltered->a[0][i] /= A->a[0][i];
     /*    if( verbose ) {
@@ -5005,24 +5210,526 @@ long checkOutOfRange(TESTS *test, BACKOFF *backoff, STATS *readbackStats, STATS
      control->initial[0], control->old[0], control->value[0][0]); */
 }
 
+/* The gain matrices are copied into a contiguous buffer of panels of KERNEL_PANEL rows,
+   stored column by column, so the inner loop of the product runs over the rows of a
+   panel and is vectorized by the compiler. Each row still sums its terms in column order,
+   so the result is the same as the row by row product. The columns are processed in
+   blocks of KERNEL_BLOCK so the part of the readback vector in use stays in cache, and
+   the panels can be shared among -threads worker threads.
+   When few elements are nonzero (-sparse) the matrix is stored in compressed sparse row
+   form instead. The nonzero elements are still summed in column order, so for finite
+   readbacks the result is the same as the dense product. The skipped zero elements
+   would have turned a NaN or Inf readback into NaN, so the two differ for such input. */
+typedef struct
+{
+  GAIN_KERNEL *kernel;
+  long panel0, panel1, stop;
+  epicsEventId start, done;
+} KERNEL_WORKER;
+
+static KERNEL_WORKER *kernelWorker = NULL;
+static long kernelWorkers = 0;
+/* kernelBusy is set while the workers share a product. A signal handler must not wait for
+   the workers or free the buffers they use, so it only sets kernelStopRequested and the
+   workers are stopped once the product is complete. */
+static volatile int kernelBusy = 0;
+static volatile sig_atomic_t kernelStopRequested = 0;
+
+void freeGainKernel(GAIN_KERNEL *kernel) {
+  if (kernelBusy)
+    return;
+  if (kernel->dK)
+    free(kernel->dK);
+  if (kernel->dx)
+    free(kernel->dx);
+  if (kernel->dy)
+    free(kernel->dy);
+  if (kernel->fK)
+    free(kernel->fK);
+  if (kernel->fx)
+    free(kernel->fx);
+  if (kernel->fy)
+    free(kernel->fy);
+  if (kernel->rowStart)
+    free(kernel->rowStart);
+  if (kernel->columnIndex)
+    free(kernel->columnIndex);
+  kernel->dK = kernel->dx = kernel->dy = NULL;
+  kernel->fK = kernel->fx = kernel->fy = NULL;
+  kernel->rowStart = kernel->columnIndex = NULL;
+  kernel->rows = kernel->columns = kernel->panels = 0;
+  kernel->sparse = kernel->nonzeros = 0;
+}
+
+static void setupSparseGainKernel(GAIN_KERNEL *kernel, MATRIX *K) {
+  long i, j, k;
+
+  kernel->sparse = 1;
+  kernel->rowStart = malloc(sizeof(long) * (kernel->rows + 1));
+  kernel->columnIndex = malloc(sizeof(long) * (kernel->nonzeros + 1));
+  if (kernel->singlePrecision) {
+    kernel->fK = malloc(sizeof(float) * (kernel->nonzeros + 1));
+    kernel->fx = malloc(sizeof(float) * (kernel->columns + 1));
+    kernel->fy = malloc(sizeof(float) * (kernel->panels * KERNEL_PANEL + 1));
+  } else {
+    kernel->dK = malloc(sizeof(double) * (kernel->nonzeros + 1));
+    kernel->dx = malloc(sizeof(double) * (kernel->columns + 1));
+    kernel->dy = malloc(sizeof(double) * (kernel->panels * KERNEL_PANEL + 1));
+  }
+  if (!kernel->rowStart || !kernel->columnIndex ||
+      (kernel->singlePrecision ? (!kernel->fK || !kernel->fx || !kernel->fy) : (!kernel->dK || !kernel->dx || !kernel->dy))) {
+    fprintf(stderr, "memory allocation failure\n");
+    FreeEverything();
+    exit(1);
+  }
+  k = 0;
+  for (i = 0; i < kernel->rows; i++) {
+    kernel->rowStart[i] = k;
+    for (j = 0; j < kernel->columns; j++) {
+      if (kernel->singlePrecision) {
+        if ((float)K->a[i][j] == 0)
+          continue;
+        kernel->fK[k] = (float)K->a[i][j];
+      } else {
+        if (K->a[i][j] == 0)
+          continue;
+        kernel->dK[k] = K->a[i][j];
+      }
+      kernel->columnIndex[k++] = j;
+    }
+  }
+  kernel->rowStart[kernel->rows] = k;
+}
+
+/* y = K x for the rows of panels [panel0, panel1) of a sparse kernel */
+static void sparseGainKernelRows(GAIN_KERNEL *kernel, long panel0, long panel1) {
+  long i, i1, k;
+
+  i1 = MIN(panel1 * KERNEL_PANEL, kernel->rows);
+  for (i = panel0 * KERNEL_PANEL; i < i1; i++) {
+    if (kernel->singlePrecision) {
+      float acc = 0;
+      for (k = kernel->rowStart[i]; k < kernel->rowStart[i + 1]; k++)
+        acc += kernel->fK[k] * kernel->fx[kernel->columnIndex[k]];
+      kernel->fy[i] = acc;
+    } else {
+      double acc = 0;
+      for (k = kernel->rowStart[i]; k < kernel->rowStart[i + 1]; k++)
+        acc += kernel->dK[k] * kernel->dx[kernel->columnIndex[k]];
+      kernel->dy[i] = acc;
+    }
+  }
+}
+
+void setupGainKernel(CORRECTION *correction, LOOP_PARAM *loopParam, long verbose) {
+  GAIN_KERNEL *kernel;
+  MATRIX *K;
+  long i, j, p, r, c0, c1;
+  size_t k, size;
+
+  kernel = &correction->kernel;
+  K = correction->K;
+  freeGainKernel(kernel);
+  kernel->singlePrecision = loopParam->singlePrecision;
+  if (!correction->file || !K || !K->a)
+    return;
+  kernel->rows = K->m;
+  kernel->columns = K->n;
+  kernel->panels = (K->m + KERNEL_PANEL - 1) / KERNEL_PANEL;
+  /* an element is zero if it is zero in the precision used for the product */
+  for (i = 0; i < kernel->rows; i++)
+    for (j = 0; j < kernel->columns; j++)
+      if (kernel->singlePrecision ? (float)K->a[i][j] != 0 : K->a[i][j] != 0)
+        kernel->nonzeros++;
+  if (kernel->rows && kernel->columns && (loopParam->sparseDensity > 0) &&
+      kernel->nonzeros <= loopParam->sparseDensity * kernel->rows * kernel->columns) {
+    setupSparseGainKernel(kernel, K);
+    if (verbose)
+      fprintf(stderr, "%s: %ld of %ld elements are nonzero, using the sparse product\n",
+              correction->file, kernel->nonzeros, kernel->rows * kernel->columns);
+    return;
+  }
+  size = (size_t)kernel->panels * KERNEL_PANEL * kernel->columns;
+  if (kernel->singlePrecision) {
+    kernel->fK = malloc(sizeof(float) * (size + 1));
+    kernel->fx = malloc(sizeof(float) * (kernel->columns + 1));
+    kernel->fy = malloc(sizeof(float) * (kernel->panels * KERNEL_PANEL + 1));
+    if (!kernel->fK || !kernel->fx || !kernel->fy) {
+      fprintf(stderr, "memory allocation failure\n");
+      FreeEverything();
+      exit(1);
+    }
+  } else {
+    kernel->dK = malloc(sizeof(double) * (size + 1));
+    kernel->dx = malloc(sizeof(double) * (kernel->columns + 1));
+    kernel->dy = malloc(sizeof(double) * (kernel->panels * KERNEL_PANEL + 1));
+    if (!kernel->dK || !kernel->dx || !kernel->dy) {
+      fprintf(stderr, "memory allocation failure\n");
+      FreeEverything();
+      exit(1);
+    }
+  }
+  k = 0;
+  for (c0 = 0; c0 < kernel->columns; c0 += KERNEL_BLOCK) {
+    c1 = MIN(c0 + KERNEL_BLOCK, kernel->columns);
+    for (p = 0; p < kernel->panels; p++) {
+      for (j = c0; j < c1; j++) {
+        for (r = 0; r < KERNEL_PANEL; r++, k++) {
+          i = p * KERNEL_PANEL + r;
+          if (kernel->singlePrecision)
+            kernel->fK[k] = i < kernel->rows ? (float)K->a[i][j] : 0;
+          else
+            kernel->dK[k] = i < kernel->rows ? K->a[i][j] : 0;
+        }
+      }
+    }
+  }
+}
+
+/* y = K x over panels [panel0, panel1) */
+static void gainKernelPanels(GAIN_KERNEL *kernel, long panel0, long panel1) {
+  long p, j, r, c0, c1;
+  size_t offset;
+
+  if (kernel->sparse) {
+    sparseGainKernelRows(kernel, panel0, panel1);
+    return;
+  }
+  for (c0 = 0; c0 < kernel->columns; c0 += KERNEL_BLOCK) {
+    c1 = MIN(c0 + KERNEL_BLOCK, kernel->columns);
+    for (p = panel0; p < panel1; p++) {
+      offset = (size_t)KERNEL_PANEL * (kernel->panels * c0 + p * (c1 - c0));
+      if (kernel->singlePrecision) {
+        const float *k = kernel->fK + offset, *x = kernel->fx;
+        float *y = kernel->fy + p * KERNEL_PANEL, acc[KERNEL_PANEL];
+        for (r = 0; r < KERNEL_PANEL; r++)
+          acc[r] = c0 ? y[r] : 0;
+        for (j = c0; j < c1; j++, k += KERNEL_PANEL)
+          for (r = 0; r < KERNEL_PANEL; r++)
+            acc[r] += k[r] * x[j];
+        for (r = 0; r < KERNEL_PANEL; r++)
+          y[r] = acc[r];
+      } else {
+        const double *k = kernel->dK + offset, *x = kernel->dx;
+        double *y = kernel->dy + p * KERNEL_PANEL, acc[KERNEL_PANEL];
+        for (r = 0; r < KERNEL_PANEL; r++)
+          acc[r] = c0 ? y[r] : 0;
+        for (j = c0; j < c1; j++, k += KERNEL_PANEL)
+          for (r = 0; r < KERNEL_PANEL; r++)
+            acc[r] += k[r] * x[j];
+        for (r = 0; r < KERNEL_PANEL; r++)
+          y[r] = acc[r];
+      }
+    }
+  }
+  if (kernel->columns == 0) {
+    for (p = panel0 * KERNEL_PANEL; p < panel1 * KERNEL_PANEL; p++) {
+      if (kernel->singlePrecision)
+        kernel->fy[p] = 0;
+      else
+        kernel->dy[p] = 0;
+    }
+  }
+}
+
+static void gainKernelThread(void *arg) {
+  KERNEL_WORKER *worker = (KERNEL_WORKER *)arg;
+
+  while (1) {
+    epicsEventMustWait(worker->start);
+    if (worker->stop) {
+      epicsEventSignal(worker->done);
+      return;
+    }
+    gainKernelPanels(worker->kernel, worker->panel0, worker->panel1);
+    epicsEventSignal(worker->done);
+  }
+}
+
+void stopGainKernelThreads(void) {
+  long i;
+
+  for (i = 0; i < kernelWorkers; i++) {
+    kernelWorker[i].stop = 1;
+    epicsEventSignal(kernelWorker[i].start);
+    epicsEventMustWait(kernelWorker[i].done);
+    epicsEventDestroy(kernelWorker[i].start);
+    epicsEventDestroy(kernelWorker[i].done);
+  }
+  if (kernelWorker)
+    free(kernelWorker);
+  kernelWorker = NULL;
+  kernelWorkers = 0;
+}
+
+void requestGainKernelStop(void) {
+  kernelStopRequested = 1;
+}
+
+/* The calling thread takes one share of the panels, so threads-1 workers are started */
+void startGainKernelThreads(long threads) {
+  long i;
+  char name[32];
+
+  if (threads < 1)
+    threads = 1;
+  if (kernelWorkers == threads - 1)
+    return;
+  stopGainKernelThreads();
+  if (threads == 1)
+    return;
+  if ((kernelWorker = calloc(threads - 1, sizeof(KERNEL_WORKER))) == NULL) {
+    fprintf(stderr, "memory allocation failure\n");
+    FreeEverything();
+    exit(1);
+  }
+  for (i = 0; i < threads - 1; i++) {
+    kernelWorker[i].start = epicsEventMustCreate(epicsEventEmpty);
+    kernelWorker[i].done = epicsEventMustCreate(epicsEventEmpty);
+    sprintf(name, "controlLaw%ld", i + 1);
+    if (!epicsThreadCreate(name, epicsThreadPriorityMedium, epicsThreadGetStackSize(epicsThreadStackMedium),
+                           gainKernelThread, &kernelWorker[i])) {
+      fprintf(stderr, "Warning: unable to start thread %s; using %ld threads\n", name, i + 1);
+      epicsEventDestroy(kernelWorker[i].start);
+      epicsEventDestroy(kernelWorker[i].done);
+      break;
+    }
+    kernelWorkers++;
+  }
+}
+
+/* Multiply the gain matrix by the vector in kernel->dx (kernel->fx in single precision),
+   leaving the result in kernel->dy (kernel->fy). */
+void gainKernelMultiply(GAIN_KERNEL *kernel) {
+  long i, shares;
+
+  shares = MIN(kernelWorkers + 1, kernel->panels);
+  if (shares <= 1) {
+    gainKernelPanels(kernel, 0, kernel->panels);
+    return;
+  }
+  kernelBusy = 1;
+  for (i = 0; i < shares - 1; i++) {
+    kernelWorker[i].kernel = kernel;
+    kernelWorker[i].panel0 = (i * kernel->panels) / shares;
+    kernelWorker[i].panel1 = ((i + 1) * kernel->panels) / shares;
+    epicsEventSignal(kernelWorker[i].start);
+  }
+  gainKernelPanels(kernel, ((shares - 1) * kernel->panels) / shares, kernel->panels);
+  for (i = 0; i < shares - 1; i++)
+    epicsEventMustWait(kernelWorker[i].done);
+  kernelBusy = 0;
+  if (kernelStopRequested)
+    stopGainKernelThreads();
+}
+
+/* Per-phase timing of the control loop. Each phase of an iteration is timed with
+   latencyMark() and added to a histogram with logarithmic bins when the iteration ends,
+   so the tail latency is kept without storing the individual times. */
+static char *latencyPhaseName[LATENCY_PHASES] = {
+  "Read", "Despike", "Tests", "Multiply", "Filter", "DeltaLimit", "Write", "Output", "Sleep", "Iteration"};
+
+void startLatencyIteration(LATENCY_STATS *latency) {
+  long i;
+
+  for (i = 0; i < LATENCY_PHASES; i++) {
+    latency->phaseTime[i] = 0;
+    latency->ran[i] = 0;
+  }
+  latency->iterationStart = latency->phaseStart = getTimeInSecs();
+}
+
+/* charge the time since the previous mark to the given phase */
+void latencyMark(LATENCY_STATS *latency, long phase) {
+  double now;
+
+  now = getTimeInSecs();
+  latency->phaseTime[phase] += now - latency->phaseStart;
+  latency->ran[phase] = 1;
+  latency->phaseStart = now;
+}
+
+void endLatencyIteration(LATENCY_STATS *latency) {
+  long i, bin;
+
+  latency->phaseTime[LATENCY_ITERATION] = getTimeInSecs() - latency->iterationStart;
+  latency->ran[LATENCY_ITERATION] = 1;
+  for (i = 0; i < LATENCY_PHASES; i++) {
+    if (!latency->ran[i])
+      continue;
+    if (latency->phaseTime[i] <= 1e-6)
+      bin = 0;
+    else
+      bin = MIN((long)(LATENCY_DECADE_BINS * log10(latency->phaseTime[i] / 1e-6)), LATENCY_BINS - 1);
+    latency->histogram[i][bin]++;
+    latency->count[i]++;
+    latency->sum[i] += latency->phaseTime[i];
+    if (latency->phaseTime[i] > latency->max[i])
+      latency->max[i] = latency->phaseTime[i];
+  }
+}
+
+/* upper edge of the bin holding the given fraction of the samples */
+double latencyPercentile(LATENCY_STATS *latency, long phase, double fraction) {
+  long bin, sum;
+
+  if (!latency->count[phase])
+    return 0;
+  for (bin = sum = 0; bin < LATENCY_BINS - 1; bin++) {
+    if ((sum += latency->histogram[phase][bin]) >= fraction * latency->count[phase])
+      break;
+  }
+  return MIN(1e-6 * pow(10.0, (bin + 1.0) / LATENCY_DECADE_BINS), latency->max[phase]);
+}
+
+/* one page per phase, with the summary as parameters and the histogram as columns */
+void writeLatencyStats(LATENCY_STATS *latency) {
+  SDDS_TABLE page;
+  long i, bin;
+  double lower, upper;
+
+  if (!latency->file) {
+    fprintf(stderr, "Phase          Count       Mean(s)        P50(s)        P99(s)      P99.9(s)        Max(s)\n");
+    for (i = 0; i < LATENCY_PHASES; i++) {
+      if (!latency->count[i])
+        continue;
+      fprintf(stderr, "%-10s %9ld %13.6e %13.6e %13.6e %13.6e %13.6e\n", latencyPhaseName[i], latency->count[i],
+              latency->sum[i] / latency->count[i], latencyPercentile(latency, i, 0.5), latencyPercentile(latency, i, 0.99),
+              latencyPercentile(latency, i, 0.999), latency->max[i]);
+    }
+    return;
+  }
+  if (!SDDS_InitializeOutput(&page, SDDS_BINARY, 1, "sddscontrollaw latency of the loop phases", NULL, latency->file) ||
+      (0 > SDDS_DefineParameter(&page, "Phase", NULL, NULL, "Phase of the iteration", NULL, SDDS_STRING, NULL)) ||
+      (0 > SDDS_DefineParameter(&page, "Count", NULL, NULL, "Number of times the phase ran", NULL, SDDS_LONG, NULL)) ||
+      (0 > SDDS_DefineParameter(&page, "Mean", NULL, "s", "Mean duration", NULL, SDDS_DOUBLE, NULL)) ||
+      (0 > SDDS_DefineParameter(&page, "P50", NULL, "s", "Median duration", NULL, SDDS_DOUBLE, NULL)) ||
+      (0 > SDDS_DefineParameter(&page, "P99", NULL, "s", "99th percentile of the duration", NULL, SDDS_DOUBLE, NULL)) ||
+      (0 > SDDS_DefineParameter(&page, "P999", NULL, "s", "99.9th percentile of the duration", NULL, SDDS_DOUBLE, NULL)) ||
+      (0 > SDDS_DefineParameter(&page, "Max", NULL, "s", "Longest duration", NULL, SDDS_DOUBLE, NULL)) ||
+      (0 > SDDS_DefineColumn(&page, "LowerLimit", NULL, "s", "Lower limit of the bin", NULL, SDDS_DOUBLE, 0)) ||
+      (0 > SDDS_DefineColumn(&page, "UpperLimit", NULL, "s", "Upper limit of the bin", NULL, SDDS_DOUBLE, 0)) ||
+      (0 > SDDS_DefineColumn(&page, "Frequency", NULL, NULL, "Number of durations in the bin", NULL, SDDS_LONG, 0)) ||
+      !SDDS_WriteLayout(&page)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return;
+  }
+  for (i = 0; i < LATENCY_PHASES; i++) {
+    if (!SDDS_StartPage(&page, LATENCY_BINS) ||
+        !SDDS_SetParameters(&page, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE, "Phase", latencyPhaseName[i], "Count", latency->count[i],
+                            "Mean", latency->count[i] ? latency->sum[i] / latency->count[i] : 0.0,
+                            "P50", latencyPercentile(latency, i, 0.5), "P99", latencyPercentile(latency, i, 0.99),
+                            "P999", latencyPercentile(latency, i, 0.999), "Max", latency->max[i], NULL)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      SDDS_Terminate(&page);
+      return;
+    }
+    for (bin = 0; bin < LATENCY_BINS; bin++) {
+      lower = bin ? 1e-6 * pow(10.0, (double)bin / LATENCY_DECADE_BINS) : 0;
+      upper = 1e-6 * pow(10.0, (bin + 1.0) / LATENCY_DECADE_BINS);
+      if (!SDDS_SetRowValues(&page, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE, bin, "LowerLimit", lower, "UpperLimit", upper,
+                             "Frequency", latency->histogram[i][bin], NULL)) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        SDDS_Terminate(&page);
+        return;
+      }
+    }
+    if (!SDDS_WritePage(&page)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      SDDS_Terminate(&page);
+      return;
+    }
+  }
+  if (!SDDS_Terminate(&page))
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+}
+
+/* PVs <prefix><phase>Mean, <prefix><phase>P99 and <prefix><phase>Max */
+void setupLatencyPVs(LATENCY_STATS *latency, double pendIOTime) {
+  long i, j, n;
+  static char *quantity[3] = {"Mean", "P99", "Max"};
+
+  if (!latency->PVprefix || latency->PV)
+    return;
+  n = 3 * LATENCY_PHASES;
+  if (!(latency->PV = calloc(n, sizeof(*latency->PV))) ||
+      !(latency->PVInfo = calloc(n, sizeof(*latency->PVInfo))) ||
+      !(latency->PVvalue = calloc(n, sizeof(*latency->PVvalue))) ||
+      !(latency->PVInfo[0].count = malloc(sizeof(long)))) {
+    fprintf(stderr, "memory allocation failure\n");
+    FreeEverything();
+    exit(1);
+  }
+  for (i = 0; i < LATENCY_PHASES; i++) {
+    for (j = 0; j < 3; j++) {
+      if (!(latency->PV[3 * i + j] = malloc(strlen(latency->PVprefix) + strlen(latencyPhaseName[i]) + 5))) {
+        fprintf(stderr, "memory allocation failure\n");
+        FreeEverything();
+        exit(1);
+      }
+      sprintf(latency->PV[3 * i + j], "%s%s%s", latency->PVprefix, latencyPhaseName[i], quantity[j]);
+    }
+  }
+  SetupRawCAConnection(latency->PV, latency->PVInfo, n, pendIOTime);
+}
+
+void writeLatencyPVs(LATENCY_STATS *latency, double pendIOTime) {
+  long i;
+
+  if (!latency->PV)
+    return;
+  for (i = 0; i < LATENCY_PHASES; i++) {
+    latency->PVvalue[3 * i] = latency->count[i] ? latency->sum[i] / latency->count[i] : 0;
+    latency->PVvalue[3 * i + 1] = latencyPercentile(latency, i, 0.99);
+    latency->PVvalue[3 * i + 2] = latency->max[i];
+  }
+  setPVs(latency->PV, latency->PVvalue, latency->PVInfo, 3 * LATENCY_PHASES, pendIOTime);
+}
+
+void freeLatencyStats(LATENCY_STATS *latency) {
+  long i;
+
+  if (latency->PV) {
+    for (i = 0; i < 3 * LATENCY_PHASES; i++) {
+      if (latency->PV[i])
+        free(latency->PV[i]);
+    }
+    free(latency->PV);
+    free(latency->PVInfo[0].count);
+    free(latency->PVInfo);
+    free(latency->PVvalue);
+    latency->PV = NULL;
+  }
+  if (latency->file)
+    free(latency->file);
+  if (latency->PVprefix)
+    free(latency->PVprefix);
+  latency->file = latency->PVprefix = NULL;
+  latency->enabled = 0;
+}
+
+void latencyDumpHandler(int sig) {
+  sddscontrollawGlobal->latency.dump = 1;
+#if defined(SIGURG)
+  signal(SIGURG, latencyDumpHandler);
+#endif
+}
+
 void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correction, CORRECTION *compensation, long verbose, double pendIOTime) {
   long i, j, k;
   CONTROL_NAME *control, *controlComp, *readback, *readbackComp;
-  MATRIX *K, *A, *B;
+  MATRIX *A, *B;
+  GAIN_KERNEL *kernel;
   long aorder, border, sign;
   double *ptr;
-#ifdef FLOAT_MATH
-  float accumulator;
-#else
   double accumulator;
-#endif
 
   readback = correction->readback;
   control = correction->control;
   readbackComp = compensation->readback;
   controlComp = compensation->control;
 
-  K = correction->K;
+  kernel = &correction->kernel;
   if (skipIteration) {
     /* make no change in correction */
     for (i = 0; i < control->n; i++) {
@@ -5030,6 +5737,29 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
       control->delta[0][i] = 0;
     }
   } else {
+    if (loopParam->gainPV) {
+      readMonitoredPVs(&loopParam->gainPV, &loopParam->gain, &loopParam->gainPVInfo, 1, pendIOTime);
+    }
+    for (j = 0; j < readback->n; j++) {
+      if (loopParam->holdPresentValues) {
+        /* for hold present values mode, correct relative to 
+           initial values stored in readback->initial[j]
+        */
+        if (kernel->singlePrecision)
+          kernel->fx[j] = ((float)readback->value[0][j]) - ((float)readback->initial[j]);
+        else
+          kernel->dx[j] = readback->value[0][j] - readback->initial[j];
+      } else {
+        /* standard feedback using readback as error signal
+           to apply a change to control values
+        */
+        if (kernel->singlePrecision)
+          kernel->fx[j] = (float)readback->value[0][j];
+        else
+          kernel->dx[j] = readback->value[0][j];
+      }
+    }
+    gainKernelMultiply(kernel);
     for (i = 0; i < control->n; i++) {
       control->old[i] = control->value[0][i];
       if (!control->integral)
@@ -5041,38 +5771,15 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
                This looks like a kludge; it may break some additional feature later.
 	     */
         control->old[i] = control->value[0][i] = 0;
-      if (loopParam->gainPV) {
-        readPVs(&loopParam->gainPV, &loopParam->gain, &loopParam->gainPVInfo, 1, NULL, pendIOTime);
-      }
-
-      if (loopParam->holdPresentValues) {
-        for (j = accumulator = 0; j < readback->n; j++) {
-          /* for hold present values mode, correct relative to 
-		     initial values stored in readback->initial[j]
-		   */
-#ifdef FLOAT_MATH
-          accumulator += ((float)K->a[i][j]) * (((float)readback->value[0][j]) - ((float)readback->initial[j]));
-#else
-          accumulator += K->a[i][j] * (readback->value[0][j] - readback->initial[j]);
-#endif
-        }
-      } else {
-        for (j = accumulator = 0; j < readback->n; j++) {
-          /* standard feedback using readback as error signal
-		     to apply a change to control values
-		   */
-#ifdef FLOAT_MATH
-          accumulator += ((float)K->a[i][j]) * ((float)readback->value[0][j]);
-#else
-          accumulator += K->a[i][j] * readback->value[0][j];
-#endif
-        }
-      }
+      accumulator = kernel->singlePrecision ? kernel->fy[i] : kernel->dy[i];
       control->value[0][i] -= accumulator * loopParam->gain;
       control->delta[0][i] = control->value[0][i] - control->old[i];
     }
-    if (correction->coefFile)
+    latencyMark(&sddscontrollawGlobal->latency, LATENCY_MULTIPLY);
+    if (correction->coefFile) {
       apply_filter(correction, verbose);
+      latencyMark(&sddscontrollawGlobal->latency, LATENCY_FILTER);
+    }
     if (verbose)
       fprintf(stderr, "%s initial[0]: %8.3f; old[0]: %8.3f; new[0]: %8.3f\n", control->controlName[0], control->initial[0], control->old[0], control->value[0][0]);
   }
@@ -5081,7 +5788,7 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
   /* for now the sets of actuator control quantities for the two matrices should not and
      cannot intersect. Otherwise one of the values will be overwritten. */
   if (compensation->file) {
-    K = compensation->K;
+    kernel = &compensation->kernel;
     if (skipIteration) {
       /* make no change in correction */
       for (i = 0; i < controlComp->n; i++) {
@@ -5094,7 +5801,16 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
 	     from the previous correction (control->delta[0]) */
       for (j = 0; j < readbackComp->n; j++) {
         readbackComp->error[j] = control->delta[0][j];
+        if (kernel->singlePrecision)
+          kernel->fx[j] = (float)readbackComp->error[j];
+        else
+          kernel->dx[j] = readbackComp->error[j];
       }
+      /* cascade calculation using correction effort above
+         to apply a change to control values.
+         Also the flag holdPresentValues has no meaning here.
+      */
+      gainKernelMultiply(kernel);
 
       for (i = 0; i < controlComp->n; i++) {
         controlComp->old[i] = controlComp->value[0][i];
@@ -5108,21 +5824,12 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
 		   make a relative change to the actuator values.
 		 */
           controlComp->value[0][i] = controlComp->old[i] = 0;
-        for (j = accumulator = 0; j < readbackComp->n; j++) {
-          /* cascade calculation using correction effort above
-		     to apply a change to control values.
-		     Also the flag holdPresentValues has no meaning here.
-		   */
-          /* + sign is the convention for feedforward compensation */
-#ifdef FLOAT_MATH
-          accumulator += ((float)K->a[i][j]) * ((float)readbackComp->error[j]);
-#else
-          accumulator += K->a[i][j] * readbackComp->error[j];
-#endif
-          /* controlComp->delta[0][i] may be modified by filtering below */
-        }
+        /* + sign is the convention for feedforward compensation */
+        /* controlComp->delta[0][i] may be modified by filtering below */
+        accumulator = kernel->singlePrecision ? kernel->fy[i] : kernel->dy[i];
         controlComp->delta[0][i] += accumulator * loopParam->compensationGain;
       }
+      latencyMark(&sddscontrollawGlobal->latency, LATENCY_MULTIPLY);
     }
     if (compensation->coefFile) {
       /* filtering follows the equation 
@@ -5162,18 +5869,16 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
       for (i = 0; i < controlComp->n; i++) {
         controlComp->historyFiltered->a[0][i] = 0;
         for (k = 1; k <= aorder; k++) {
-#ifdef FLOAT_MATH
-          controlComp->historyFiltered->a[0][i] -= ((float)A->a[k][i]) * ((float)controlComp->historyFiltered->a[k][i]);
-#else
-          controlComp->historyFiltered->a[0][i] -= A->a[k][i] * controlComp->historyFiltered->a[k][i];
-#endif
+          if (compensation->kernel.singlePrecision)
+            controlComp->historyFiltered->a[0][i] -= ((float)A->a[k][i]) * ((float)controlComp->historyFiltered->a[k][i]);
+          else
+            controlComp->historyFiltered->a[0][i] -= A->a[k][i] * controlComp->historyFiltered->a[k][i];
         }
         for (k = 0; k <= border; k++) {
-#ifdef FLOAT_MATH
-          controlComp->historyFiltered->a[0][i] += ((float)B->a[k][i]) * ((float)controlComp->history->a[k][i]);
-#else
-          controlComp->historyFiltered->a[0][i] += B->a[k][i] * controlComp->history->a[k][i];
-#endif
+          if (compensation->kernel.singlePrecision)
+            controlComp->historyFiltered->a[0][i] += ((float)B->a[k][i]) * ((float)controlComp->history->a[k][i]);
+          else
+            controlComp->historyFiltered->a[0][i] += B->a[k][i] * controlComp->history->a[k][i];
         }
         controlComp->historyFiltered->a[0][i] /= A->a[0][i];
         if (verbose)
@@ -5186,6 +5891,7 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
         controlComp->value[0][i] = controlComp->delta[0][i] + controlComp->initial[i];
       }
       fprintf(stderr, "%s initial[0]: %8.3f old[0]: %8.3f new[0]: %8.3f\n", controlComp->controlName[0], controlComp->initial[0], controlComp->old[0], controlComp->value[0][0]);
+      latencyMark(&sddscontrollawGlobal->latency, LATENCY_FILTER);
     } else {
       /* no filter files given */
       for (i = 0; i < controlComp->n; i++) {
@@ -5636,6 +6342,7 @@ void writeToGlitchFile(GLITCH_PARAM *glitchParam, SDDS_TABLE *glitchPage, long *
 #if !defined(vxWorks)
 void serverExit(int sig) {
   char s[1024];
+  sddscontrollawGlobal->inSignalHandler = 1;
   sprintf(s, "rm %s", sddscontrollawGlobal->pidFile);
   system(s);
   fprintf(stderr, "Program terminated by signal.\n");
@@ -5789,6 +6496,10 @@ long parseArguments(char ***argv,
     "full",
     "brief",
   };
+  char *precision_option[2] = {
+    "double",
+    "single",
+  };
 
   infinite = 0;
 
@@ -5883,6 +6594,7 @@ long parseArguments(char ***argv,
               exit(1);
             }
             SetupRawCAConnection(&loopParam->gainPV, &loopParam->gainPVInfo, 1, *pendIOTime);
+            setupPVMonitors(&loopParam->gainPV, &loopParam->gainPVInfo, 1);
           } else {
             free_scanargs(&s_arg, *argc);
             FreeEverything();
@@ -5927,6 +6639,7 @@ long parseArguments(char ***argv,
               exit(1);
             }
             SetupRawCAConnection(&loopParam->intervalPV, &loopParam->intervalPVInfo, 1, *pendIOTime);
+            setupPVMonitors(&loopParam->intervalPV, &loopParam->intervalPVInfo, 1);
           } else {
             free_scanargs(&s_arg, *argc);
             FreeEverything();
@@ -6249,6 +6962,7 @@ long parseArguments(char ***argv,
               exit(1);
             }
             SetupRawCAConnection(&loopParam->averagePV, &loopParam->averagePVInfo, 1, *pendIOTime);
+            setupPVMonitors(&loopParam->averagePV, &loopParam->averagePVInfo, 1);
           } else {
             free_scanargs(&s_arg, *argc);
             FreeEverything();
@@ -6387,6 +7101,7 @@ long parseArguments(char ***argv,
             exit(1);
           }
           SetupRawCAConnection(&despikeParam->thresholdPV, &despikeParam->thresholdPVInfo, 1, *pendIOTime);
+          setupPVMonitors(&despikeParam->thresholdPV, &despikeParam->thresholdPVInfo, 1);
           readPVs(&despikeParam->thresholdPV, &despikeParam->threshold, &despikeParam->thresholdPVInfo, 1, NULL, *pendIOTime);
         }
         if (despikeParam->rampThresholdPV) {
@@ -6398,6 +7113,7 @@ long parseArguments(char ***argv,
             exit(1);
           }
           SetupRawCAConnection(&despikeParam->rampThresholdPV, &despikeParam->rampThresholdPVInfo, 1, *pendIOTime);
+          setupPVMonitors(&despikeParam->rampThresholdPV, &despikeParam->rampThresholdPVInfo, 1);
           setEnumPV(despikeParam->rampThresholdPV, despikeParam->reramp, despikeParam->rampThresholdPVInfo, 0);
         }
         break;
@@ -6554,7 +7270,7 @@ long parseArguments(char ***argv,
         strcpy(correction->coefFile, s_arg[i_arg].list[1]);
         break;
       case CLO_TRIGGERPV:
-        if (s_arg[i_arg].n_items < 2 || s_arg[i_arg].n_items>3) {
+        if (s_arg[i_arg].n_items < 2 || s_arg[i_arg].n_items>5) {
           fprintf(stderr, "bad -triggerPV syntax\n");
           free_scanargs(&s_arg, *argc);
           return (1);
@@ -6567,16 +7283,23 @@ long parseArguments(char ***argv,
         strcpy(loopParam->trigger.PV, s_arg[i_arg].list[1]);
         loopParam->triggerProvided = 1;
         loopParam->trigger.modulus = 1;
+        loopParam->trigger.eventDriven = 0;
+        loopParam->trigger.readbackTimeout = 0;
+        dummyFlags = 0;
         s_arg[i_arg].n_items -= 2;
         if (s_arg[i_arg].n_items>0 &&
             (!scanItemList(&dummyFlags, s_arg[i_arg].list+2, &s_arg[i_arg].n_items, 0,
                            "modulus", SDDS_LONG, &loopParam->trigger.modulus, 1, 0,
+                           "eventDriven", -1, NULL, 0, TRIGGER_EVENT_DRIVEN,
+                           "readbackTimeout", SDDS_DOUBLE, &loopParam->trigger.readbackTimeout, 1, TRIGGER_READBACK_TIMEOUT,
                            NULL) ||
-             loopParam->trigger.modulus<1)) {
+             loopParam->trigger.modulus<1 || loopParam->trigger.readbackTimeout<0)) {
           fprintf(stderr, "bad -triggerPV syntax\n");
           free_scanargs(&s_arg, *argc);
           return (1);
         }
+        if (dummyFlags & TRIGGER_EVENT_DRIVEN)
+          loopParam->trigger.eventDriven = 1;
         setupDatastrobeTriggerCallbacks(&(loopParam->trigger));
         break;
       case CLO_ENDOFLOOPPV:
@@ -6600,6 +7323,47 @@ long parseArguments(char ***argv,
             }
         SetupRawCAConnection(&loopParam->endOfLoopPV, &loopParam->endOfLoopPVInfo, 1, *pendIOTime);
         break;
+      case CLO_PRECISION:
+        if ((s_arg[i_arg].n_items != 2) ||
+            ((loopParam->singlePrecision = match_string(s_arg[i_arg].list[1], precision_option, 2, 0)) < 0)) {
+          fprintf(stderr, "bad -precision syntax; give single or double\n");
+          free_scanargs(&s_arg, *argc);
+          return (1);
+        }
+        break;
+      case CLO_LATENCYSTATS:
+        freeLatencyStats(&sddscontrollawGlobal->latency);
+        s_arg[i_arg].n_items--;
+        if (!scanItemList(&dummyFlags, s_arg[i_arg].list + 1, &s_arg[i_arg].n_items, 0,
+                          "file", SDDS_STRING, &sddscontrollawGlobal->latency.file, 1, 0,
+                          "PVprefix", SDDS_STRING, &sddscontrollawGlobal->latency.PVprefix, 1, 0,
+                          NULL)) {
+          fprintf(stderr, "bad -latencyStats syntax\n");
+          free_scanargs(&s_arg, *argc);
+          return (1);
+        }
+        s_arg[i_arg].n_items++;
+        sddscontrollawGlobal->latency.enabled = 1;
+        break;
+      case CLO_SPARSE:
+        s_arg[i_arg].n_items--;
+        if (!scanItemList(&dummyFlags, s_arg[i_arg].list + 1, &s_arg[i_arg].n_items, 0,
+                          "density", SDDS_DOUBLE, &loopParam->sparseDensity, 1, 0,
+                          NULL) ||
+            loopParam->sparseDensity < 0 || loopParam->sparseDensity > 1) {
+          fprintf(stderr, "bad -sparse syntax; give density=<fraction> between 0 and 1\n");
+          free_scanargs(&s_arg, *argc);
+          return (1);
+        }
+        s_arg[i_arg].n_items++;
+        break;
+      case CLO_THREADS:
+        if ((s_arg[i_arg].n_items != 2) || !(get_long(&loopParam->threads, s_arg[i_arg].list[1])) || (loopParam->threads < 1)) {
+          fprintf(stderr, "bad -threads syntax; give a positive integer\n");
+          free_scanargs(&s_arg, *argc);
+          return (1);
+        }
+        break;
       default:
         fprintf(stderr, "Unrecognized option %s given.\n", s_arg[i_arg].list[0]);
         free_scanargs(&s_arg, *argc);
@@ -6824,6 +7588,9 @@ void initializeData(CORRECTION *correction,
   loopParam->step = NULL;
   loopParam->postChangeExec = NULL;
   loopParam->triggerProvided = 0;
+  loopParam->singlePrecision = 0;
+  loopParam->threads = 1;
+  loopParam->sparseDensity = 0;
   /* loopParam->dryRun =1; temporarily, for safe reason */
 
   loopParam->updateInterval = DEFAULT_UPDATE_INTERVAL;
@@ -6985,6 +7752,10 @@ void setupData(CORRECTION *correction,
   setupDeltaLimitFile(delta);
   setupActionLimitFile(action);
   setupCompensationFiles(overlapCompensation);
+  setupGainKernel(correction, loopParam, verbose);
+  setupGainKernel(overlapCompensation, loopParam, verbose);
+  startGainKernelThreads(loopParam->threads);
+  setupLatencyPVs(&sddscontrollawGlobal->latency, pendIOTime);
 
 #ifdef USE_RUNCONTROL
   if (sddscontrollawGlobal->rcParam.pingTimeout == 0.0) {
@@ -8585,6 +9356,7 @@ long WriteWaveformData(WAVE_FORMS *controlWaveforms, CONTROL_NAME *control, doub
 
 void CleanUpCorrections(CORRECTION *correction) {
   int i;
+  freeGainKernel(&correction->kernel);
   if (correction->file) {
     if (correction->K->a) {
       for (i = 0; i < correction->K->m; i++) {
@@ -8617,6 +9389,7 @@ void CleanUpCorrections(CORRECTION *correction) {
       correction->readback->symbolicName = NULL;
     }
     if (correction->readback->channelInfo) {
+      clearPVMonitors(correction->readback->channelInfo, correction->readback->n);
       if (correction->readback->channelInfo[0].count)
         free(correction->readback->channelInfo[0].count);
       free(correction->readback->channelInfo);
@@ -8786,16 +9559,19 @@ void CleanUpOthers(DESPIKE_PARAM *despike, TESTS *tests, LOOP_PARAM *loopParam)
   }
   if (loopParam->gainPV) {
     free(loopParam->gainPV);
+    clearPVMonitors(&loopParam->gainPVInfo, 1);
     free(loopParam->gainPVInfo.count);
     loopParam->gainPV = NULL;
   }
   if (loopParam->intervalPV) {
     free(loopParam->intervalPV);
+    clearPVMonitors(&loopParam->intervalPVInfo, 1);
     free(loopParam->intervalPVInfo.count);
     loopParam->intervalPV = NULL;
   }
   if (loopParam->averagePV) {
     free(loopParam->averagePV);
+    clearPVMonitors(&loopParam->averagePVInfo, 1);
     free(loopParam->averagePVInfo.count);
     loopParam->averagePV = NULL;
   }
@@ -8866,9 +9642,12 @@ void CleanUpOthers(DESPIKE_PARAM *despike, TESTS *tests, LOOP_PARAM *loopParam)
       free(despike->despike);
     if (despike->thresholdPV) {
       free(despike->thresholdPV);
+      clearPVMonitors(&despike->thresholdPVInfo, 1);
       free(despike->thresholdPVInfo.count);
       despike->thresholdPV = NULL;
     }
+    if (despike->rampThresholdPV)
+      clearPVMonitors(&despike->rampThresholdPVInfo, 1);
     free(despike->file);
     despike->file = NULL;
   }
@@ -9043,6 +9822,13 @@ void FreeEverything(void) {
     ca_task_exit();
 #endif
   }
+  if (sddscontrollawGlobal->inSignalHandler)
+    requestGainKernelStop();
+  else
+    stopGainKernelThreads();
+  if (sddscontrollawGlobal->latency.enabled)
+    writeLatencyStats(&sddscontrollawGlobal->latency);
+  freeLatencyStats(&sddscontrollawGlobal->latency);
   CleanUpCorrections(&(sddscontrollawGlobal->correction));
   CleanUpCorrections(&(sddscontrollawGlobal->overlapCompensation));
   CleanUpOthers(&(sddscontrollawGlobal->despikeParam), &(sddscontrollawGlobal->test), &(sddscontrollawGlobal->loopParam));
@@ -9161,6 +9947,8 @@ void oag_ca_exception_handler(struct exception_handler_args args) {
 #endif
 
 void datastrobeTriggerEventHandler(struct event_handler_args event) {
+  DATASTROBE_TRIGGER *datastrobeTrigger = (DATASTROBE_TRIGGER *)event.usr;
+
   if (event.status != ECA_NORMAL) {
     fprintf(stderr, "Error received on data strobe PV\n");
     return;
@@ -9168,24 +9956,64 @@ void datastrobeTriggerEventHandler(struct event_handler_args event) {
 #ifdef DEBUG
   fprintf(stderr, "Received callback on data strobe PV\n");
 #endif
-  if (sddscontrollawGlobal->loopParam.trigger.initialized == 0) {
+  epicsMutexLock(datastrobeTrigger->mutex);
+  if (datastrobeTrigger->initialized == 0) {
     /* the first callback is just the connection event */
-    sddscontrollawGlobal->loopParam.trigger.initialized = 1;
-    sddscontrollawGlobal->loopParam.trigger.datalogged = 1;
+    datastrobeTrigger->initialized = 1;
+    datastrobeTrigger->datalogged = 1;
+    epicsMutexUnlock(datastrobeTrigger->mutex);
     return;
   }
-  sddscontrollawGlobal->loopParam.trigger.currentValue = *((double *)event.dbr);
+  datastrobeTrigger->currentValue = *((double *)event.dbr);
 #ifdef DEBUG
-  fprintf(stderr, "chid=%d, current=%f\n", (int)sddscontrollawGlobal->loopParam.trigger.channelID, sddscontrollawGlobal->loopParam.trigger.currentValue);
+  fprintf(stderr, "chid=%d, current=%f\n", (int)datastrobeTrigger->channelID, datastrobeTrigger->currentValue);
 #endif
-  sddscontrollawGlobal->loopParam.trigger.triggered = 1;
-  sddscontrollawGlobal->loopParam.trigger.triggerCount++;
-  if (!sddscontrollawGlobal->loopParam.trigger.datalogged)
-    sddscontrollawGlobal->loopParam.trigger.datastrobeMissed++;
-  sddscontrollawGlobal->loopParam.trigger.datalogged = 0;
+  datastrobeTrigger->triggered = 1;
+  datastrobeTrigger->triggerCount++;
+  if (!datastrobeTrigger->datalogged)
+    datastrobeTrigger->datastrobeMissed++;
+  datastrobeTrigger->datalogged = 0;
+  epicsMutexUnlock(datastrobeTrigger->mutex);
+  if (datastrobeTrigger->event)
+    epicsEventSignal(datastrobeTrigger->event);
   return;
 }
 
+short triggerInitialized(DATASTROBE_TRIGGER *datastrobeTrigger) {
+  short initialized;
+
+  epicsMutexLock(datastrobeTrigger->mutex);
+  initialized = datastrobeTrigger->initialized;
+  epicsMutexUnlock(datastrobeTrigger->mutex);
+  return initialized;
+}
+
+/* Hands a pending trigger over to the main loop. Returns 1 if there was
+   one, setting takenCount and the number of triggers missed so far. A
+   trigger that arrives before this one is consumed counts as missed. */
+long takeTrigger(DATASTROBE_TRIGGER *datastrobeTrigger, long *missed) {
+  long taken = 0;
+
+  epicsMutexLock(datastrobeTrigger->mutex);
+  if (datastrobeTrigger->triggered) {
+    datastrobeTrigger->triggered = 0;
+    datastrobeTrigger->datalogged = 1;
+    datastrobeTrigger->takenCount = datastrobeTrigger->triggerCount;
+    taken = 1;
+  }
+  *missed = datastrobeTrigger->datastrobeMissed;
+  epicsMutexUnlock(datastrobeTrigger->mutex);
+  return taken;
+}
+
+/* Waits until the trigger callback signals or the timeout expires */
+void waitForTrigger(DATASTROBE_TRIGGER *datastrobeTrigger, double timeout) {
+  if (datastrobeTrigger->event)
+    epicsEventWaitWithTimeout(datastrobeTrigger->event, timeout);
+  else
+    oag_ca_pend_event(0.001, &(sddscontrollawGlobal->sigint));
+}
+
 long setupDatastrobeTriggerCallbacks(DATASTROBE_TRIGGER *datastrobeTrigger) {
   datastrobeTrigger->trigStep = -1;
   datastrobeTrigger->currentValue = 0;
@@ -9195,6 +10023,13 @@ long setupDatastrobeTriggerCallbacks(DATASTROBE_TRIGGER *datastrobeTrigger) {
   datastrobeTrigger->datalogged = 0;
   datastrobeTrigger->initialized = 0;
   datastrobeTrigger->triggerCount = 0;
+  datastrobeTrigger->takenCount = 0;
+  if (!datastrobeTrigger->event)
+    datastrobeTrigger->event = epicsEventMustCreate(epicsEventEmpty);
+  if (!datastrobeTrigger->readbackEvent)
+    datastrobeTrigger->readbackEvent = epicsEventMustCreate(epicsEventEmpty);
+  if (!datastrobeTrigger->mutex)
+    datastrobeTrigger->mutex = epicsMutexMustCreate();
   if (ca_search(datastrobeTrigger->PV, &datastrobeTrigger->channelID) != ECA_NORMAL) {
     fprintf(stderr, "error: search failed for trigger control name %s\n", datastrobeTrigger->PV);
     return 0;
@@ -9202,7 +10037,7 @@ long setupDatastrobeTriggerCallbacks(DATASTROBE_TRIGGER *datastrobeTrigger) {
   ca_poll();
   if (ca_add_masked_array_event(DBR_DOUBLE, 1, datastrobeTrigger->channelID,
                                 datastrobeTriggerEventHandler,
-                                (void *)&datastrobeTrigger, (ca_real)0, (ca_real)0,
+                                (void *)datastrobeTrigger, (ca_real)0, (ca_real)0,
                                 (ca_real)0, NULL, DBE_VALUE) != ECA_NORMAL) {
     fprintf(stderr, "error: unable to setup datastrobe callback for control name %s\n",
             datastrobeTrigger->PV);
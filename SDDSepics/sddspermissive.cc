@@ -560,6 +560,7 @@ int ConnectPVs(PVA_OVERALL *pva, MONITOR_DATA *monitor) {
     return (1);
   }
   pva->useMonitorCallbacks = true;
+  pva->useMonitorReadyList = true;
   pva->monitorReqPtr = permissiveMonitorRequester::create();
   firstPV[0] = 0;
   if (MonitorPVAValues(pva) == 1) {
@@ -581,7 +582,9 @@ int ConnectPVs(PVA_OVERALL *pva, MONITOR_DATA *monitor) {
 
 int EventLoop(PVA_OVERALL *pva, MONITOR_DATA *monitor) {
   epicsTime begin(epicsTime::getCurrent());
-  long count, pingInterval, pingStep = 0;
+  epicsTime nextPing;
+  long count;
+  double waitTime;
   int64_t i, j, p, first = 0, prevFirst = 0, mask_start;
   bool pass = true, prevState = true, init = true;
   time_t t;
@@ -589,10 +592,7 @@ int EventLoop(PVA_OVERALL *pva, MONITOR_DATA *monitor) {
   char cur_time[128];
   char *desc=NULL, *name=NULL;
   bool *mask_alerts;
-  pingInterval = (long)(rcParam.pingInterval / .01);
-  if (pingInterval == 0) {
-    pingInterval = 1;
-  }
+  nextPing = begin + rcParam.pingInterval;
 
   mask_alerts = (bool*)malloc(sizeof(bool) * monitor->pages);
   j = 0;
@@ -605,10 +605,12 @@ int EventLoop(PVA_OVERALL *pva, MONITOR_DATA *monitor) {
   mask_start = j;
 
   while (true) {
-    if (pvaThreadSleep(.01) == 1) {
-      return (1);
+    //Block until a monitored PV changes, the next run control ping is due, or the execution time runs out
+    waitTime = nextPing - epicsTime::getCurrent();
+    if (waitTime > monitor->executionTime - (epicsTime::getCurrent() - begin)) {
+      waitTime = monitor->executionTime - (epicsTime::getCurrent() - begin);
     }
-    count = PollMonitoredPVA(pva);
+    count = WaitAnyMonitoredPVA(pva, waitTime);
     if (count == -1) {
       fprintf(stderr, "Exiting due to PV monitoring error\n");
       return (1);
@@ -716,8 +718,7 @@ int EventLoop(PVA_OVERALL *pva, MONITOR_DATA *monitor) {
         prevState = pass;
       }
     }
-    pingStep++;
-    if (pingStep == pingInterval) {
+    if (epicsTime::getCurrent() >= nextPing) {
       rcParam.status = runControlPing(rcParam.handle, &(rcParam.rcInfo));
       switch (rcParam.status) {
       case RUNCONTROL_ABORT:
@@ -740,7 +741,7 @@ int EventLoop(PVA_OVERALL *pva, MONITOR_DATA *monitor) {
         return (1);
         break;
       }
-      pingStep = 0;
+      nextPing = epicsTime::getCurrent() + rcParam.pingInterval;
     }
   }
   return (0);
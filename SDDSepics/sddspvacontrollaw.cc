@@ -80,7 +80,8 @@ void sigint_interrupt_handler(int sig);
 #define CLO_THRESHOLD_RAMP 37
 #define CLO_POST_CHANGE_EXECUTION 38
 #define CLO_FILTERFILE 39
-#define COMMANDLINE_OPTIONS 40
+#define CLO_SPARSE 40
+#define COMMANDLINE_OPTIONS 41
 
 #define CLO_READBACKWAVEFORM 0
 #define CLO_OFFSETWAVEFORM 1
@@ -174,6 +175,7 @@ typedef struct
   PVA_OVERALL pva, pvaGain, pvaInterval, pvaAverage, pvaLauncher[5];
  /*chid *channelID, gainPVID; */
   double *offsetPVvalue;
+  double sparseDensity;
 } LOOP_PARAM;
 
 typedef struct
@@ -189,6 +191,18 @@ typedef struct
   double *readbackValue; /*the index is consistent with that of readbacks */
 } WAVE_FORMS;
 
+/* compressed sparse row copy of a gain matrix, see setupSparseMatrix */
+typedef struct
+{
+  long rows, nonzeros, *rowStart, *columnIndex;
+  double *value;
+} SPARSE_MATRIX;
+#ifdef FLOAT_MATH
+#  define SPARSE_NONZERO(x) ((float)(x) != 0)
+#else
+#  define SPARSE_NONZERO(x) ((x) != 0)
+#endif
+
 typedef struct
 {
   char *file;
@@ -201,6 +215,7 @@ typedef struct
   MATRIX *K;
   MATRIX *aCoef;
   MATRIX *bCoef;
+  SPARSE_MATRIX sparseK;
 } CORRECTION;
 
 typedef struct
@@ -297,6 +312,8 @@ void cleanupWaveforms(WAVE_FORMS *wave_forms);
 void cleanupTestWaveforms(WAVEFORM_TESTS *waveform_tests);
 long WriteWaveformData(WAVE_FORMS *controlWaveforms, CONTROL_NAME *control, double pendIOTime);
 void CleanUpCorrections(CORRECTION *correction);
+void freeSparseMatrix(SPARSE_MATRIX *sparse);
+void setupSparseMatrix(CORRECTION *correction, double density, long verbose);
 void CleanUpOthers(DESPIKE_PARAM *despike, TESTS *tests, LOOP_PARAM *loopParam);
 void CleanUpLimits(LIMITS *limits);
 
@@ -521,6 +538,7 @@ int main(int argc, char **argv)
     (char*)"thresholdRamp",
     (char*)"postChangeExecution",
     (char*)"filterFile",
+    (char*)"sparse",
   };
   char *waveformOption[WAVEFORMOPTIONS] = {
     (char*)"readback", (char*)"offset", (char*)"actuator", (char*)"ffSetpoint", (char*)"test"};
@@ -550,7 +568,8 @@ int main(int argc, char **argv)
        [-servermode=pid=<file>,command=<file>]\n\
        [-controlLogFile=<file>] \n\
        [-glitchLogFile=file=<string>,[readbackRmsThreshold=<value>][,controlRmsThreshold=<value>][,rows=<integer]]\n\
-       [-CASecurityTest] [-waveforms=<filename>,<type>] [-postChangeExecution=<string>] \n\n";
+       [-CASecurityTest] [-waveforms=<filename>,<type>] [-postChangeExecution=<string>] \n\
+       [-sparse=density=<fraction>]\n\n";
   char *USAGE2 = (char*)"Perform simple feedback on APS control system process variables using ca calls.\n\
 <inputfile>    gain matrix in sdds format\n\
 <searchPath>   the directory path for the input files.\n\
@@ -675,7 +694,12 @@ CASecurityTest checks the channel access write permission of the control PVs.\n\
                MaximumValue and MinimumValue, and one optional short column - Ignore: \n\
                which set the flags of whether ignore the pvs in the waveform. If Ignore column \n\
                does not exist, then the readbacks and controls will consider to be testing pvs \n\
-               in the waveforms. \n\n\
+               in the waveforms. \n\
+sparse         the gain matrices are multiplied in compressed sparse row form when the\n\
+               fraction of nonzero elements is at most the given density. The default\n\
+               of 0 always uses the dense product. For finite readbacks the result is\n\
+               identical to the dense product, but a NaN or Inf readback only reaches\n\
+               the controls that have a nonzero gain for it.\n\n\
 Program by Louis Emery, ANL\n\
 Link date: " __DATE__ " " __TIME__ ", SVN revision: " SVN_VERSION ", " EPICS_VERSION_STRING "\n";
   char *USAGE_WARNING = (char*)"";
@@ -3986,10 +4010,69 @@ void apply_filter(CORRECTION *correction, long verbose) {
      control->initial[0], control->old[0], control->value[0][0]); */
 }
 
+/* Gain matrices with few nonzero elements are also kept in compressed sparse row
+   form, and controlLaw() sums only the nonzero terms of each row. They are summed
+   in column order, so for finite readbacks the result is the same as the dense
+   product. A NaN or Inf readback only propagates through the nonzero gains. */
+void freeSparseMatrix(SPARSE_MATRIX *sparse) {
+  if (sparse->rowStart)
+    free(sparse->rowStart);
+  if (sparse->columnIndex)
+    free(sparse->columnIndex);
+  if (sparse->value)
+    free(sparse->value);
+  sparse->rowStart = sparse->columnIndex = NULL;
+  sparse->value = NULL;
+  sparse->rows = sparse->nonzeros = 0;
+}
+
+void setupSparseMatrix(CORRECTION *correction, double density, long verbose) {
+  SPARSE_MATRIX *sparse;
+  MATRIX *K;
+  long i, j, k, nonzeros;
+
+  sparse = &correction->sparseK;
+  K = correction->K;
+  freeSparseMatrix(sparse);
+  if (!correction->file || !K || !K->a || !K->m || !K->n)
+    return;
+  nonzeros = 0;
+  for (i = 0; i < K->m; i++)
+    for (j = 0; j < K->n; j++)
+      if (SPARSE_NONZERO(K->a[i][j]))
+        nonzeros++;
+  if ((density <= 0) || (nonzeros > density * K->m * K->n))
+    return;
+  if (!(sparse->rowStart = (long *)malloc(sizeof(long) * (K->m + 1))) ||
+      !(sparse->columnIndex = (long *)malloc(sizeof(long) * (nonzeros + 1))) ||
+      !(sparse->value = (double *)malloc(sizeof(double) * (nonzeros + 1)))) {
+    fprintf(stderr, "memory allocation failure\n");
+    FreeEverything();
+    exit(1);
+  }
+  k = 0;
+  for (i = 0; i < K->m; i++) {
+    sparse->rowStart[i] = k;
+    for (j = 0; j < K->n; j++) {
+      if (!SPARSE_NONZERO(K->a[i][j]))
+        continue;
+      sparse->columnIndex[k] = j;
+      sparse->value[k++] = K->a[i][j];
+    }
+  }
+  sparse->rowStart[K->m] = k;
+  sparse->rows = K->m;
+  sparse->nonzeros = nonzeros;
+  if (verbose)
+    fprintf(stderr, "%s: %ld of %ld elements are nonzero, using the sparse product\n",
+            correction->file, nonzeros, K->m * K->n);
+}
+
 void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correction, CORRECTION *compensation, long verbose, double pendIOTime) {
   long i, j, k;
   CONTROL_NAME *control, *controlComp, *readback, *readbackComp;
   MATRIX *K, *A, *B;
+  SPARSE_MATRIX *sparse;
   long aorder, border, sign;
   double *ptr;
 #ifdef FLOAT_MATH
@@ -4004,6 +4087,7 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
   controlComp = compensation->control;
 
   K = correction->K;
+  sparse = &correction->sparseK;
   if (skipIteration) {
     /* make no change in correction */
     for (i = 0; i < control->n; i++) {
@@ -4025,7 +4109,23 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
         readPVs(&loopParam->gainPV, &loopParam->gain, &loopParam->gainPVInfo, &loopParam->pvaGain, 1, NULL, pendIOTime);
       }
 
-      if (loopParam->holdPresentValues) {
+      if (sparse->rowStart) {
+        accumulator = 0;
+        for (k = sparse->rowStart[i]; k < sparse->rowStart[i + 1]; k++) {
+          j = sparse->columnIndex[k];
+#ifdef FLOAT_MATH
+          if (loopParam->holdPresentValues)
+            accumulator += ((float)sparse->value[k]) * (((float)readback->value[0][j]) - ((float)readback->initial[j]));
+          else
+            accumulator += ((float)sparse->value[k]) * ((float)readback->value[0][j]);
+#else
+          if (loopParam->holdPresentValues)
+            accumulator += sparse->value[k] * (readback->value[0][j] - readback->initial[j]);
+          else
+            accumulator += sparse->value[k] * readback->value[0][j];
+#endif
+        }
+      } else if (loopParam->holdPresentValues) {
         for (j = accumulator = 0; j < readback->n; j++) {
           /* for hold present values mode, correct relative to 
 		     initial values stored in readback->initial[j]
@@ -4062,6 +4162,7 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
      cannot intersect. Otherwise one of the values will be overwritten. */
   if (compensation->file) {
     K = compensation->K;
+    sparse = &compensation->sparseK;
     if (skipIteration) {
       /* make no change in correction */
       for (i = 0; i < controlComp->n; i++) {
@@ -4088,6 +4189,18 @@ void controlLaw(long skipIteration, LOOP_PARAM *loopParam, CORRECTION *correctio
 		   make a relative change to the actuator values.
 		 */
           controlComp->value[0][i] = controlComp->old[i] = 0;
+        if (sparse->rowStart) {
+          accumulator = 0;
+          for (k = sparse->rowStart[i]; k < sparse->rowStart[i + 1]; k++) {
+#ifdef FLOAT_MATH
+            accumulator += ((float)sparse->value[k]) * ((float)readbackComp->error[sparse->columnIndex[k]]);
+#else
+            accumulator += sparse->value[k] * readbackComp->error[sparse->columnIndex[k]];
+#endif
+          }
+          controlComp->delta[0][i] += accumulator * loopParam->compensationGain;
+          continue;
+        }
         for (j = accumulator = 0; j < readbackComp->n; j++) {
           /* cascade calculation using correction effort above
 		     to apply a change to control values.
@@ -5458,6 +5571,18 @@ long parseArguments(char ***argv,
         }
         strcpy(loopParam->postChangeExec, s_arg[i_arg].list[1]);
         break;
+      case CLO_SPARSE:
+        s_arg[i_arg].n_items--;
+        if (!scanItemList(&dummyFlags, s_arg[i_arg].list + 1, &s_arg[i_arg].n_items, 0,
+                          "density", SDDS_DOUBLE, &loopParam->sparseDensity, 1, 0,
+                          NULL) ||
+            loopParam->sparseDensity < 0 || loopParam->sparseDensity > 1) {
+          fprintf(stderr, "bad -sparse syntax; give density=<fraction> between 0 and 1\n");
+          free_scanargs(&s_arg, *argc);
+          return (1);
+        }
+        s_arg[i_arg].n_items++;
+        break;
       case CLO_FILTERFILE:
         if (s_arg[i_arg].n_items != 2) {
           fprintf(stderr, "bad -filterFilter syntax\n");
@@ -5709,6 +5834,7 @@ void initializeData(CORRECTION *correction,
   loopParam->launcherPV[4] = NULL;
   loopParam->interval = DEFAULT_TIME_INTERVAL;
   loopParam->briefStatistics = 0;
+  loopParam->sparseDensity = 0;
   aveParam->n = 1;
   aveParam->interval = DEFAULT_AVEINTERVAL;
   delta->flag = 0UL;
@@ -5852,6 +5978,8 @@ void setupData(CORRECTION *correction,
   setupDeltaLimitFile(delta);
   setupActionLimitFile(action);
   setupCompensationFiles(overlapCompensation);
+  setupSparseMatrix(correction, loopParam->sparseDensity, verbose);
+  setupSparseMatrix(overlapCompensation, loopParam->sparseDensity, verbose);
 
   if (sddscontrollawGlobal->rcParam.pingTimeout == 0.0) {
     sddscontrollawGlobal->rcParam.pingTimeout = (float)(1000 * 2 * MAX(loopParam->interval, sddscontrollawGlobal->rcParam.pingInterval));
@@ -7468,6 +7596,7 @@ long WriteWaveformData(WAVE_FORMS *controlWaveforms, CONTROL_NAME *control, doub
 
 void CleanUpCorrections(CORRECTION *correction) {
   int i;
+  freeSparseMatrix(&correction->sparseK);
   if (correction->file) {
     if (correction->K->a) {
       for (i = 0; i < correction->K->m; i++) {
@@ -7842,6 +7971,7 @@ void SetupRawPVAConnection(char **PVname, CHANNEL_INFO *channelInfo, long n, dou
   *(channelInfo[0].count) = n;
 
   allocPVA(pva, n);
+  pva->pipelinePuts = true;
   epics::pvData::shared_vector<std::string> names(n);
   epics::pvData::shared_vector<std::string> providerNames(n);
   for (j = 0; j < n; j++) {
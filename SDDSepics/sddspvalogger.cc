@@ -7,6 +7,10 @@
 #include <csignal>
 #include <cctype>
 #include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <map>
+#include <utility>
 
 #include "pvaSDDS.h"
 #include "pv/thread.h"
@@ -159,9 +163,13 @@ static char *onerror_options[ONERROR_OPTIONS] = {
 
 #define STROBE_NOTTIMEVALUE 0x0001U
 
+#define MONITOR_RANDOMTIMEDTRIGGER 0x0001U
+
 #define DAILYFILES_VERBOSE 0x0001U
 #define MONTHLYFILES_VERBOSE 0x0001U
 
+#define ONEPV_SEGMENT 0x0001U
+
 #define ALARMTRIG_HOLDOFF 0x0001UL
 #define ALARMTRIG_AUTOHOLD 0x0002UL
 #define ALARMTRIG_CONTROLNAME 0x0004UL
@@ -183,6 +191,8 @@ static char *onerror_options[ONERROR_OPTIONS] = {
 
 #define GLITCH_BEFORE_DEFAULT 100
 #define GLITCH_AFTER_DEFAULT 1
+/* Width of each string slot in the glitch circular buffer, longer strings are truncated */
+#define CIRCULARBUFFER_STRING_LENGTH 128
 
 #define TRIGGER_HOLDOFF GLITCH_HOLDOFF
 #define TRIGGER_AUTOHOLD GLITCH_AUTOHOLD
@@ -217,17 +227,51 @@ typedef struct
   bool truncateWaveforms;
   int32_t *expectElements;
   bool watchInput;
+  long reloadFirstNew;                /* First of the PVs added by the last -watchInput reload */
+  long double reloadConnectDeadline; /* Those PVs don't count as connection errors until then */
   bool monitor;
   bool monitorRandomTimedTrigger;
+  long monitorQueueSize;
+  double *queuedValues, *queuedTimes;
   bool append;
   bool overwrite;
   int32_t pvCount;
   char **controlName, **readbackName, **provider, **units;
   double *scaleFactor;
+  int32_t *monitorRequestQueueSize, *monitorDecimation;
+  double *monitorDeadband;
+  /* Log on change state, see PassesDeadbands */
+  double *deadband;
+  double keepAlive;
+  bool *logPV, *loggedConnected;
+  double *loggedValue;
+  char **loggedString;
+  long double *loggedTime;
   int32_t *scalarArrayStartIndex;
   int32_t *scalarArrayEndIndex;
   char *average;
   int64_t *outputRow, *outputPage;
+  /* Rows of the scalar columns not yet handed to SDDS in single file -scalarsAsColumns mode,
+     one buffer per PV in its storage type. See FlushRowBatch. */
+  void **rowBatch;
+  int32_t *rowBatchType;
+  int64_t rowBatchRows, rowBatchCapacity;
+  /* -rollup files, one per interval. The accumulators hold numPVs entries per rollup and
+     rollupColumn the index of the Min column of each PV, or -1 if the PV is not rolled up. */
+  long rollups;
+  double *rollupInterval;
+  SDDS_TABLE *rollupTable;
+  char **rollupFile;
+  long double *rollupStart;
+  int32_t *rollupSamples, *rollupErrors, *rollupCount, *rollupColumn;
+  int64_t *rollupRow;
+  double *rollupMin, *rollupMax, *rollupSum, *rollupLast;
+  /* -append resume index of the single output file, see WriteResumeIndex */
+  bool resumeIndex;
+  char *resumeFile;
+  FILE *resumeFp;
+  uint64_t layoutHash;
+  long double resumeTime;
   double sampleInterval;
   long logInterval;
   long flushInterval;
@@ -263,6 +307,8 @@ typedef struct
   bool verbose;
   char *onePv_OutputDirectory;
   char **onePv_outputfile, **onePv_outputfileOrig;
+  bool onePv_segment;
+  int32_t segmentPVIndex, segmentValueIndex, segmentStringIndex;
   bool mallocNeeded;
   bool doDisconnect;
   long Nsteps;
@@ -270,6 +316,10 @@ typedef struct
   bool totalTimeSet;
   double TotalTime;
   double pendIOtime;
+  long connectThreads;
+  long extractThreads;
+  bool writeBehind;
+  long writerBackpressure;
   double filesPerStep;
   long NstepsAdjusted;
   char *triggerFile, *triggerFileLastlink;
@@ -277,9 +327,14 @@ typedef struct
   struct stat triggerfilestat;
   long circularbuffer_before;
   long circularbuffer_after;
-  double ***circularbufferDouble;
+  /* Glitch history ring. Each numeric PV, followed by the number of unconnected PVs, the time
+     of day and the day of month, owns circularbuffer_length consecutive slots of its element
+     count in circularbufferDouble starting at circularbufferOffset[i]. Non-numeric PVs do the
+     same in circularbufferString with CIRCULARBUFFER_STRING_LENGTH bytes per element. */
+  double *circularbufferDouble;
   long double *circularbufferLongDouble;
-  char ****circularbufferString;
+  char *circularbufferString;
+  int64_t *circularbufferOffset;
   long circularbuffer_length;
   long circularbuffer_index;
   int delay;
@@ -323,14 +378,66 @@ typedef struct
   double DayNow, LastDay, HourNow, LastHour;
 } LOGGER_DATA;
 
+/* Write-behind thread used with -writeBehind. The sampling loop hands each step's page flush
+   to it and only waits for it (a backpressure event) when it needs the SDDS tables again
+   while the previous flush is still running, so at most one flush is ever queued. */
+typedef struct
+{
+  std::thread thread;
+  epics::pvData::Mutex mutex;
+  epics::pvData::Event work, idle;
+  bool busy, stop, failed;
+  int64_t step;
+  long backpressure;
+  SDDS_TABLE *SDDS_table;
+  PVA_OVERALL *pva;
+  LOGGER_DATA *logger;
+} LOGGER_WRITER;
+static LOGGER_WRITER *writer = NULL;
+
+/* Per-step timing written to the -statsFile file and kept for the last LOGGER_TIMING_HISTORY
+   steps so a p50/p99/max summary can be printed on SIGUSR1 and, with -verbose, at exit. */
+#define LOGGER_TIMING_HISTORY 1000
+#define LOGGER_TIMING_FLUSH_ROWS 100
+#define LOGGER_TIMING_FIELDS 7
+#define LOGGER_TIMING_LATENESS 0
+#define LOGGER_TIMING_WAIT 1
+#define LOGGER_TIMING_GET 2
+#define LOGGER_TIMING_EXTRACT 3
+#define LOGGER_TIMING_WRITEDATA 4
+#define LOGGER_TIMING_FLUSH 5
+#define LOGGER_TIMING_CYCLE 6
+static const char *timingName[LOGGER_TIMING_FIELDS] = {
+  "Lateness", "WaitTime", "GetTime", "ExtractTime", "WriteDataTime", "FlushTime", "CycleTime"};
+
+typedef struct
+{
+  char *filename;
+  SDDS_TABLE table;
+  int64_t row;
+  long double start, scheduled, sample, acquired;
+  double value[LOGGER_TIMING_FIELDS];
+  double history[LOGGER_TIMING_FIELDS][LOGGER_TIMING_HISTORY];
+  long historyCount, historyNext;
+} LOGGER_TIMING;
+static LOGGER_TIMING timing;
+
 long WriteHeaders(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
 long WriteAccessoryData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
 long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
+long WriteQueuedReadings(SDDS_TABLE *sdds, PVA_OVERALL *pva, LOGGER_DATA *logger, long n, long j);
+long WriteSegmentHeader(SDDS_TABLE *sdds, PVA_OVERALL *pva, LOGGER_DATA *logger);
+bool PassesDeadbands(PVA_OVERALL *pva, LOGGER_DATA *logger);
+long WriteSegmentData(SDDS_TABLE *sdds, PVA_OVERALL *pva, LOGGER_DATA *logger);
+long OpenRollupFiles(PVA_OVERALL *pva, LOGGER_DATA *logger);
+long UpdateRollups(PVA_OVERALL *pva, LOGGER_DATA *logger);
+long CloseRollupFiles(PVA_OVERALL *pva, LOGGER_DATA *logger);
 long pvaThreadSleep(long double seconds);
 long pvaThreadSleepWithPolling(PVA_OVERALL **pva, long count, long double targetTime);
 long pvaThreadSleepWithPollingAndDataStrobe(PVA_OVERALL **pva, long count, PVA_OVERALL *pvaTrig, bool randomTime, double hold_off);
 long VerifyPVTypes(PVA_OVERALL *pva, LOGGER_DATA *logger);
 long ReadInputFiles(LOGGER_DATA *logger);
+long ReadPVListFile(LOGGER_DATA *logger);
 long ReadConditionsFile(LOGGER_DATA *logger);
 long ReadGlitchTriggerFile(LOGGER_DATA *logger);
 long VerifyFileIsAppendable(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
@@ -341,6 +448,14 @@ bool PassesInhibitPVA(PVA_OVERALL *pvaInhibit, LOGGER_DATA *logger);
 void AverageData(PVA_OVERALL *pva, LOGGER_DATA *logger);
 long StartPages(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
 long UpdateAndWritePages(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
+long FlushPages(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger, int64_t step);
+void StartWriter(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
+long WaitForWriter();
+long StopWriter();
+long OpenTimingStats();
+long RecordTiming(PVA_OVERALL **pvaArray, long count, LOGGER_DATA *logger);
+void PrintTimingSummary(FILE *fp);
+long CloseTimingStats();
 long CloseFiles(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
 long InitiateRunControl();
 long PingRunControl();
@@ -354,7 +469,11 @@ long SetupPVs(PVA_OVERALL *pva, PVA_OVERALL *pvaConditions, PVA_OVERALL *pvaTrig
 long GenerationsCheck(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
 long CheckInhibitPV(SDDS_TABLE *SDDS_table, PVA_OVERALL *pvaInhibit, LOGGER_DATA *logger);
 void freeLogger(LOGGER_DATA *logger);
-long WatchInput(LOGGER_DATA *logger);
+void AllocateEmptyColumns(LOGGER_DATA *logger);
+void FreeEmptyColumns(LOGGER_DATA *logger);
+long WatchInput(SDDS_TABLE **SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
+long NotConnectedPVs(PVA_OVERALL *pva, LOGGER_DATA *logger);
+long ReloadInputFile(SDDS_TABLE **SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger);
 void AllocateCircularBuffers(PVA_OVERALL *pva, LOGGER_DATA *logger);
 void FreeCircularBuffers(LOGGER_DATA *logger);
 void StoreDataIntoCircularBuffers(PVA_OVERALL *pva, LOGGER_DATA *logger);
@@ -367,12 +486,20 @@ void rc_interrupt_handler();
 
 static volatile sig_atomic_t sigint = 0;
 static volatile sig_atomic_t sigintSignal = 0;
+static volatile sig_atomic_t timingSummaryRequested = 0;
+
+#ifndef _WIN32
+static void timing_summary_handler(int sig) {
+  timingSummaryRequested = 1;
+}
+#endif
 
 static void InstallTerminationSignalHandlers(void) {
   signal(SIGINT, sigint_interrupt_handler);
   signal(SIGTERM, sigint_interrupt_handler);
 #ifndef _WIN32
   signal(SIGQUIT, sigint_interrupt_handler);
+  signal(SIGUSR1, timing_summary_handler);
 #endif
 }
 
@@ -404,7 +531,13 @@ static void InstallTerminationSignalHandlers(void) {
 #define CLO_AUTOHOLDOFF 25
 #define CLO_STRICTPVVERIFICATION 26
 #define CLO_TRUNCATEWAVEFORMS 27
-#define COMMANDLINE_OPTIONS 28
+#define CLO_CONNECTTHREADS 28
+#define CLO_EXTRACTTHREADS 29
+#define CLO_WRITEBEHIND 30
+#define CLO_STATSFILE 31
+#define CLO_KEEPALIVE 32
+#define CLO_ROLLUP 33
+#define COMMANDLINE_OPTIONS 34
 static char *commandline_option[COMMANDLINE_OPTIONS] = {
   (char *)"sampleInterval",
   (char *)"logInterval",
@@ -434,13 +567,21 @@ static char *commandline_option[COMMANDLINE_OPTIONS] = {
   (char *)"autoHoldoff",
   (char *)"strictPVverification",
   (char *)"truncateWaveforms",
+  (char *)"connectThreads",
+  (char *)"extractThreads",
+  (char *)"writeBehind",
+  (char *)"statsFile",
+  (char *)"keepAlive",
+  (char *)"rollup",
 };
 
 static char *USAGE = (char *)"sddspvalogger <inputfile> <outputfile> \n\
 Global Options:\n\
   [-pendIOtime=<value>]\n\
+  [-connectThreads=<integer>]\n\
+  [-extractThreads=<integer>]\n\
   [-watchInput]\n\
-  [-monitorMode=[randomTimedTrigger]]\n\
+  [-monitorMode=[randomTimedTrigger][,queueSize=<number>]]\n\
   [-append | -overwrite]\n\
   [-sampleInterval=<real-value>[,<time-units>]]\n\
   [-dataStrobePV=<PVname>,<provider>[,notTimeValue][,holdoff=<seconds>]]\n\
@@ -456,11 +597,15 @@ Global Options:\n\
   [-truncateWaveforms]\n\
   [-runControlPV=string=<string>,pingTimeout=<seconds>]\n\
   [-runControlDescription=string=<string>]\n\
+  [-statsFile=<filename>]\n\
   [-verbose]\n\
 Logger Options:\n\
   [-logInterval=<integer-value>]\n\
   [-flushInterval=<integer-value>]\n\
-  [-onePvPerFile=<dirName>]\n\
+  [-writeBehind]\n\
+  [-keepAlive=<seconds>]\n\
+  [-rollup=<seconds>[,<seconds>...]]\n\
+  [-onePvPerFile=<dirName>[,segment]]\n\
 Glitch Logger Options:\n\
   [-triggerFile=<filename>]\n\
   [-circularBuffer=[before=<number>,][after=<number>]]\n\
@@ -482,6 +627,11 @@ inputfile        The file must contain the columns:\n\
                    ScalarArrayEndIndex (optional, integer type)\n\
                    Average (optional, character type with 'y' or 'n' values, used with the -logInterval option)\n\
                    Units (optional, string type)\n\
+                   MonitorQueueSize (optional, integer type, server queue size with -monitorMode)\n\
+                   MonitorDeadband (optional, numeric type, server-side absolute deadband)\n\
+                   MonitorDecimation (optional, integer type, server keeps 1 of every N updates)\n\
+                   Deadband or Tolerance (optional, numeric type, only log a sample when a PV moved more\n\
+                     than this from the value last logged, negative values always log)\n\
 conditions file  The file must contain the columns:\n\
                    ControlName (string type with PV names)\n\
                    Provider (string type with \"pva\" or \"ca\" values)\n\
@@ -517,7 +667,7 @@ RUNCONTROL_PARAM rcParam;
 
 int main(int argc, char *argv[]) {
   SCANNED_ARG *s_arg;
-  long j;
+  long j, status = 0;
   long double targetTime = 0, timeToWait = 0;
   SDDS_TABLE *SDDS_table;
   PVA_OVERALL pva, pva2, pva3, pva4, pva5;
@@ -592,6 +742,12 @@ int main(int argc, char *argv[]) {
   pvaArray[1] = pvaStrobe;
   pvaArray[2] = pvaConditions;
   pvaArray[3] = pvaGlitch;
+  //Keep numeric scalar arrays in their native type so they can be written without converting through double
+  for (j = 0; j < pva.numPVs; j++) {
+    if (logger.expectScalarArray[j] && !logger.treatScalarArrayAsScalar[j] && logger.expectNumeric[j]) {
+      pva.pvaData[j].useNativeValues = true;
+    }
+  }
   if (GetPVAValues(pvaArray, 4) == 1) {
     return (1);
   }
@@ -624,7 +780,9 @@ int main(int argc, char *argv[]) {
   }
 
   //Allocate SDDS_table pointers
-  if (logger.onePv_OutputDirectory != NULL) {
+  if (logger.onePv_segment) {
+    SDDS_table = (SDDS_TABLE *)malloc(sizeof(SDDS_TABLE));
+  } else if (logger.onePv_OutputDirectory != NULL) {
     SDDS_table = (SDDS_TABLE *)malloc(sizeof(SDDS_TABLE) * pva.numPVs);
     if (pva.numPVs > 40) {
       logger.doDisconnect = true;
@@ -654,16 +812,24 @@ int main(int argc, char *argv[]) {
   }
 
   //Setup empty column data in case scalarArrays are disconnected
-  logger.emptyColumn = (double *)malloc(sizeof(double) * logger.n_rows);
-  logger.emptyStringColumn = (char **)malloc(sizeof(char *) * logger.n_rows);
-  for (j = 0; j < logger.n_rows; j++) {
-    logger.emptyStringColumn[j] = (char *)malloc(sizeof(char));
-    logger.emptyStringColumn[j][0] = 0;
-    logger.emptyColumn[j] = 0;
-  }
+  AllocateEmptyColumns(&logger);
 
   //Setup monitoring
   if (logger.monitor) {
+    //Let the monitor callbacks record which PVs changed so polling does not have to scan every PV
+    pva.useMonitorReadyList = true;
+    if (logger.monitorQueueSize > 0) {
+      //Keep every update of the logged PVs so each one can be written with its time stamp
+      pva.monitorQueueSize = logger.monitorQueueSize;
+      logger.queuedValues = (double *)malloc(sizeof(double) * logger.monitorQueueSize);
+      logger.queuedTimes = (double *)malloc(sizeof(double) * logger.monitorQueueSize);
+    }
+    if (pvaConditions != NULL) {
+      pvaConditions->useMonitorReadyList = true;
+    }
+    if (pvaGlitch != NULL) {
+      pvaGlitch->useMonitorReadyList = true;
+    }
     if ((MonitorPVAValues(&pva) == 1) ||
         (MonitorPVAValues(pvaConditions) == 1) ||
         (MonitorPVAValues(pvaGlitch) == 1)) {
@@ -683,6 +849,9 @@ int main(int argc, char *argv[]) {
 
   //Setup monitor for strobe trigger PV
   if (pvaStrobe != NULL) {
+    if (logger.monitor) {
+      pvaStrobe->useMonitorReadyList = true;
+    }
     if (MonitorPVAValues(pvaStrobe) == 1) {
       return (1);
     }
@@ -705,6 +874,13 @@ int main(int argc, char *argv[]) {
 
   logger.NstepsAdjusted = logger.Nsteps;
 
+  if (OpenTimingStats() == 1) {
+    return (1);
+  }
+  if (logger.writeBehind) {
+    StartWriter(SDDS_table, &pva, &logger);
+  }
+
   //Main loop
   for (logger.step = 0; logger.step < logger.Nsteps && logger.step != logger.NstepsAdjusted; logger.step++) {
     if (sigint) {
@@ -715,21 +891,23 @@ int main(int argc, char *argv[]) {
       break;
     }
 
-    //Check to see if we should close the generations, daily or monthly file and start a new one
-    if (GenerationsCheck(SDDS_table, &pva, &logger) == 1) {
-      return (1);
-    }
-
     //Check inhibit PV
     j = CheckInhibitPV(SDDS_table, pvaInhibit, &logger);
     if (j == -1) {
-      CloseFiles(SDDS_table, &pva, &logger);
-      return (1);
+      status = 1;
+      break;
     } else if (j == 1) {
       continue;
     }
 
     //Get the PV values
+    timing.start = getLongDoubleTimeInSecs();
+    timing.scheduled = (pvaStrobe == NULL) ? targetTime : 0;
+    for (j = 0; j < 3; j++) {
+      if (pvaArray[j] != NULL) {
+        pvaArray[j]->extractTime = 0;
+      }
+    }
     if (logger.monitor) {
       if (logger.verbose) {
         fprintf(stdout, "Monitoring PV values for step %ld\n", (long)(logger.step + 1));
@@ -740,8 +918,8 @@ int main(int argc, char *argv[]) {
           if (sigint) {
             break;
           }
-          CloseFiles(SDDS_table, &pva, &logger);
-          return (1);
+          status = 1;
+          break;
         }
       } else {
         timeToWait = targetTime - getLongDoubleTimeInSecs();
@@ -750,10 +928,11 @@ int main(int argc, char *argv[]) {
           if (sigint) {
             break;
           }
-          CloseFiles(SDDS_table, &pva, &logger);
-          return (1);
+          status = 1;
+          break;
         }
       }
+      timing.sample = timing.acquired = getLongDoubleTimeInSecs();
     } else {
       freePVAGetReadings(&pva);
       freePVAGetReadings(pvaConditions);
@@ -770,8 +949,8 @@ int main(int argc, char *argv[]) {
         while (1) {
           long w = WaitEventMonitoredPVA(pvaStrobe, 0, 1.0);
           if (w == 1) {
-            CloseFiles(SDDS_table, &pva, &logger);
-            return (1);
+            status = 1;
+            break;
           }
           if (w == 0) {
             break;
@@ -780,17 +959,20 @@ int main(int argc, char *argv[]) {
             break;
           }
           if (PingRunControl() != 0) {
-            CloseFiles(SDDS_table, &pva, &logger);
-            return (1);
+            status = 1;
+            break;
           }
         }
+        if (status) {
+          break;
+        }
         if (logger.datastrobe_holdoff > 1e-7) {
           if (pvaThreadSleep(logger.datastrobe_holdoff) == 1) {
             if (sigint) {
               break;
             }
-            CloseFiles(SDDS_table, &pva, &logger);
-            return (1);
+            status = 1;
+            break;
           }
         }
       } else {
@@ -799,15 +981,31 @@ int main(int argc, char *argv[]) {
           if (sigint) {
             break;
           }
-          CloseFiles(SDDS_table, &pva, &logger);
-          return (1);
+          status = 1;
+          break;
         }
       }
 
+      timing.sample = getLongDoubleTimeInSecs();
       if (GetPVAValues(pvaArray, 3) == 1) {
-        CloseFiles(SDDS_table, &pva, &logger);
-        return (1);
+        status = 1;
+        break;
       }
+      timing.acquired = getLongDoubleTimeInSecs();
+    }
+
+    //The sample has been taken, so wait for the previous step's pages to finish writing
+    timing.value[LOGGER_TIMING_FLUSH] = getLongDoubleTimeInSecs();
+    if (WaitForWriter() == 1) {
+      status = 1;
+      break;
+    }
+    timing.value[LOGGER_TIMING_FLUSH] = getLongDoubleTimeInSecs() - timing.value[LOGGER_TIMING_FLUSH];
+
+    //Check to see if we should close the generations, daily or monthly file and start a new one
+    if (GenerationsCheck(SDDS_table, &pva, &logger) == 1) {
+      status = 1;
+      break;
     }
 
     //Time column represents time after get command completed, not before. Unless we are
@@ -842,7 +1040,8 @@ int main(int argc, char *argv[]) {
 
     //Verify PV types that may have just connected for the first time
     if (VerifyPVTypes(&pva, &logger) == 1) {
-      return (1);
+      status = 1;
+      break;
     }
 
     //Check to see if we have run out of time
@@ -853,19 +1052,26 @@ int main(int argc, char *argv[]) {
     }
 
     //Check input file for changes
-    if (WatchInput(&logger) == 1) {
+    j = WatchInput(&SDDS_table, &pva, &logger);
+    if (j == -1) {
+      status = 1;
       break;
+    } else if (j == 1) {
+      break;
+    } else if (j == 2) {
+      continue;
     }
 
     //Check to see if we should exit or skip due to connection errors
     if ((logger.onerrorindex == ONERROR_EXIT) || (logger.onerrorindex == ONERROR_SKIP)) {
-      if ((pva.numNotConnected > 0) ||
+      if ((NotConnectedPVs(&pva, &logger) > 0) ||
           ((pvaConditions != NULL) && (pvaConditions->numNotConnected)) ||
           ((pvaGlitch != NULL) && (pvaGlitch->numNotConnected)) ||
           ((pvaStrobe != NULL) && (pvaStrobe->numNotConnected))) {
         if (logger.onerrorindex == ONERROR_EXIT) {
           fprintf(stdout, "Exiting due to PV connection error.\n");
-          return (1);
+          status = 1;
+          break;
         } else {
           if (logger.verbose) {
             fprintf(stdout, "Skipping due to connection error.\n");
@@ -884,7 +1090,8 @@ int main(int argc, char *argv[]) {
        */
       if (logger.onePv_OutputDirectory != NULL && logger.scalarsAsColumns && (logger.flushInterval > 0)) {
         if (UpdateAndWritePages(SDDS_table, &pva, &logger) == 1) {
-          return (1);
+          status = 1;
+          break;
         }
       }
       continue;
@@ -893,39 +1100,76 @@ int main(int argc, char *argv[]) {
     //Check for glitches and write glitch files if needed
     j = GlitchLogicRoutines(SDDS_table, &pva, pvaGlitch, &logger);
     if (j == 1) {
-      return (1);
+      status = 1;
+      break;
     } else if (j == 2) {
       continue;
     }
 
     //Start pages if needed
+    timing.value[LOGGER_TIMING_WRITEDATA] = getLongDoubleTimeInSecs();
     if (StartPages(SDDS_table, &pva, &logger) == 1) {
-      return (1);
+      status = 1;
+      break;
     }
 
     //Average the data if needed
     if ((logger.logInterval > 1) && (logger.average != NULL) && (logger.onePv_OutputDirectory == NULL)) {
       AverageData(&pva, &logger); //FIX THIS for enum values
     }
+    if (UpdateRollups(&pva, &logger) == 1) {
+      status = 1;
+      break;
+    }
 
     if (logger.logInterval <= 0) {
       fprintf(stderr, "Error (sddspvalogger): internal error: logInterval=%ld (must be >= 1)\n", logger.logInterval);
-      return (1);
+      status = 1;
+      break;
     }
     if ((logger.step + 1) % logger.logInterval == 0) //FIX THIS check that the loginterval option really works
     {
-      //Write column and parameter data
-      if (WriteData(SDDS_table, &pva, &logger)) {
-        return (1);
+      //Skip writing the sample if no PV moved outside its deadband, but still flush and record the timing
+      if (PassesDeadbands(&pva, &logger) == false) {
+        if ((logger.logInterval > 1) && (logger.average != NULL)) {
+          for (j = 0; j < pva.numPVs; j++) {
+            logger.averagedValues[j] = 0;
+          }
+        }
+      } else if (WriteData(SDDS_table, &pva, &logger)) {
+        //Write column and parameter data
+        status = 1;
+        break;
       }
     }
+    timing.value[LOGGER_TIMING_WRITEDATA] = getLongDoubleTimeInSecs() - timing.value[LOGGER_TIMING_WRITEDATA];
 
     //Update and write pages if needed
+    timing.value[LOGGER_TIMING_FLUSH] -= getLongDoubleTimeInSecs();
     if (UpdateAndWritePages(SDDS_table, &pva, &logger) == 1) {
-      return (1);
+      status = 1;
+      break;
+    }
+    timing.value[LOGGER_TIMING_FLUSH] += getLongDoubleTimeInSecs();
+
+    if (RecordTiming(pvaArray, 3, &logger) == 1) {
+      status = 1;
+      break;
+    }
+    if (timingSummaryRequested) {
+      timingSummaryRequested = 0;
+      PrintTimingSummary(stdout);
     }
   } //End Main Loop
 
+  //Errors in the main loop break out with status set so the pages written so far are flushed and closed
+  if (StopWriter() == 1) {
+    status = 1;
+  }
+  if (CloseTimingStats() == 1) {
+    status = 1;
+  }
+
   //Close SDDS file
   if ((logger.verbose) && (logger.onePv_OutputDirectory == NULL)) {
     fprintf(stdout, "Data written to %s\n", logger.outputfile);
@@ -934,6 +1178,17 @@ int main(int argc, char *argv[]) {
     return (1);
   }
 
+  if (logger.verbose) {
+    PVA_ARENA_STATS stats;
+    if (logger.writeBehind) {
+      fprintf(stdout, "Write-behind backpressure events: %ld\n", logger.writerBackpressure);
+    }
+    PrintTimingSummary(stdout);
+    GetPVAArenaStats(&pva, &stats);
+    fprintf(stdout, "PV buffers: %zu bytes reserved, %zu bytes in use (peak %zu), %ld system allocations, %ld reused slots\n",
+            stats.bytesReserved, stats.bytesInUse, stats.peakBytesInUse, stats.systemAllocations, stats.reusedSlots);
+  }
+
   //Free memory
   free(SDDS_table);
   free(pvaArray);
@@ -947,17 +1202,191 @@ int main(int argc, char *argv[]) {
   freePVA(pvaGlitch);
   freeLogger(&logger);
   free_scanargs(&s_arg, argc);
-  return (0);
+  return (status);
+}
+
+/*
+  Set outputfile from outputfileOrig and the -generations, -dailyFiles or -monthlyFiles options.
+*/
+static void MakeOutputFilename(LOGGER_DATA *logger) {
+  if (logger->generations) {
+    if (logger->mallocNeeded == false) {
+      free(logger->outputfile);
+    }
+    logger->outputfile = MakeGenerationFilename(logger->outputfileOrig, logger->generationsDigits, logger->generationsDelimiter, NULL);
+    if (logger->verbose) {
+      fprintf(stdout, "New generation file started: %s\n", logger->outputfile);
+    }
+  } else if (logger->dailyFiles) {
+    if (logger->mallocNeeded == false) {
+      free(logger->outputfile);
+    }
+    logger->outputfile = MakeDailyGenerationFilename(logger->outputfileOrig, logger->generationsDigits, logger->generationsDelimiter, logger->timetag);
+    if (logger->dailyFilesVerbose) {
+      fprintf(stdout, "New generation file started: %s\n", logger->outputfile);
+    }
+  } else if (logger->monthlyFiles) {
+    if (logger->mallocNeeded == false) {
+      free(logger->outputfile);
+    }
+    logger->outputfile = MakeMonthlyGenerationFilename(logger->outputfileOrig, logger->generationsDigits, logger->generationsDelimiter, logger->timetag);
+    if (logger->monthlyFilesVerbose) {
+      fprintf(stdout, "New generation file started: %s\n", logger->outputfile);
+    }
+  } else {
+    SDDS_CopyString(&(logger->outputfile), logger->outputfileOrig);
+  }
+}
+
+/*
+  With -append a one line resume index, <outputfile>.resume, is rewritten in place after
+  every flush of the single output file. It holds a hash of the logged elements, the size
+  and modification time of the output file, the page count, the rows of the last page and
+  the time of the last sample. If the output file still has that size and time when the
+  logger restarts, nothing was written after the last flush, so the file is intact and
+  logging resumes on a new page at its end without reading the data. Otherwise the whole
+  file is checked as before.
+*/
+static void CloseResumeIndex(LOGGER_DATA *logger) {
+  if (logger->resumeFp) {
+    fclose(logger->resumeFp);
+    logger->resumeFp = NULL;
+  }
+}
+
+static uint64_t HashBytes(const char *text, size_t length) {
+  uint64_t hash = 14695981039346656037ULL;
+  size_t i;
+  for (i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)text[i]) * 1099511628211ULL;
+  }
+  return (hash);
+}
+
+/*
+  Hash of the names, types and kinds of the elements checked by VerifyFileIsAppendable.
+*/
+static uint64_t LayoutHash(PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  long j;
+  int sddstype;
+  char buffer[100];
+  std::string layout;
+
+  snprintf(buffer, sizeof(buffer), "%d %d %d\n", (int)logger->scalarsAsColumns, (int)logger->scalarArraysAsColumns, (int)logger->glitch_pvCount);
+  layout = buffer;
+  for (j = 0; j < pva->numPVs; j++) {
+    sddstype = logger->expectNumeric[j] ? SDDS_DOUBLE : SDDS_STRING;
+    if (logger->storageType && (logger->storageType[j] != 0)) {
+      sddstype = logger->storageType[j];
+    }
+    snprintf(buffer, sizeof(buffer), " %d %d\n", sddstype, (logger->expectScalar[j] || logger->treatScalarArrayAsScalar[j]) ? 0 : 1);
+    layout += logger->readbackName[j];
+    layout += buffer;
+  }
+  return (HashBytes(layout.c_str(), layout.size()));
+}
+
+/*
+  Returns true if the resume index matches the output file.
+*/
+static bool ReadResumeIndex(LOGGER_DATA *logger, long long *pages, long long *rows, long double *lastTime) {
+  FILE *fp;
+  char line[256], *end;
+  unsigned long long hash, checksum;
+  long long size, mtime;
+  struct stat st;
+
+  if ((fp = fopen(logger->resumeFile, "r")) == NULL) {
+    return (false);
+  }
+  end = fgets(line, sizeof(line), fp);
+  fclose(fp);
+  if ((end == NULL) || ((end = strrchr(line, ' ')) == NULL) ||
+      (sscanf(end, " %llx", &checksum) != 1) || (checksum != HashBytes(line, end - line)) ||
+      (sscanf(line, "sddspvalogger-resume %llx %lld %lld %lld %lld %Lf", &hash, &size, &mtime, pages, rows, lastTime) != 6)) {
+    return (false);
+  }
+  if ((hash != logger->layoutHash) || (stat(logger->outputfile, &st) != 0) ||
+      ((long long)st.st_size != size) || ((long long)st.st_mtime != mtime)) {
+    return (false);
+  }
+  return (true);
+}
+
+/*
+  Record the state of the output file after a flush. FlushPages calls this on the
+  write-behind thread when -writeBehind is used.
+*/
+static void WriteResumeIndex(LOGGER_DATA *logger) {
+  char line[256];
+  int length;
+  struct stat st;
+
+  if ((logger->resumeFp == NULL) || (stat(logger->outputfile, &st) != 0)) {
+    return;
+  }
+  length = snprintf(line, sizeof(line), "sddspvalogger-resume %016llx %20lld %20lld %20lld %20lld %24.6Lf",
+                    (unsigned long long)logger->layoutHash, (long long)st.st_size, (long long)st.st_mtime,
+                    (long long)logger->outputPage[0], (long long)logger->outputRow[0], logger->resumeTime);
+  snprintf(line + length, sizeof(line) - length, " %016llx\n", (unsigned long long)HashBytes(line, length));
+  rewind(logger->resumeFp);
+  fputs(line, logger->resumeFp);
+  fflush(logger->resumeFp);
+}
+
+/*
+  Point the resume index at the current output file. Returns true if the output file can be
+  appended to without reading it, in which case outputPage[0] is restored from the index.
+*/
+static bool OpenResumeIndex(PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  char *name;
+  size_t len;
+  long long pages = 0, rows = 0;
+  long double lastTime = 0;
+  bool resume;
+
+  if (!logger->resumeIndex) {
+    return (false);
+  }
+  CloseResumeIndex(logger);
+  len = strlen(logger->outputfile) + 8;
+  name = (char *)malloc(sizeof(char) * len);
+  snprintf(name, len, "%s.resume", logger->outputfile);
+  if (logger->resumeFile) {
+    //Nothing more will be appended to the previous output file
+    if (strcmp(logger->resumeFile, name) != 0) {
+      remove(logger->resumeFile);
+    }
+    free(logger->resumeFile);
+  }
+  logger->resumeFile = name;
+  logger->layoutHash = LayoutHash(pva, logger);
+  resume = logger->append && ReadResumeIndex(logger, &pages, &rows, &lastTime);
+  if (resume) {
+    //Continue the page count of the previous run. Its last page is not reopened, so the row count is only reported.
+    logger->outputPage[0] = pages;
+    if (logger->verbose) {
+      fprintf(stdout, "Resuming %s after page %lld row %lld, last sample at %.6Lf\n", logger->outputfile, pages, rows, lastTime);
+    }
+  }
+  if ((logger->resumeFp = fopen(logger->resumeFile, "w")) == NULL) {
+    fprintf(stderr, "Warning (sddspvalogger): unable to write %s\n", logger->resumeFile);
+  }
+  return (resume);
 }
 
 long WriteHeaders(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
   long j, len;
+  bool resume;
   int sddstype;
   char *units = NULL, buffer[1024], descrip[1024];
   SDDS_TABLE *sdds;
 
   if (logger->onePv_OutputDirectory != NULL) {
 #if !defined(_WIN32)
+    if (logger->onePv_segment) {
+      return (WriteSegmentHeader(&(SDDS_table[0]), pva, logger));
+    }
     if (logger->mallocNeeded) {
       logger->onePv_outputfileOrig = (char **)malloc(sizeof(char *) * pva->numPVs);
       logger->onePv_outputfile = (char **)malloc(sizeof(char *) * pva->numPVs);
@@ -1177,33 +1606,7 @@ long WriteHeaders(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger)
       logger->n_rows = logger->flushInterval;
     }
   }
-  if (logger->generations) {
-    if (logger->mallocNeeded == false) {
-      free(logger->outputfile);
-    }
-    logger->outputfile = MakeGenerationFilename(logger->outputfileOrig, logger->generationsDigits, logger->generationsDelimiter, NULL);
-    if (logger->verbose) {
-      fprintf(stdout, "New generation file started: %s\n", logger->outputfile);
-    }
-  } else if (logger->dailyFiles) {
-    if (logger->mallocNeeded == false) {
-      free(logger->outputfile);
-    }
-    logger->outputfile = MakeDailyGenerationFilename(logger->outputfileOrig, logger->generationsDigits, logger->generationsDelimiter, logger->timetag);
-    if (logger->dailyFilesVerbose) {
-      fprintf(stdout, "New generation file started: %s\n", logger->outputfile);
-    }
-  } else if (logger->monthlyFiles) {
-    if (logger->mallocNeeded == false) {
-      free(logger->outputfile);
-    }
-    logger->outputfile = MakeMonthlyGenerationFilename(logger->outputfileOrig, logger->generationsDigits, logger->generationsDelimiter, logger->timetag);
-    if (logger->monthlyFilesVerbose) {
-      fprintf(stdout, "New generation file started: %s\n", logger->outputfile);
-    }
-  } else {
-    SDDS_CopyString(&(logger->outputfile), logger->outputfileOrig);
-  }
+  MakeOutputFilename(logger);
   makeTimeBreakdown(getTimeInSecs(), NULL, &(logger->DayNow), &(logger->HourNow), NULL, NULL, NULL, NULL);
   logger->mallocNeeded = false;
 
@@ -1216,9 +1619,13 @@ long WriteHeaders(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger)
   } else {
     logger->append = false;
   }
+  if (OpenRollupFiles(pva, logger) == 1) {
+    return (1);
+  }
+  resume = OpenResumeIndex(pva, logger);
 
   if (logger->append) {
-    if (!SDDS_CheckFile(logger->outputfile)) {
+    if (!resume && !SDDS_CheckFile(logger->outputfile)) {
       if (!SDDS_RecoverFile(logger->outputfile, RECOVERFILE_VERBOSE)) {
         fprintf(stderr, "error: Unable to append to corrupted file\n");
         return (1);
@@ -1227,7 +1634,7 @@ long WriteHeaders(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger)
     if (VerifyFileIsAppendable(sdds, pva, logger) == 1) {
       return (1);
     }
-    if (logger->scalarsAsColumns) {
+    if (logger->scalarsAsColumns && !resume) {
       if (!SDDS_InitializeAppendToPage(sdds, logger->outputfile, logger->n_rows, &(logger->outputRow[0]))) {
         SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
         return (1);
@@ -1237,6 +1644,15 @@ long WriteHeaders(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger)
         SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
         return (1);
       }
+      if (logger->scalarsAsColumns) {
+        //Continue on a new page so the last one does not have to be read
+        if (!SDDS_StartPage(sdds, logger->n_rows)) {
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+          return (1);
+        }
+        logger->outputRow[0] = 0;
+        logger->outputPage[0]++;
+      }
     }
     SDDS_EnableFSync(sdds);
     return (0);
@@ -1391,72 +1807,79 @@ long WriteHeaders(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger)
   return (0);
 }
 
+static long CircularBufferElements(LOGGER_DATA *logger, long i) {
+  return ((i < logger->pvCount) ? logger->expectElements[i] : 1);
+}
+
+/* Element 0 of a numeric PV (or accessory value) in the given slot */
+static double *CircularBufferDoubles(LOGGER_DATA *logger, long i, long slot) {
+  return (logger->circularbufferDouble + logger->circularbufferOffset[i] + slot * CircularBufferElements(logger, i));
+}
+
+/* Element k of a non-numeric PV in the given slot */
+static char *CircularBufferString(LOGGER_DATA *logger, long i, long slot, long k) {
+  return (logger->circularbufferString +
+          (logger->circularbufferOffset[i] + slot * CircularBufferElements(logger, i) + k) * CIRCULARBUFFER_STRING_LENGTH);
+}
+
+static void SetCircularBufferString(LOGGER_DATA *logger, long i, long slot, long k, const char *value) {
+  char *dest = CircularBufferString(logger, i, slot, k);
+  strncpy(dest, value ? value : "", CIRCULARBUFFER_STRING_LENGTH - 1);
+  dest[CIRCULARBUFFER_STRING_LENGTH - 1] = 0;
+}
+
 void AllocateCircularBuffers(PVA_OVERALL *pva, LOGGER_DATA *logger) {
-  long i, j, k;
+  long i;
+  int64_t doubles = 0, strings = 0;
+
   logger->circularbuffer_length = logger->circularbuffer_before + logger->circularbuffer_after + 1;
   logger->circularbuffer_index = 0;
-  logger->circularbufferDouble = (double ***)malloc(sizeof(double **) * (logger->pvCount + 3));
-  logger->circularbufferString = (char ****)malloc(sizeof(char ***) * logger->pvCount);
-  for (i = 0; i < logger->pvCount; i++) {
-    if (logger->expectElements[i] < 1) {
+  logger->circularbufferOffset = (int64_t *)malloc(sizeof(int64_t) * (logger->pvCount + 3));
+  for (i = 0; i < logger->pvCount + 3; i++) {
+    if ((i < logger->pvCount) && (logger->expectElements[i] < 1)) {
       /*
        * Defensive clamp: ExpectElements should be validated when reading the input file.
        * This guard prevents zero/negative allocations and later out-of-bounds writes.
        */
       logger->expectElements[i] = 1;
     }
-    logger->circularbufferDouble[i] = (double **)malloc(sizeof(double *) * logger->circularbuffer_length);
-    logger->circularbufferString[i] = (char ***)malloc(sizeof(char **) * logger->circularbuffer_length);
-    for (j = 0; j < logger->circularbuffer_length; j++) {
-      logger->circularbufferDouble[i][j] = (double *)malloc(sizeof(double) * logger->expectElements[i]);
-      logger->circularbufferString[i][j] = (char **)malloc(sizeof(char *) * logger->expectElements[i]);
-      for (k = 0; k < logger->expectElements[i]; k++) {
-        logger->circularbufferString[i][j][k] = NULL;
-      }
+    //The 3 accessory values after the PVs are numeric
+    if ((i >= logger->pvCount) || logger->expectNumeric[i]) {
+      logger->circularbufferOffset[i] = doubles;
+      doubles += logger->circularbuffer_length * CircularBufferElements(logger, i);
+    } else {
+      logger->circularbufferOffset[i] = strings;
+      strings += logger->circularbuffer_length * CircularBufferElements(logger, i);
     }
   }
-  //This is for the accessory data
-  for (i = logger->pvCount; i < logger->pvCount + 3; i++) {
-    logger->circularbufferDouble[i] = (double **)malloc(sizeof(double *) * logger->circularbuffer_length);
-    for (j = 0; j < logger->circularbuffer_length; j++) {
-      logger->circularbufferDouble[i][j] = (double *)malloc(sizeof(double));
-    }
+  logger->circularbufferDouble = (double *)calloc(doubles, sizeof(double));
+  logger->circularbufferString = NULL;
+  if (strings > 0) {
+    logger->circularbufferString = (char *)calloc(strings, CIRCULARBUFFER_STRING_LENGTH);
   }
   //This is the time data
   logger->circularbufferLongDouble = (long double *)malloc(sizeof(long double) * logger->circularbuffer_length);
 }
 
 void FreeCircularBuffers(LOGGER_DATA *logger) {
-  long i, j, k;
-
-  for (i = 0; i < logger->pvCount; i++) {
-    for (j = 0; j < logger->circularbuffer_length; j++) {
-      for (k = 0; k < logger->expectElements[i]; k++) {
-        free(logger->circularbufferString[i][j][k]);
-      }
-      free(logger->circularbufferString[i][j]);
-    }
-    free(logger->circularbufferString[i]);
-  }
-  for (i = 0; i < logger->pvCount + 3; i++) {
-    for (j = 0; j < logger->circularbuffer_length; j++) {
-      free(logger->circularbufferDouble[i][j]);
-    }
-    free(logger->circularbufferDouble[i]);
-  }
   free(logger->circularbufferDouble);
   free(logger->circularbufferString);
   free(logger->circularbufferLongDouble);
+  free(logger->circularbufferOffset);
+  logger->circularbufferDouble = NULL;
+  logger->circularbufferString = NULL;
+  logger->circularbufferLongDouble = NULL;
+  logger->circularbufferOffset = NULL;
 }
 
 void StoreDataIntoCircularBuffers(PVA_OVERALL *pva, LOGGER_DATA *logger) {
   long i, j, k;
-  double value;
+  double value, *values;
   j = logger->circularbuffer_index;
-  logger->circularbufferDouble[pva->numPVs][j][0] = pva->numNotConnected;
+  CircularBufferDoubles(logger, pva->numPVs, j)[0] = pva->numNotConnected;
   logger->circularbufferLongDouble[j] = logger->currentTime;
-  logger->circularbufferDouble[pva->numPVs + 1][j][0] = logger->StartHour + ((double)logger->currentTime - logger->StartTime) / 3600.0;
-  logger->circularbufferDouble[pva->numPVs + 2][j][0] = logger->StartDay + ((double)logger->currentTime - logger->StartTime) / 86400.0;
+  CircularBufferDoubles(logger, pva->numPVs + 1, j)[0] = logger->StartHour + ((double)logger->currentTime - logger->StartTime) / 3600.0;
+  CircularBufferDoubles(logger, pva->numPVs + 2, j)[0] = logger->StartDay + ((double)logger->currentTime - logger->StartTime) / 86400.0;
 
   for (i = 0; i < pva->numPVs; i++) {
     if ((pva->isConnected[i]) && (logger->verifiedType[i]) && ((logger->monitor == false) || (pva->pvaData[i].numMonitorReadings > 0))) {
@@ -1484,12 +1907,8 @@ void StoreDataIntoCircularBuffers(PVA_OVERALL *pva, LOGGER_DATA *logger) {
           if (logger->scaleFactor) {
             value *= logger->scaleFactor[i];
           }
-          logger->circularbufferDouble[i][j][0] = value;
+          CircularBufferDoubles(logger, i, j)[0] = value;
         } else {
-          if (logger->circularbufferString[i][j][0]) {
-            free(logger->circularbufferString[i][j][0]);
-            logger->circularbufferString[i][j][0] = NULL;
-          }
           const char *src = "";
           if (elemInRange) {
             if (logger->monitor) {
@@ -1502,48 +1921,30 @@ void StoreDataIntoCircularBuffers(PVA_OVERALL *pva, LOGGER_DATA *logger) {
               }
             }
           }
-          cp_str(&(logger->circularbufferString[i][j][0]),
-                 (char *)src);
+          SetCircularBufferString(logger, i, j, 0, src);
         }
       } else if (logger->expectScalarArray[i]) {
+        long elementsToCopy = logger->monitor ? pva->pvaData[i].numMonitorElements : pva->pvaData[i].numGetElements;
+        if (elementsToCopy < 0)
+          elementsToCopy = 0;
+        if (elementsToCopy > logger->expectElements[i])
+          elementsToCopy = logger->expectElements[i];
         if (logger->expectNumeric[i]) {
-          long elementsToCopy = logger->monitor ? pva->pvaData[i].numMonitorElements : pva->pvaData[i].numGetElements;
-          if (elementsToCopy < 0)
-            elementsToCopy = 0;
-          if (elementsToCopy > logger->expectElements[i])
-            elementsToCopy = logger->expectElements[i];
-          for (k = 0; k < logger->expectElements[i]; k++) {
-            logger->circularbufferDouble[i][j][k] = 0;
+          values = CircularBufferDoubles(logger, i, j);
+          if (elementsToCopy > 0) {
+            memcpy(values, GetPVADoubleValues(pva, i, 0, logger->monitor), sizeof(double) * elementsToCopy);
           }
-          if (logger->monitor) {
-            for (k = 0; k < elementsToCopy; k++) {
-              logger->circularbufferDouble[i][j][k] = pva->pvaData[i].monitorData[0].values[k];
-            }
-          } else {
-            for (k = 0; k < elementsToCopy; k++) {
-              logger->circularbufferDouble[i][j][k] = pva->pvaData[i].getData[0].values[k];
-            }
+          for (k = elementsToCopy; k < logger->expectElements[i]; k++) {
+            values[k] = 0;
           }
         } else {
-          long elementsToCopy = logger->monitor ? pva->pvaData[i].numMonitorElements : pva->pvaData[i].numGetElements;
-          if (elementsToCopy < 0)
-            elementsToCopy = 0;
-          if (elementsToCopy > logger->expectElements[i])
-            elementsToCopy = logger->expectElements[i];
           for (k = 0; k < logger->expectElements[i]; k++) {
-            if (logger->circularbufferString[i][j][k]) {
-              free(logger->circularbufferString[i][j][k]);
-              logger->circularbufferString[i][j][k] = NULL;
-            }
-            cp_str(&(logger->circularbufferString[i][j][k]), (char *)"");
-          }
-          if (logger->monitor) {
-            for (k = 0; k < elementsToCopy; k++) {
-              cp_str(&(logger->circularbufferString[i][j][k]), pva->pvaData[i].monitorData[0].stringValues[k]);
-            }
-          } else {
-            for (k = 0; k < elementsToCopy; k++) {
-              cp_str(&(logger->circularbufferString[i][j][k]), pva->pvaData[i].getData[0].stringValues[k]);
+            if (k >= elementsToCopy) {
+              SetCircularBufferString(logger, i, j, k, "");
+            } else if (logger->monitor) {
+              SetCircularBufferString(logger, i, j, k, pva->pvaData[i].monitorData[0].stringValues[k]);
+            } else {
+              SetCircularBufferString(logger, i, j, k, pva->pvaData[i].getData[0].stringValues[k]);
             }
           }
         }
@@ -1551,26 +1952,16 @@ void StoreDataIntoCircularBuffers(PVA_OVERALL *pva, LOGGER_DATA *logger) {
     } else {
       if (logger->expectScalar[i] || logger->treatScalarArrayAsScalar[i]) {
         if (logger->expectNumeric[i]) {
-          logger->circularbufferDouble[i][j][0] = 0;
+          CircularBufferDoubles(logger, i, j)[0] = 0;
         } else {
-          if (logger->circularbufferString[i][j][0]) {
-            free(logger->circularbufferString[i][j][0]);
-            logger->circularbufferString[i][j][0] = NULL;
-          }
-          cp_str(&(logger->circularbufferString[i][j][0]), (char *)"");
+          SetCircularBufferString(logger, i, j, 0, "");
         }
       } else if (logger->expectScalarArray[i]) {
         if (logger->expectNumeric[i]) {
-          for (k = 0; k < logger->expectElements[i]; k++) {
-            logger->circularbufferDouble[i][j][k] = 0;
-          }
+          memset(CircularBufferDoubles(logger, i, j), 0, sizeof(double) * logger->expectElements[i]);
         } else {
           for (k = 0; k < logger->expectElements[i]; k++) {
-            if (logger->circularbufferString[i][j][k]) {
-              free(logger->circularbufferString[i][j][k]);
-              logger->circularbufferString[i][j][k] = NULL;
-            }
-            cp_str(&(logger->circularbufferString[i][j][k]), (char *)"");
+            SetCircularBufferString(logger, i, j, k, "");
           }
         }
       }
@@ -1595,6 +1986,9 @@ long WriteAccessoryData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *l
   }
   for (n = 0; n < filecount; n++) {
     sdds = &(SDDS_table[n]);
+    if ((logger->onePv_OutputDirectory != NULL) && logger->logPV && !logger->logPV[n]) {
+      continue;
+    }
     if (logger->onePv_OutputDirectory != NULL) {
       if (logger->expectScalar[n] || logger->treatScalarArrayAsScalar[n]) {
         logger->scalarsAsColumns = true;
@@ -1747,21 +2141,170 @@ int32_t SetStringRowValue(SDDS_TABLE *sdds, long outputRow, long elementIndex, i
     }
 }
 
-int32_t SetNumericParameterValue(SDDS_TABLE *sdds, long elementIndex, int storageType, double value) {
-    switch (storageType) {
-        case SDDS_LONGDOUBLE:
-            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (long double)value);
-        case SDDS_ULONG64:
-            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (uint64_t)value);
-        case SDDS_LONG64:
-            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (int64_t)value);
-        case SDDS_ULONG:
-            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (uint32_t)value);
-        case SDDS_LONG:
-            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (int32_t)value);
-        case SDDS_USHORT:
-            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (unsigned short)value);
-        case SDDS_SHORT:
+/*
+  With one output file and -scalarsAsColumns the scalar PV values are collected for up to
+  flushInterval rows in typed column buffers and handed to SDDS with one SDDS_SetColumn call
+  per column when the rows are flushed, instead of one SDDS_SetRowValues call per value.
+*/
+static bool RowBatchActive(LOGGER_DATA *logger) {
+  return ((logger->onePv_OutputDirectory == NULL) && logger->scalarsAsColumns);
+}
+
+static bool RowBatchColumn(LOGGER_DATA *logger, long j) {
+  return (logger->expectScalar[j] || logger->treatScalarArrayAsScalar[j]);
+}
+
+/*
+  Type of the column of PV j, chosen the same way WriteHeaders does.
+*/
+static int32_t RowBatchType(LOGGER_DATA *logger, long j) {
+  if (logger->storageType && (logger->storageType[j] != 0)) {
+    return (logger->storageType[j]);
+  }
+  return (logger->expectNumeric[j] ? SDDS_DOUBLE : SDDS_STRING);
+}
+
+static long ReserveRowBatch(LOGGER_DATA *logger, int64_t rows) {
+  long j;
+  int64_t capacity;
+  if (rows <= logger->rowBatchCapacity) {
+    return (0);
+  }
+  capacity = (logger->rowBatchCapacity > 0) ? 2 * logger->rowBatchCapacity : logger->flushInterval;
+  if (capacity < rows) {
+    capacity = rows;
+  }
+  if (logger->rowBatch == NULL) {
+    logger->rowBatch = (void **)calloc(logger->pvCount, sizeof(void *));
+    logger->rowBatchType = (int32_t *)malloc(sizeof(int32_t) * (logger->pvCount > 0 ? logger->pvCount : 1));
+    for (j = 0; j < logger->pvCount; j++) {
+      logger->rowBatchType[j] = RowBatchType(logger, j);
+    }
+  }
+  for (j = 0; j < logger->pvCount; j++) {
+    if (RowBatchColumn(logger, j)) {
+      logger->rowBatch[j] = realloc(logger->rowBatch[j], SDDS_GetTypeSize(logger->rowBatchType[j]) * capacity);
+      if (logger->rowBatch[j] == NULL) {
+        fprintf(stderr, "Error (sddspvalogger): unable to allocate row buffers\n");
+        return (1);
+      }
+    }
+  }
+  logger->rowBatchCapacity = capacity;
+  return (0);
+}
+
+/*
+  Store the value of scalar PV j for the current output row. The conversions match the ones
+  SetNumericRowValue and SetStringRowValue make.
+*/
+static int32_t BatchRowValue(SDDS_TABLE *sdds, LOGGER_DATA *logger, long j, double value, const char *string) {
+  int64_t row;
+  void *column;
+  row = logger->outputRow[0] - sdds->first_row_in_mem;
+  if (ReserveRowBatch(logger, row + 1)) {
+    return (0);
+  }
+  column = logger->rowBatch[j];
+  switch (logger->rowBatchType[j]) {
+  case SDDS_LONGDOUBLE:
+    ((long double *)column)[row] = (long double)value;
+    break;
+  case SDDS_ULONG64:
+    ((uint64_t *)column)[row] = (uint64_t)value;
+    break;
+  case SDDS_LONG64:
+    ((int64_t *)column)[row] = (int64_t)value;
+    break;
+  case SDDS_ULONG:
+    ((uint32_t *)column)[row] = (uint32_t)value;
+    break;
+  case SDDS_LONG:
+    ((int32_t *)column)[row] = (int32_t)value;
+    break;
+  case SDDS_USHORT:
+    ((unsigned short *)column)[row] = (unsigned short)value;
+    break;
+  case SDDS_SHORT:
+    ((short *)column)[row] = (short)value;
+    break;
+  case SDDS_FLOAT:
+    ((float *)column)[row] = (float)value;
+    break;
+  case SDDS_CHARACTER:
+    ((char *)column)[row] = string[0];
+    break;
+  case SDDS_STRING:
+    //The PV data is replaced by the next reading, so the row keeps its own copy
+    SDDS_CopyString(&(((char **)column)[row]), string);
+    break;
+  default:
+    ((double *)column)[row] = value;
+    break;
+  }
+  if (logger->rowBatchRows < row + 1) {
+    logger->rowBatchRows = row + 1;
+  }
+  return (1);
+}
+
+/*
+  Hand the collected rows to SDDS. Must be called before the table is updated or terminated.
+*/
+long FlushRowBatch(SDDS_TABLE *sdds, LOGGER_DATA *logger) {
+  long j;
+  int64_t k;
+  long result = 0;
+  if (logger->rowBatchRows == 0) {
+    return (0);
+  }
+  for (j = 0; j < logger->pvCount; j++) {
+    if (!RowBatchColumn(logger, j)) {
+      continue;
+    }
+    if ((result == 0) && !SDDS_SetColumn(sdds, SDDS_SET_BY_INDEX, logger->rowBatch[j], logger->rowBatchRows, logger->elementIndex[j])) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      result = 1;
+    }
+    if (logger->rowBatchType[j] == SDDS_STRING) {
+      for (k = 0; k < logger->rowBatchRows; k++) {
+        free(((char **)logger->rowBatch[j])[k]);
+      }
+    }
+  }
+  logger->rowBatchRows = 0;
+  return (result);
+}
+
+void FreeRowBatch(LOGGER_DATA *logger) {
+  long j;
+  if (logger->rowBatch) {
+    for (j = 0; j < logger->pvCount; j++) {
+      free(logger->rowBatch[j]);
+    }
+    free(logger->rowBatch);
+    free(logger->rowBatchType);
+  }
+  logger->rowBatch = NULL;
+  logger->rowBatchType = NULL;
+  logger->rowBatchRows = logger->rowBatchCapacity = 0;
+}
+
+int32_t SetNumericParameterValue(SDDS_TABLE *sdds, long elementIndex, int storageType, double value) {
+    switch (storageType) {
+        case SDDS_LONGDOUBLE:
+            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (long double)value);
+        case SDDS_ULONG64:
+            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (uint64_t)value);
+        case SDDS_LONG64:
+            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (int64_t)value);
+        case SDDS_ULONG:
+            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (uint32_t)value);
+        case SDDS_LONG:
+            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (int32_t)value);
+        case SDDS_USHORT:
+            return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (unsigned short)value);
+        case SDDS_SHORT:
             return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, (short)value);
         default:
             return SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, elementIndex, value);
@@ -1856,13 +2399,610 @@ int32_t SetNumericArrayValues(SDDS_TABLE *sdds, char *name, int storageType, dou
   return result;
 }
 
+/*
+  SDDS type matching a numeric pvData scalar type, or 0 if there is none.
+*/
+static int32_t NativeSDDSType(epics::pvData::ScalarType scalarType) {
+  switch (scalarType) {
+  case epics::pvData::pvDouble:
+    return SDDS_DOUBLE;
+  case epics::pvData::pvFloat:
+    return SDDS_FLOAT;
+  case epics::pvData::pvLong:
+    return SDDS_LONG64;
+  case epics::pvData::pvULong:
+    return SDDS_ULONG64;
+  case epics::pvData::pvInt:
+    return SDDS_LONG;
+  case epics::pvData::pvUInt:
+    return SDDS_ULONG;
+  case epics::pvData::pvShort:
+    return SDDS_SHORT;
+  case epics::pvData::pvUShort:
+    return SDDS_USHORT;
+  default:
+    return 0;
+  }
+}
+
+/*
+  Write elements [start, start+length) of a numeric scalarArray PV to a column or array.
+  When the PV is kept in its native type and that matches the storage type the data is
+  handed to SDDS as is, otherwise it goes through the double conversion.
+*/
+int32_t SetNumericArrayData(SDDS_TABLE *sdds, PVA_OVERALL *pva, LOGGER_DATA *logger, long j, int32_t start, int32_t length, bool asColumn) {
+  void *native;
+  double *values;
+  native = GetPVANativeValues(pva, j, 0, logger->monitor);
+  if (native && (NativeSDDSType(pva->pvaData[j].scalarType) == logger->storageType[j])) {
+    native = (char *)native + (size_t)start * SDDS_GetTypeSize(logger->storageType[j]);
+    if (asColumn) {
+      return SDDS_SetColumn(sdds, SDDS_SET_BY_INDEX, native, length, logger->elementIndex[j]);
+    }
+    return SDDS_SetArrayVararg(sdds, (char *)logger->readbackName[j], SDDS_CONTIGUOUS_DATA, native, length);
+  }
+  values = GetPVADoubleValues(pva, j, 0, logger->monitor);
+  if (asColumn) {
+    return SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, values + start, length, logger->elementIndex[j]);
+  }
+  return SetNumericArrayValues(sdds, (char *)logger->readbackName[j], logger->storageType[j], values + start, length);
+}
+
+/*
+  Write every queued monitor reading of a numeric scalar PV as its own row using the
+  server time stamp. Used by -onePvPerFile when -monitorMode=queueSize is given.
+  Returns the number of rows written or -1 for error.
+*/
+long WriteQueuedReadings(SDDS_TABLE *sdds, PVA_OVERALL *pva, LOGGER_DATA *logger, long n, long j) {
+  long k, count;
+  int64_t rowsFree;
+  double value;
+
+  count = DrainPVAMonitorQueue(pva, j, logger->queuedValues, logger->queuedTimes, logger->monitorQueueSize);
+  if (count == 0) {
+    return (0);
+  }
+  rowsFree = sdds->n_rows_allocated - (logger->outputRow[n] - sdds->first_row_in_mem);
+  if (rowsFree < count) {
+    if (!SDDS_LengthenTable(sdds, count - rowsFree)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (-1);
+    }
+  }
+  for (k = 0; k < count; k++) {
+    value = logger->queuedValues[k];
+    if (logger->scaleFactor) {
+      value *= logger->scaleFactor[j];
+    }
+    if (!SDDS_SetRowValues(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, logger->outputRow[n] + k,
+                           logger->caErrorsIndex, 0,
+                           logger->timeIndex, logger->queuedTimes[k], -1) ||
+        !SetNumericRowValue(sdds, logger->outputRow[n] + k, logger->elementIndex[j], logger->storageType[j], value)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (-1);
+    }
+  }
+  if (pva->pvaData[j].monitorQueueOverflows > 0) {
+    fprintf(stderr, "Warning: %ld monitor updates of %s were lost. Consider increasing queueSize.\n",
+            pva->pvaData[j].monitorQueueOverflows, pva->pvaChannelNames[j].c_str());
+    pva->pvaData[j].monitorQueueOverflows = 0;
+  }
+  return (count);
+}
+
+/*
+  Value of a scalar PV, or of the selected element of a scalarArray treated as a scalar,
+  as WriteData would write it. With averaged the -logInterval average is given for PVs
+  that are averaged. Gives 0 and "" if there is no reading.
+*/
+static void GetScalarReading(PVA_OVERALL *pva, LOGGER_DATA *logger, long j, double *value, const char **string, bool averaged) {
+  *value = 0;
+  *string = "";
+  if (!(pva->isConnected[j]) || !(logger->verifiedType[j]) || (logger->monitor && (pva->pvaData[j].numMonitorReadings <= 0))) {
+    return;
+  }
+  if (averaged && logger->expectNumeric[j] && (logger->logInterval > 1) && (logger->average) && ((logger->average[j] == 'y') || (logger->average[j] == 'Y'))) {
+    *value = logger->averagedValues[j];
+    return;
+  }
+  // For treatScalarArrayAsScalar, determine the element index to use
+  int32_t elemIdx = 0;
+  if (logger->treatScalarArrayAsScalar[j] && (logger->scalarArrayStartIndex != NULL)) {
+    elemIdx = logger->scalarArrayStartIndex[j] - 1;
+  }
+  long elementsAvail = logger->monitor ? pva->pvaData[j].numMonitorElements : pva->pvaData[j].numGetElements;
+  if ((elementsAvail > 0) && (elemIdx >= 0) && (elemIdx < elementsAvail)) {
+    PVA_DATA *data = logger->monitor ? pva->pvaData[j].monitorData : pva->pvaData[j].getData;
+    if (data && logger->expectNumeric[j] && data[0].values) {
+      *value = data[0].values[elemIdx];
+    } else if (data && !logger->expectNumeric[j] && data[0].stringValues && data[0].stringValues[elemIdx]) {
+      *string = data[0].stringValues[elemIdx];
+    }
+  }
+  if (logger->scaleFactor) {
+    *value *= logger->scaleFactor[j];
+  }
+}
+
+/*
+  With a Deadband (or Tolerance) column in the input file a PV only needs to be logged when
+  its value moved more than the deadband from the value last logged, its string value or
+  connection state changed, or -keepAlive seconds passed since it was last logged.
+  scalarArray PVs and PVs with queued monitor readings are always logged.
+  With a single output file the whole row is written if any PV needs it, and false is
+  returned when the sample can be skipped. With -onePvPerFile logPV marks the PVs to write.
+*/
+bool PassesDeadbands(PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  long j;
+  bool connected, any = false;
+  double value;
+  const char *string;
+
+  if (logger->deadband == NULL) {
+    return (true);
+  }
+  if (logger->loggedValue == NULL) {
+    logger->logPV = (bool *)malloc(sizeof(bool) * pva->numPVs);
+    logger->loggedConnected = (bool *)calloc(pva->numPVs, sizeof(bool));
+    logger->loggedValue = (double *)calloc(pva->numPVs, sizeof(double));
+    logger->loggedString = (char **)calloc(pva->numPVs, sizeof(char *));
+    logger->loggedTime = (long double *)malloc(sizeof(long double) * pva->numPVs);
+    for (j = 0; j < pva->numPVs; j++) {
+      logger->loggedTime[j] = -1;
+    }
+  }
+  for (j = 0; j < pva->numPVs; j++) {
+    if (!(logger->expectScalar[j] || logger->treatScalarArrayAsScalar[j]) ||
+        ((logger->monitorQueueSize > 0) && logger->expectScalar[j] && logger->expectNumeric[j]) ||
+        (logger->deadband[j] < 0) || (logger->loggedTime[j] < 0)) {
+      logger->logPV[j] = true;
+    } else {
+      connected = (pva->isConnected[j]) && (logger->verifiedType[j]) && ((logger->monitor == false) || (pva->pvaData[j].numMonitorReadings > 0));
+      GetScalarReading(pva, logger, j, &value, &string, true);
+      if (connected != logger->loggedConnected[j]) {
+        logger->logPV[j] = true;
+      } else if (logger->expectNumeric[j]) {
+        logger->logPV[j] = (fabs(value - logger->loggedValue[j]) > logger->deadband[j]) || (isnan(value) != isnan(logger->loggedValue[j]));
+      } else {
+        logger->logPV[j] = (strcmp(string, logger->loggedString[j] ? logger->loggedString[j] : "") != 0);
+      }
+      if (!logger->logPV[j] && (logger->keepAlive > 0) && (logger->currentTime - logger->loggedTime[j] >= logger->keepAlive)) {
+        logger->logPV[j] = true;
+      }
+    }
+    any = any || logger->logPV[j];
+  }
+  if (logger->onePv_OutputDirectory == NULL) {
+    if (!any) {
+      return (false);
+    }
+    for (j = 0; j < pva->numPVs; j++) {
+      logger->logPV[j] = true;
+    }
+  }
+  for (j = 0; j < pva->numPVs; j++) {
+    if (logger->logPV[j]) {
+      GetScalarReading(pva, logger, j, &value, &string, true);
+      logger->loggedConnected[j] = (pva->isConnected[j]) && (logger->verifiedType[j]) && ((logger->monitor == false) || (pva->pvaData[j].numMonitorReadings > 0));
+      logger->loggedValue[j] = value;
+      if (!logger->expectNumeric[j]) {
+        SDDS_CopyString(&(logger->loggedString[j]), string);
+      }
+      logger->loggedTime[j] = logger->currentTime;
+    }
+  }
+  return (true);
+}
+
+/*
+  With -onePvPerFile=<dirName>,segment the readings of all PVs are appended to a single
+  segment file in the output directory instead of one file per PV, so no files are opened
+  or closed while logging. Each row holds one reading. PVIndex refers to the ReadbackName,
+  Units and StorageType arrays written with the page. sddspvalogsplit writes the per PV
+  files from a segment file.
+*/
+long WriteSegmentHeader(SDDS_TABLE *sdds, PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  long j, len;
+  char **units, **storageType;
+  int sddstype;
+  int32_t result;
+
+  if (logger->mallocNeeded) {
+    for (j = 0; j < pva->numPVs; j++) {
+      if (logger->expectScalarArray[j] && !logger->treatScalarArrayAsScalar[j]) {
+        fprintf(stderr, "error: %s is a scalarArray PV, -onePvPerFile=<dirName>,segment only supports scalar PVs\n", logger->readbackName[j]);
+        return (1);
+      }
+    }
+    logger->elementIndex = (int32_t *)malloc(sizeof(int32_t) * pva->numPVs);
+    logger->outputRow = (int64_t *)malloc(sizeof(int64_t));
+    logger->outputPage = (int64_t *)malloc(sizeof(int64_t));
+    len = strlen(logger->onePv_OutputDirectory) + 10;
+    logger->outputfileOrig = (char *)malloc(sizeof(char) * len);
+    snprintf(logger->outputfileOrig, len, "%s/segment", logger->onePv_OutputDirectory);
+  }
+  logger->outputRow[0] = 0;
+  logger->outputPage[0] = 0;
+  logger->scalarsAsColumns = true;
+  logger->scalarArraysAsColumns = false;
+  MakeOutputFilename(logger);
+  makeTimeBreakdown(getTimeInSecs(), NULL, &(logger->DayNow), &(logger->HourNow), NULL, NULL, NULL, NULL);
+  logger->mallocNeeded = false;
+
+  if ((logger->overwrite == false) && fexists(logger->outputfile)) {
+    fprintf(stderr, "error: File %s already exists. Make sure you use -generations, -dailyFiles or -monthlyFiles when using the -onePvPerFile option.\n", logger->outputfile);
+    return (1);
+  }
+  if (!SDDS_InitializeOutput(sdds, SDDS_BINARY, 1, NULL, NULL, logger->outputfile)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  SDDS_EnableFSync(sdds);
+  if (!SDDS_SetRowCountMode(sdds, SDDS_FIXEDROWCOUNT)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  logger->segmentPVIndex = SDDS_DefineColumn(sdds, "PVIndex", NULL, NULL, "Index of the PV in the ReadbackName array", NULL, SDDS_LONG, 0);
+  logger->caErrorsIndex = SDDS_DefineColumn(sdds, "CAerrors", NULL, NULL, "Channel access errors for this row", NULL, SDDS_LONG, 0);
+  logger->timeIndex = SDDS_DefineColumn(sdds, "Time", NULL, "s", "Time since start of epoch", NULL, SDDS_DOUBLE, 0);
+  logger->segmentValueIndex = SDDS_DefineColumn(sdds, "Value", NULL, NULL, "Value of numeric PVs", NULL, SDDS_DOUBLE, 0);
+  logger->segmentStringIndex = SDDS_DefineColumn(sdds, "StringValue", NULL, NULL, "Value of string PVs", NULL, SDDS_STRING, 0);
+  if ((logger->segmentPVIndex < 0) || (logger->caErrorsIndex < 0) || (logger->timeIndex < 0) ||
+      (logger->segmentValueIndex < 0) || (logger->segmentStringIndex < 0) ||
+      (SDDS_DefineArray(sdds, "ReadbackName", NULL, NULL, NULL, NULL, SDDS_STRING, 0, 1, NULL) < 0) ||
+      (SDDS_DefineArray(sdds, "Units", NULL, NULL, NULL, NULL, SDDS_STRING, 0, 1, NULL) < 0) ||
+      (SDDS_DefineArray(sdds, "StorageType", NULL, NULL, NULL, NULL, SDDS_STRING, 0, 1, NULL) < 0)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  if (!SDDS_SaveLayout(sdds) || !SDDS_WriteLayout(sdds) ||
+      !SDDS_StartPage(sdds, pva->numPVs * logger->flushInterval)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+
+  units = (char **)malloc(sizeof(char *) * pva->numPVs);
+  storageType = (char **)malloc(sizeof(char *) * pva->numPVs);
+  for (j = 0; j < pva->numPVs; j++) {
+    sddstype = logger->expectNumeric[j] ? SDDS_DOUBLE : SDDS_STRING;
+    if (logger->storageType && (logger->storageType[j] != 0)) {
+      sddstype = logger->storageType[j];
+    }
+    storageType[j] = SDDS_GetTypeName(sddstype);
+    if (logger->units && (strlen(logger->units[j]) > 0)) {
+      units[j] = logger->units[j];
+    } else {
+      units[j] = pva->pvaData[j].units;
+    }
+    if (units[j] == NULL) {
+      units[j] = (char *)"";
+    }
+  }
+  result = (SDDS_SetArrayVararg(sdds, (char *)"ReadbackName", SDDS_CONTIGUOUS_DATA, logger->readbackName, (int32_t)pva->numPVs) &&
+            SDDS_SetArrayVararg(sdds, (char *)"Units", SDDS_CONTIGUOUS_DATA, units, (int32_t)pva->numPVs) &&
+            SDDS_SetArrayVararg(sdds, (char *)"StorageType", SDDS_CONTIGUOUS_DATA, storageType, (int32_t)pva->numPVs));
+  for (j = 0; j < pva->numPVs; j++) {
+    free(storageType[j]);
+  }
+  free(units);
+  free(storageType);
+  if (result == 0) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  return (0);
+}
+
+static long ReserveSegmentRows(SDDS_TABLE *sdds, LOGGER_DATA *logger, int64_t rows) {
+  int64_t rowsFree;
+  rowsFree = sdds->n_rows_allocated - (logger->outputRow[0] - sdds->first_row_in_mem);
+  if ((rowsFree < rows) && !SDDS_LengthenTable(sdds, rows - rowsFree + logger->flushInterval)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  return (0);
+}
+
+/*
+  Append one row per PV, or one row per queued reading with -monitorMode=queueSize,
+  to the segment file.
+*/
+long WriteSegmentData(SDDS_TABLE *sdds, PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  long j, k, count;
+  double value;
+  const char *string;
+
+  for (j = 0; j < pva->numPVs; j++) {
+    if (logger->logPV && !logger->logPV[j]) {
+      continue;
+    }
+    if ((logger->monitorQueueSize > 0) && logger->expectScalar[j] && logger->expectNumeric[j] &&
+        (pva->isConnected[j]) && (logger->verifiedType[j])) {
+      count = DrainPVAMonitorQueue(pva, j, logger->queuedValues, logger->queuedTimes, logger->monitorQueueSize);
+      if (ReserveSegmentRows(sdds, logger, count)) {
+        return (1);
+      }
+      for (k = 0; k < count; k++) {
+        value = logger->queuedValues[k];
+        if (logger->scaleFactor) {
+          value *= logger->scaleFactor[j];
+        }
+        if (!SDDS_SetRowValues(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, logger->outputRow[0],
+                               logger->segmentPVIndex, (int32_t)j,
+                               logger->caErrorsIndex, (int32_t)0,
+                               logger->timeIndex, logger->queuedTimes[k],
+                               logger->segmentValueIndex, value,
+                               logger->segmentStringIndex, "", -1)) {
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+          return (1);
+        }
+        logger->outputRow[0]++;
+      }
+      if (pva->pvaData[j].monitorQueueOverflows > 0) {
+        fprintf(stderr, "Warning: %ld monitor updates of %s were lost. Consider increasing queueSize.\n",
+                pva->pvaData[j].monitorQueueOverflows, pva->pvaChannelNames[j].c_str());
+        pva->pvaData[j].monitorQueueOverflows = 0;
+      }
+      continue;
+    }
+
+    GetScalarReading(pva, logger, j, &value, &string, false);
+    if (ReserveSegmentRows(sdds, logger, 1)) {
+      return (1);
+    }
+    if (!SDDS_SetRowValues(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, logger->outputRow[0],
+                           logger->segmentPVIndex, (int32_t)j,
+                           logger->caErrorsIndex, (int32_t)(pva->isConnected[j] ? 0 : 1),
+                           logger->timeIndex, (double)(logger->currentTime),
+                           logger->segmentValueIndex, value,
+                           logger->segmentStringIndex, string, -1)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+    logger->outputRow[0]++;
+  }
+  return (0);
+}
+
+/*
+  With -rollup=<seconds>[,<seconds>...] every interval gets its own file, <outputFile>.<seconds>s,
+  holding one row per interval with the minimum, maximum, mean and last value of each numeric
+  scalar PV. The rows are accumulated from the samples taken for the main output file, so the
+  rollups cost no extra PV traffic. Intervals are aligned to multiples of their length in epoch
+  time; the interval in progress is written when the files are closed.
+*/
+long OpenRollupFiles(PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  long i, j, k, statIndex;
+  char *units, name[1024], descrip[1024];
+  SDDS_TABLE *sdds;
+  static const char *statSuffix[4] = {"Min", "Max", "Mean", "Last"};
+
+  if (logger->rollups == 0) {
+    return (0);
+  }
+  if (logger->rollupTable == NULL) {
+    logger->rollupTable = (SDDS_TABLE *)malloc(sizeof(SDDS_TABLE) * logger->rollups);
+    logger->rollupFile = (char **)calloc(logger->rollups, sizeof(char *));
+    logger->rollupStart = (long double *)malloc(sizeof(long double) * logger->rollups);
+    logger->rollupSamples = (int32_t *)calloc(logger->rollups, sizeof(int32_t));
+    logger->rollupErrors = (int32_t *)calloc(logger->rollups, sizeof(int32_t));
+    logger->rollupRow = (int64_t *)calloc(logger->rollups, sizeof(int64_t));
+  }
+  if (logger->rollupColumn == NULL) {
+    logger->rollupColumn = (int32_t *)malloc(sizeof(int32_t) * logger->rollups * pva->numPVs);
+    logger->rollupCount = (int32_t *)calloc(logger->rollups * pva->numPVs, sizeof(int32_t));
+    logger->rollupMin = (double *)calloc(logger->rollups * pva->numPVs, sizeof(double));
+    logger->rollupMax = (double *)calloc(logger->rollups * pva->numPVs, sizeof(double));
+    logger->rollupSum = (double *)calloc(logger->rollups * pva->numPVs, sizeof(double));
+    logger->rollupLast = (double *)calloc(logger->rollups * pva->numPVs, sizeof(double));
+  }
+  for (i = 0; i < logger->rollups; i++) {
+    sdds = &(logger->rollupTable[i]);
+    snprintf(name, sizeof(name), "%s.%gs", logger->outputfile, logger->rollupInterval[i]);
+    SDDS_CopyString(&(logger->rollupFile[i]), name);
+    logger->rollupStart[i] = -1;
+
+    if (logger->append && fexists(logger->rollupFile[i])) {
+      if (!SDDS_CheckFile(logger->rollupFile[i]) && !SDDS_RecoverFile(logger->rollupFile[i], RECOVERFILE_VERBOSE)) {
+        fprintf(stderr, "error: Unable to append to corrupted file %s\n", logger->rollupFile[i]);
+        return (1);
+      }
+      if (!SDDS_InitializeAppendToPage(sdds, logger->rollupFile[i], 100, &(logger->rollupRow[i]))) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        return (1);
+      }
+    } else {
+      if (fexists(logger->rollupFile[i]) && !logger->overwrite) {
+        fprintf(stderr, "error: File %s already exists.\n", logger->rollupFile[i]);
+        return (1);
+      }
+      if (!SDDS_InitializeOutput(sdds, SDDS_BINARY, 1, NULL, NULL, logger->rollupFile[i]) ||
+          !SDDS_SetRowCountMode(sdds, SDDS_FIXEDROWCOUNT)) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        return (1);
+      }
+      snprintf(descrip, sizeof(descrip), "%g s rollup of %s", logger->rollupInterval[i], logger->outputfile);
+      if ((SDDS_DefineParameter(sdds, "RollupInterval", NULL, "s", descrip, NULL, SDDS_DOUBLE, NULL) < 0) ||
+          (SDDS_DefineColumn(sdds, "Time", NULL, "s", "Start of the interval since start of epoch", NULL, SDDS_DOUBLE, 0) < 0) ||
+          (SDDS_DefineColumn(sdds, "Samples", NULL, NULL, "Samples taken in the interval", NULL, SDDS_LONG, 0) < 0) ||
+          (SDDS_DefineColumn(sdds, "CAerrors", NULL, NULL, "Channel access errors in the interval", NULL, SDDS_LONG, 0) < 0)) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        return (1);
+      }
+      for (j = 0; j < pva->numPVs; j++) {
+        if (!logger->expectNumeric[j] || !(logger->expectScalar[j] || logger->treatScalarArrayAsScalar[j])) {
+          continue;
+        }
+        units = pva->pvaData[j].units;
+        if (logger->units && strlen(logger->units[j])) {
+          units = logger->units[j];
+        }
+        for (k = 0; k < 4; k++) {
+          snprintf(name, sizeof(name), "%s%s", logger->readbackName[j], statSuffix[k]);
+          if (SDDS_DefineColumn(sdds, name, NULL, units, NULL, NULL, SDDS_DOUBLE, 0) < 0) {
+            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+            return (1);
+          }
+        }
+      }
+      if (!SDDS_SaveLayout(sdds) || !SDDS_WriteLayout(sdds) || !SDDS_StartPage(sdds, 100) ||
+          !SDDS_SetParameters(sdds, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE, "RollupInterval", logger->rollupInterval[i], NULL)) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        return (1);
+      }
+      logger->rollupRow[i] = 0;
+    }
+    SDDS_EnableFSync(sdds);
+
+    //Look the columns up by name so that appended files are checked too
+    for (j = 0; j < pva->numPVs; j++) {
+      logger->rollupColumn[i * pva->numPVs + j] = -1;
+      if (!logger->expectNumeric[j] || !(logger->expectScalar[j] || logger->treatScalarArrayAsScalar[j])) {
+        continue;
+      }
+      for (k = 0; k < 4; k++) {
+        snprintf(name, sizeof(name), "%s%s", logger->readbackName[j], statSuffix[k]);
+        statIndex = SDDS_GetColumnIndex(sdds, name);
+        if ((statIndex < 0) || ((k > 0) && (statIndex != logger->rollupColumn[i * pva->numPVs + j] + k))) {
+          fprintf(stderr, "error: %s does not have the expected %s column\n", logger->rollupFile[i], name);
+          return (1);
+        }
+        if (k == 0) {
+          logger->rollupColumn[i * pva->numPVs + j] = statIndex;
+        }
+      }
+    }
+  }
+  return (0);
+}
+
+static long WriteRollupRow(PVA_OVERALL *pva, LOGGER_DATA *logger, long i) {
+  long j, k;
+  int64_t rowsFree;
+  double min, max, mean, last;
+  SDDS_TABLE *sdds = &(logger->rollupTable[i]);
+
+  if (logger->rollupSamples[i] == 0) {
+    return (0);
+  }
+  rowsFree = sdds->n_rows_allocated - (logger->rollupRow[i] - sdds->first_row_in_mem);
+  if ((rowsFree < 1) && !SDDS_LengthenTable(sdds, 100)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  if (!SDDS_SetRowValues(sdds, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE, logger->rollupRow[i],
+                         "Time", (double)(logger->rollupStart[i]),
+                         "Samples", logger->rollupSamples[i],
+                         "CAerrors", logger->rollupErrors[i], NULL)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  for (j = 0; j < pva->numPVs; j++) {
+    k = i * pva->numPVs + j;
+    if (logger->rollupColumn[k] < 0) {
+      continue;
+    }
+    if (logger->rollupCount[k]) {
+      min = logger->rollupMin[k];
+      max = logger->rollupMax[k];
+      mean = logger->rollupSum[k] / logger->rollupCount[k];
+      last = logger->rollupLast[k];
+    } else {
+      //The PV was not read during the interval
+      min = max = mean = last = NAN;
+    }
+    if (!SDDS_SetRowValues(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, logger->rollupRow[i],
+                           logger->rollupColumn[k], min,
+                           logger->rollupColumn[k] + 1, max,
+                           logger->rollupColumn[k] + 2, mean,
+                           logger->rollupColumn[k] + 3, last, -1)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+  }
+  logger->rollupRow[i]++;
+  if (!SDDS_UpdatePage(sdds, FLUSH_TABLE)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  return (0);
+}
+
+/*
+  Add the current sample to every rollup, writing the previous interval first if the
+  sample starts a new one.
+*/
+long UpdateRollups(PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  long i, j, k;
+  long double start;
+  double value;
+  const char *string;
+
+  for (i = 0; i < logger->rollups; i++) {
+    start = floorl(logger->currentTime / logger->rollupInterval[i]) * logger->rollupInterval[i];
+    if (start > logger->rollupStart[i]) {
+      if (WriteRollupRow(pva, logger, i)) {
+        return (1);
+      }
+      logger->rollupStart[i] = start;
+      logger->rollupSamples[i] = logger->rollupErrors[i] = 0;
+      for (j = 0; j < pva->numPVs; j++) {
+        k = i * pva->numPVs + j;
+        logger->rollupCount[k] = 0;
+        logger->rollupSum[k] = logger->rollupMin[k] = logger->rollupMax[k] = logger->rollupLast[k] = 0;
+      }
+    }
+    logger->rollupSamples[i]++;
+    for (j = 0; j < pva->numPVs; j++) {
+      k = i * pva->numPVs + j;
+      if (logger->rollupColumn[k] < 0) {
+        continue;
+      }
+      if (!(pva->isConnected[j]) || (logger->monitor && (pva->pvaData[j].numMonitorReadings <= 0))) {
+        logger->rollupErrors[i]++;
+        continue;
+      }
+      GetScalarReading(pva, logger, j, &value, &string, false);
+      if ((logger->rollupCount[k] == 0) || (value < logger->rollupMin[k])) {
+        logger->rollupMin[k] = value;
+      }
+      if ((logger->rollupCount[k] == 0) || (value > logger->rollupMax[k])) {
+        logger->rollupMax[k] = value;
+      }
+      logger->rollupSum[k] += value;
+      logger->rollupLast[k] = value;
+      logger->rollupCount[k]++;
+    }
+  }
+  return (0);
+}
+
+long CloseRollupFiles(PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  long i, result = 0;
+
+  for (i = 0; i < logger->rollups; i++) {
+    if (WriteRollupRow(pva, logger, i)) {
+      result = 1;
+    }
+    logger->rollupSamples[i] = 0;
+    if (!SDDS_Terminate(&(logger->rollupTable[i]))) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      result = 1;
+    }
+  }
+  return (result);
+}
+
 long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
   int32_t result;
-  long j, n;
+  long j, n, rows;
   double value;
   long filecount, pvStart, pvEnd;
   SDDS_TABLE *sdds;
 
+  if (logger->onePv_segment) {
+    return (WriteSegmentData(&(SDDS_table[0]), pva, logger));
+  }
   if (WriteAccessoryData(SDDS_table, pva, logger)) {
     return (1);
   }
@@ -1872,6 +3012,9 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
     filecount = 1;
   }
   for (n = 0; n < filecount; n++) {
+    if ((logger->onePv_OutputDirectory != NULL) && logger->logPV && !logger->logPV[n]) {
+      continue;
+    }
     if (logger->onePv_OutputDirectory != NULL) {
       pvStart = n;
       pvEnd = n + 1;
@@ -1881,6 +3024,7 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
     }
 
     sdds = &(SDDS_table[n]);
+    rows = 1;
     for (j = pvStart; j < pvEnd; j++) {
       if (logger->onePv_OutputDirectory != NULL) {
         if (logger->expectScalar[n] || logger->treatScalarArrayAsScalar[n]) {
@@ -1890,6 +3034,15 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
           logger->scalarsAsColumns = false;
           logger->scalarArraysAsColumns = true;
         }
+        if ((logger->monitorQueueSize > 0) && logger->expectScalar[j] && logger->expectNumeric[j] &&
+            (pva->isConnected[j]) && (logger->verifiedType[j])) {
+          //Write all readings received since the last step instead of just the latest one
+          rows = WriteQueuedReadings(sdds, pva, logger, n, j);
+          if (rows == -1) {
+            return (1);
+          }
+          continue;
+        }
       }
 
       if ((pva->isConnected[j]) && (logger->verifiedType[j]) && ((logger->monitor == false) || (pva->pvaData[j].numMonitorReadings > 0))) {
@@ -1922,7 +3075,11 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
                   value *= logger->scaleFactor[j];
                 }
               }
-              result = SetNumericRowValue(sdds, logger->outputRow[n], logger->elementIndex[j], logger->storageType[j], value);
+              if (RowBatchActive(logger)) {
+                result = BatchRowValue(sdds, logger, j, value, NULL);
+              } else {
+                result = SetNumericRowValue(sdds, logger->outputRow[n], logger->elementIndex[j], logger->storageType[j], value);
+              }
             } else {
               const char *src = "";
               if (elemInRange) {
@@ -1936,8 +3093,12 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
                   }
                 }
               }
-              result = SetStringRowValue(sdds, logger->outputRow[n], logger->elementIndex[j], logger->storageType[j], 
+              if (RowBatchActive(logger)) {
+                result = BatchRowValue(sdds, logger, j, 0, src);
+              } else {
+                result = SetStringRowValue(sdds, logger->outputRow[n], logger->elementIndex[j], logger->storageType[j],
                                            (char *)src);
+              }
             }
           } else {
             if (logger->expectNumeric[j]) {
@@ -1984,10 +3145,7 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
               int32_t ee;
               ee = logger->scalarArrayEndIndex[j] - logger->scalarArrayStartIndex[j] + 1;
               if (logger->expectNumeric[j]) {
-                double *p;
-                p = logger->monitor ? pva->pvaData[j].monitorData[0].values + (logger->scalarArrayStartIndex[j] - 1) : pva->pvaData[j].getData[0].values + (logger->scalarArrayStartIndex[j] - 1);
-                result = SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, p,
-                                                   ee, logger->elementIndex[j]);
+                result = SetNumericArrayData(sdds, pva, logger, j, logger->scalarArrayStartIndex[j] - 1, ee, true);
               } else {
                 char **p;
                 p = logger->monitor ? pva->pvaData[j].monitorData[0].stringValues + (logger->scalarArrayStartIndex[j] - 1) : pva->pvaData[j].getData[0].stringValues + (logger->scalarArrayStartIndex[j] - 1);
@@ -1996,8 +3154,7 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
               }
             } else {
               if (logger->expectNumeric[j]) {
-                result = SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, logger->monitor ? pva->pvaData[j].monitorData[0].values : pva->pvaData[j].getData[0].values,
-                                        logger->expectElements[j], logger->elementIndex[j]);
+                result = SetNumericArrayData(sdds, pva, logger, j, 0, logger->expectElements[j], true);
               } else {
                 result = SDDS_SetColumn(sdds, SDDS_SET_BY_INDEX, logger->monitor ? pva->pvaData[j].monitorData[0].stringValues : pva->pvaData[j].getData[0].stringValues,
                                         logger->expectElements[j], logger->elementIndex[j]);
@@ -2008,9 +3165,7 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
               int32_t ee;
               ee = logger->scalarArrayEndIndex[j] - logger->scalarArrayStartIndex[j] + 1;
               if (logger->expectNumeric[j]) {
-                double *p;
-                p = logger->monitor ? pva->pvaData[j].monitorData[0].values + (logger->scalarArrayStartIndex[j] - 1) : pva->pvaData[j].getData[0].values + (logger->scalarArrayStartIndex[j] - 1);
-                result = SetNumericArrayValues(sdds, (char *)logger->readbackName[j], logger->storageType[j], p, ee);
+                result = SetNumericArrayData(sdds, pva, logger, j, logger->scalarArrayStartIndex[j] - 1, ee, false);
               } else {
                 char **p;
                 p = logger->monitor ? pva->pvaData[j].monitorData[0].stringValues + (logger->scalarArrayStartIndex[j] - 1) : pva->pvaData[j].getData[0].stringValues + (logger->scalarArrayStartIndex[j] - 1);
@@ -2018,9 +3173,8 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
               }
             } else {
               if (logger->expectNumeric[j]) {
-                result = SetNumericArrayValues(sdds, (char *)logger->readbackName[j], logger->storageType[j],
-                                               logger->monitor ? pva->pvaData[j].monitorData[0].values : pva->pvaData[j].getData[0].values,
-                                               (int32_t)(logger->monitor ? pva->pvaData[j].numMonitorElements : pva->pvaData[j].numGetElements));
+                result = SetNumericArrayData(sdds, pva, logger, j, 0,
+                                             (int32_t)(logger->monitor ? pva->pvaData[j].numMonitorElements : pva->pvaData[j].numGetElements), false);
               } else {
                 result = SDDS_SetArrayVararg(sdds, (char *)logger->readbackName[j], SDDS_CONTIGUOUS_DATA,
                                              logger->monitor ? pva->pvaData[j].monitorData[0].stringValues : pva->pvaData[j].getData[0].stringValues,
@@ -2036,7 +3190,9 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
       } else {
         if (logger->expectScalar[j] || logger->treatScalarArrayAsScalar[j]) {
           if (logger->scalarsAsColumns) {
-            if (logger->expectNumeric[j]) {
+            if (RowBatchActive(logger)) {
+              result = BatchRowValue(sdds, logger, j, 0, "");
+            } else if (logger->expectNumeric[j]) {
               result = SetNumericRowValue(sdds, logger->outputRow[n], logger->elementIndex[j], logger->storageType[j], (double)0);
             } else {
               result = SetStringRowValue(sdds, logger->outputRow[n], logger->elementIndex[j], logger->storageType[j], (char *)"");
@@ -2081,7 +3237,7 @@ long WriteData(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
       }
     }
     if (logger->scalarsAsColumns) {
-      logger->outputRow[n]++;
+      logger->outputRow[n] += rows;
     }
   }
   if ((logger->logInterval > 1) && (logger->average != NULL)) {
@@ -2180,100 +3336,124 @@ int nanosleep(const struct timespec *req, struct timespec *rem) {
 }
 #endif
 
-long pvaThreadSleep(long double seconds) {
+/*
+  Sleep until wakeTime (seconds since 1970 as returned by getLongDoubleTimeInSecs). The
+  deadline is converted once to an absolute CLOCK_MONOTONIC time, so a signal or a late
+  wake-up does not add to the next sleep. macOS has no clock_nanosleep and recomputes the
+  time left from wakeTime after each interrupted sleep instead. Returns 1 on SIGINT.
+*/
+static long SleepUntil(long double wakeTime) {
+  long double seconds;
+
+  seconds = wakeTime - getLongDoubleTimeInSecs();
+  if (sigint) {
+    return (1);
+  }
+  if (seconds <= 0) {
+    return (0);
+  }
+#if defined(_WIN32)
+  struct timespec delayTime;
+  delayTime.tv_sec = seconds;
+  delayTime.tv_nsec = (seconds - delayTime.tv_sec) * 1e9L;
+  nanosleep(&delayTime, NULL);
+#elif defined(__APPLE__)
+  //No clock_nanosleep, so sleep for the time that is left and recompute it after a signal
   struct timespec delayTime;
-  struct timespec remainingTime;
+  while (seconds > 0) {
+    delayTime.tv_sec = (time_t)seconds;
+    delayTime.tv_nsec = (long)((seconds - delayTime.tv_sec) * 1e9L);
+    if (nanosleep(&delayTime, NULL) == 0) {
+      break;
+    }
+    if ((errno != EINTR) || sigint) {
+      break;
+    }
+    seconds = wakeTime - getLongDoubleTimeInSecs();
+  }
+#else
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += (time_t)seconds;
+  deadline.tv_nsec += (long)((seconds - (time_t)seconds) * 1e9L);
+  if (deadline.tv_nsec >= 1000000000L) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000L;
+  }
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    if (sigint) {
+      return (1);
+    }
+  }
+#endif
+  return (sigint ? 1 : 0);
+}
+
+/*
+  Run control is pinged on its own 5 second schedule. Each wait sleeps until the earlier
+  of its own deadline and the next ping instead of waking in fixed slices.
+*/
+static long double nextPingTime = 0;
+
+static long double NextWakeTime(long double deadline) {
+  if (nextPingTime <= 0) {
+    nextPingTime = getLongDoubleTimeInSecs() + 5;
+  }
+  return ((deadline < nextPingTime) ? deadline : nextPingTime);
+}
+
+static long PingRunControlIfDue() {
+  long double now = getLongDoubleTimeInSecs();
+
+  if (now < nextPingTime) {
+    return (0);
+  }
+  nextPingTime += 5;
+  if (nextPingTime <= now) {
+    nextPingTime = now + 5;
+  }
+  return (PingRunControl());
+}
+
+long pvaThreadSleep(long double seconds) {
   long double targetTime;
 
   if (sigint) {
     return (1);
   }
-
   if (seconds > 0) {
     targetTime = getLongDoubleTimeInSecs() + seconds;
-    while (seconds > 5) {
-      if (sigint) {
+    while (getLongDoubleTimeInSecs() < targetTime) {
+      if (SleepUntil(NextWakeTime(targetTime)) == 1) {
         return (1);
       }
-      delayTime.tv_sec = 5;
-      delayTime.tv_nsec = 0;
-      while ((nanosleep(&delayTime, &remainingTime) == -1) && (errno == EINTR)) {
-        delayTime = remainingTime;
-        if (sigint) {
-          return (1);
-        }
-      }
-      if (PingRunControl() != 0) //Ping the run control once every 5 seconds
-      {
+      if (PingRunControlIfDue() != 0) {
         return (1);
       }
-      seconds = targetTime - getLongDoubleTimeInSecs();
     }
-
-    delayTime.tv_sec = seconds;
-    delayTime.tv_nsec = (seconds - delayTime.tv_sec) * 1e9;
-    while (nanosleep(&delayTime, &remainingTime) == -1 &&
-           errno == EINTR)
-      {
-        delayTime = remainingTime;
-        if (sigint) {
-          return (1);
-        }
-      }
   }
   return (0);
 }
 
 long pvaThreadSleepWithPolling(PVA_OVERALL **pva, long count, long double targetTime) {
-  struct timespec delayTime;
-  struct timespec remainingTime;
-  long double seconds, interval = .001L, pauseTargetTime;
-  long rcInterval, j = 0;
-
-  rcInterval = 5 / interval;   //Calculate how many intervals will equal 5 seconds
-  delayTime.tv_sec = interval; //Converted into whole seconds
-  delayTime.tv_nsec = (interval - delayTime.tv_sec) * 1e9L;
+  long double seconds;
 
-  pauseTargetTime = targetTime - .6 - (.00025 * pva[0]->numPVs);
-  seconds = pauseTargetTime - getLongDoubleTimeInSecs();
+  seconds = targetTime - getLongDoubleTimeInSecs();
   if (seconds > 0) {
-    PausePVAMonitoring(pva, count); //Pause monitoring because background events cause the CPU usage to be high if there are thousands of PVs.
     while (seconds > 0) {
       if (sigint) {
         return (1);
       }
-      while ((nanosleep(&delayTime, &remainingTime) == -1) && (errno == EINTR)) {
-        delayTime = remainingTime;
-        if (sigint) {
-          return (1);
-        }
-      }
-      if (j % rcInterval == 0) {
-        if (PingRunControl() != 0) //Ping the run control once every 5 seconds
-        {
-          return (1);
-        }
+      //Block until a monitored PV changes, the target time is reached or run control is due,
+      //waking at least once a second to check sigint
+      seconds = NextWakeTime(targetTime) - getLongDoubleTimeInSecs();
+      if (seconds > 1) {
+        seconds = 1;
       }
-      j++;
-      seconds = pauseTargetTime - getLongDoubleTimeInSecs();
-    }
-    ResumePVAMonitoring(pva, count);
-  }
-
-  seconds = targetTime - getLongDoubleTimeInSecs();
-  if (seconds > 0) {
-    while (seconds > 0) {
-      if (sigint) {
+      if (WaitAnyMonitoredPVA(pva, count, (double)seconds) == -1) {
         return (1);
       }
-      while ((nanosleep(&delayTime, &remainingTime) == -1) && (errno == EINTR)) {
-        delayTime = remainingTime;
-        if (sigint) {
-          return (1);
-        }
-      }
-      if (PollMonitoredPVA(pva, count) == -1) //Poll monitored PVs and extract values for those that changed
-      {
+      if (PingRunControlIfDue() != 0) {
         return (1);
       }
       seconds = targetTime - getLongDoubleTimeInSecs();
@@ -2290,100 +3470,19 @@ long pvaThreadSleepWithPolling(PVA_OVERALL **pva, long count, long double target
 }
 
 long pvaThreadSleepWithPollingAndDataStrobe(PVA_OVERALL **pva, long count, PVA_OVERALL *pvaST, bool randomTime, double hold_off) {
-  struct timespec delayTime;
-  struct timespec remainingTime;
-  struct timespec holdoff;
-  long j = 1, numUpdated, rcInterval;
+  long numUpdated;
   double initStrobeValue = 0;
-  long double interval;
   static long double lastTriggerTime = 0, thisTriggerTime = 0, triggerInterval = -1;
   static int step = 0;
-  long double targetTime, seconds;
-  bool predictiveWaitRan = false;
-
-  interval = .001L;
-  rcInterval = 5 / interval;
-  delayTime.tv_sec = interval; //Converted into whole seconds
-  delayTime.tv_nsec = (interval - delayTime.tv_sec) * 1e9L;
-
-  holdoff.tv_sec = hold_off; //Converted into whole seconds
-  holdoff.tv_nsec = (hold_off - holdoff.tv_sec) * 1e9L;
 
   if (pvaST->isConnected[0] && (pvaST->pvaData[0].numMonitorReadings > 0)) {
     initStrobeValue = pvaST->pvaData[0].monitorData[0].values[0];
   }
 
-  //Doesn’t run until triggerInterval has been learned (after two triggers)
-  //Sit in a waiting loop till .5 seconds before we expect the trigger
-  if ((randomTime == false) && (triggerInterval > 0)) {
-    predictiveWaitRan = true;
-    PausePVAMonitoring(pva, count);                                                  //Pause monitoring because background events cause the CPU usage to be high if there are thousands of PVs.
-    targetTime = lastTriggerTime + triggerInterval - .6 - (.00025 * pva[0]->numPVs); //the .00025sec per PV extra time is due to the extra time needed to resume PVA monitoring
-    seconds = targetTime - getLongDoubleTimeInSecs();
-    if (seconds <= 0) {
-      fprintf(stderr, "Logger cannot keep up. Too many PVs and too short an interval. Consider removing the -monitor option.\n");
-    }
-    while (seconds > 0) {
-      if (sigint) {
-        return (1);
-      }
-      while ((nanosleep(&delayTime, &remainingTime) == -1) && (errno == EINTR)) {
-        delayTime = remainingTime;
-        if (sigint) {
-          return (1);
-        }
-      }
-      if (j % rcInterval == 0) {
-        if (PingRunControl() != 0) //Ping the run control once every 5 seconds
-        {
-          return (1);
-        }
-      }
-      j++;
-      seconds = targetTime - getLongDoubleTimeInSecs();
-    }
-    ResumePVAMonitoring(pva, count);
-    if (pvaThreadSleep(.1) == 1) {
-      return (1);
-    }
-  }
-
-  /*
-   * Check to see if we missed the trigger.
-   * This check is only meaningful if we did a predictive wait based on a known trigger interval.
-   */
-  if (predictiveWaitRan) {
-    numUpdated = PollMonitoredPVA(pvaST);
-    if (numUpdated == -1) {
-      return (1);
-    }
-    if ((numUpdated == 1) && (pvaST->isConnected[0])) {
-      if (initStrobeValue != pvaST->pvaData[0].monitorData[0].values[0]) {
-        lastTriggerTime = 0;
-        thisTriggerTime = 0;
-        triggerInterval = -1;
-        step = 0;
-        numUpdated = PollMonitoredPVA(pva, count);
-        fprintf(stderr, "Logger missed the strobe PV updating. It may be overloaded or an issue with the file system\n");
-        if (numUpdated == -1) //Poll monitored PVs and extract values for those that changed
-        {
-          return (1);
-        }
-        return (0);
-      }
-    }
-  }
-
   while (1) {
     if (sigint) {
       return (1);
     }
-    while ((nanosleep(&delayTime, &remainingTime) == -1) && (errno == EINTR)) {
-      delayTime = remainingTime;
-      if (sigint) {
-        return (1);
-      }
-    }
 
     if (triggerInterval > 0) {
       numUpdated = PollMonitoredPVA(pva, count);
@@ -2392,14 +3491,18 @@ long pvaThreadSleepWithPollingAndDataStrobe(PVA_OVERALL **pva, long count, PVA_O
         return (1);
       }
     }
-    numUpdated = PollMonitoredPVA(pvaST); //Poll monitored strobe PVs and extract value if changed
+    //Block until the strobe PV changes, waking at least once a second to check sigint and ping run control
+    numUpdated = WaitAnyMonitoredPVA(pvaST, 1.0); //Extract strobe value if changed
     if (numUpdated == -1) {
       return (1);
     }
     if ((numUpdated == 1) && (pvaST->isConnected[0])) {
       if (initStrobeValue != pvaST->pvaData[0].monitorData[0].values[0]) {
-        if (hold_off > 1e-7) 
-          nanosleep(&holdoff, NULL);
+        if (hold_off > 1e-7) {
+          if (SleepUntil(getLongDoubleTimeInSecs() + hold_off) == 1) {
+            return (1);
+          }
+        }
 
         if (randomTime == true) {
           numUpdated = PollMonitoredPVA(pva, count);
@@ -2426,13 +3529,9 @@ long pvaThreadSleepWithPollingAndDataStrobe(PVA_OVERALL **pva, long count, PVA_O
       }
     }
 
-    if (j % rcInterval == 0) {
-      if (PingRunControl() != 0) //Ping the run control once every 5 seconds
-      {
-        return (1);
-      }
+    if (PingRunControlIfDue() != 0) {
+      return (1);
     }
-    j++;
   }
   //It will never get here
   return (1);
@@ -2725,6 +3824,38 @@ long VerifyFileIsAppendable(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DAT
 }
 
 long ReadInputFiles(LOGGER_DATA *logger) {
+  //Read the PV list
+  if (ReadPVListFile(logger) == 1) {
+    return (1);
+  }
+
+  //Read conditions file
+  if (logger->CondFile) {
+    if (ReadConditionsFile(logger) == 1) {
+      return (1);
+    }
+  }
+
+  //Read trigger file
+  if (logger->trigFileSet) {
+    if (ReadGlitchTriggerFile(logger) == 1) {
+      return (1);
+    }
+  }
+
+  //Check if input file contents make sense
+  if (CheckInputFileValidity(logger) != 0) {
+    return (1);
+  }
+
+  return (0);
+}
+
+/*
+  Read the PV list and the per-PV columns of the input file. -watchInput reads an edited
+  file with this into a separate LOGGER_DATA, see ReloadInputFile.
+*/
+long ReadPVListFile(LOGGER_DATA *logger) {
   SDDS_TABLE SDDS_table;
   int64_t n;
   char *UnitsColumnName = NULL;
@@ -2900,6 +4031,21 @@ long ReadInputFiles(LOGGER_DATA *logger) {
     logger->scaleFactor = SDDS_GetColumnInDoubles(&SDDS_table, (char *)"ScaleFactor");
   }
 
+  if (SDDS_CHECK_OKAY == SDDS_CheckColumn(&SDDS_table, (char *)"MonitorQueueSize", NULL, SDDS_ANY_INTEGER_TYPE, NULL)) {
+    logger->monitorRequestQueueSize = SDDS_GetColumnInLong(&SDDS_table, (char *)"MonitorQueueSize");
+  }
+  if (SDDS_CHECK_OKAY == SDDS_CheckColumn(&SDDS_table, (char *)"MonitorDeadband", NULL, SDDS_ANY_NUMERIC_TYPE, NULL)) {
+    logger->monitorDeadband = SDDS_GetColumnInDoubles(&SDDS_table, (char *)"MonitorDeadband");
+  }
+  if (SDDS_CHECK_OKAY == SDDS_CheckColumn(&SDDS_table, (char *)"MonitorDecimation", NULL, SDDS_ANY_INTEGER_TYPE, NULL)) {
+    logger->monitorDecimation = SDDS_GetColumnInLong(&SDDS_table, (char *)"MonitorDecimation");
+  }
+  if (SDDS_CHECK_OKAY == SDDS_CheckColumn(&SDDS_table, (char *)"Deadband", NULL, SDDS_ANY_NUMERIC_TYPE, NULL)) {
+    logger->deadband = SDDS_GetColumnInDoubles(&SDDS_table, (char *)"Deadband");
+  } else if (SDDS_CHECK_OKAY == SDDS_CheckColumn(&SDDS_table, (char *)"Tolerance", NULL, SDDS_ANY_NUMERIC_TYPE, NULL)) {
+    logger->deadband = SDDS_GetColumnInDoubles(&SDDS_table, (char *)"Tolerance");
+  }
+
   if (SDDS_CHECK_OKAY == SDDS_CheckColumn(&SDDS_table, (char *)"ScalarArrayStartIndex", NULL, SDDS_ANY_INTEGER_TYPE, NULL)) {
     ScalarArrayStartIndexExists = true;
     logger->scalarArrayStartIndex = SDDS_GetColumnInLong(&SDDS_table, (char *)"ScalarArrayStartIndex");
@@ -2948,42 +4094,20 @@ long ReadInputFiles(LOGGER_DATA *logger) {
   }
 
   if (SDDS_CHECK_OKAY == SDDS_CheckColumn(&SDDS_table, (char *)"Average", NULL, SDDS_CHARACTER, NULL)) {
-    logger->average = (char *)SDDS_GetColumn(&SDDS_table, (char *)"Average");
-  }
-
-  UnitsColumnName = SDDS_FindColumn(&SDDS_table, FIND_SPECIFIED_TYPE, SDDS_STRING,
-                                    "ReadbackUnits", "ReadbackUnit", "Units", NULL);
-  if (UnitsColumnName) {
-    logger->units = (char **)SDDS_GetColumn(&SDDS_table, UnitsColumnName);
-    free(UnitsColumnName);
-  }
-
-  //Not sure if I need to setup DeadBand column code. I may add this in the future.
-
-  if (!SDDS_Terminate(&SDDS_table)) {
-    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-    return (1);
-  }
-
-  //Read conditions file
-  if (logger->CondFile) {
-    if (ReadConditionsFile(logger) == 1) {
-      return (1);
-    }
+    logger->average = (char *)SDDS_GetColumn(&SDDS_table, (char *)"Average");
   }
 
-  //Read trigger file
-  if (logger->trigFileSet) {
-    if (ReadGlitchTriggerFile(logger) == 1) {
-      return (1);
-    }
+  UnitsColumnName = SDDS_FindColumn(&SDDS_table, FIND_SPECIFIED_TYPE, SDDS_STRING,
+                                    "ReadbackUnits", "ReadbackUnit", "Units", NULL);
+  if (UnitsColumnName) {
+    logger->units = (char **)SDDS_GetColumn(&SDDS_table, UnitsColumnName);
+    free(UnitsColumnName);
   }
 
-  //Check if input file contents make sense
-  if (CheckInputFileValidity(logger) != 0) {
+  if (!SDDS_Terminate(&SDDS_table)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
     return (1);
   }
-
   return (0);
 }
 
@@ -3464,12 +4588,42 @@ long StartPages(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
 }
 
 long UpdateAndWritePages(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  if (writer == NULL) {
+    logger->resumeTime = logger->currentTime;
+    return (FlushPages(SDDS_table, pva, logger, logger->step));
+  }
+  //Hand the flush to the write-behind thread
+  if (WaitForWriter() == 1) {
+    return (1);
+  }
+  logger->resumeTime = logger->currentTime;
+  {
+    epics::pvData::Lock guard(writer->mutex);
+    writer->step = logger->step;
+    writer->busy = true;
+  }
+  writer->work.signal();
+  return (0);
+}
+
+/*
+  Write the pages filled in for the given step. Called on the write-behind thread when
+  -writeBehind is used, otherwise on the sampling loop.
+*/
+long FlushPages(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger, int64_t step) {
   long j, n;
   long nStart, nEnd;
 
-  if (logger->onePv_OutputDirectory != NULL) {
+  if (logger->onePv_segment) {
+    if ((logger->flushInterval <= 1) || (step % logger->flushInterval == 0)) {
+      if (!SDDS_UpdatePage(&(SDDS_table[0]), FLUSH_TABLE)) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        return (1);
+      }
+    }
+  } else if (logger->onePv_OutputDirectory != NULL) {
     if (logger->flushInterval > 0) {
-      n = logger->step % logger->flushInterval;
+      n = step % logger->flushInterval;
     } else {
       n = 0;
     }
@@ -3517,23 +4671,246 @@ long UpdateAndWritePages(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *
       }
     }
   } else if ((logger->scalarsAsColumns) && (logger->flushInterval > 0) && (logger->outputRow[0] % logger->flushInterval == 0)) {
+    if (FlushRowBatch(&(SDDS_table[0]), logger) == 1) {
+      return (1);
+    }
     if (!SDDS_UpdatePage(&(SDDS_table[0]), FLUSH_TABLE)) {
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
       return (1);
     }
+    WriteResumeIndex(logger);
   } else if (logger->scalarsAsColumns == false) {
     if (!SDDS_WriteTable(&(SDDS_table[0]))) {
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
       return (1);
     }
     logger->outputPage[0]++;
+    WriteResumeIndex(logger);
+  }
+  return (0);
+}
+
+static void WriterThread(LOGGER_WRITER *w) {
+  int64_t step;
+  bool busy, stop;
+  long result;
+
+  while (1) {
+    w->work.wait();
+    {
+      epics::pvData::Lock guard(w->mutex);
+      busy = w->busy;
+      stop = w->stop;
+      step = w->step;
+    }
+    if (busy) {
+      result = FlushPages(w->SDDS_table, w->pva, w->logger, step);
+      {
+        epics::pvData::Lock guard(w->mutex);
+        if (result != 0) {
+          w->failed = true;
+        }
+        w->busy = false;
+      }
+      w->idle.signal();
+    }
+    if (stop) {
+      return;
+    }
+  }
+}
+
+void StartWriter(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  writer = new LOGGER_WRITER;
+  writer->busy = writer->stop = writer->failed = false;
+  writer->step = 0;
+  writer->backpressure = 0;
+  writer->SDDS_table = SDDS_table;
+  writer->pva = pva;
+  writer->logger = logger;
+  writer->thread = std::thread(WriterThread, writer);
+}
+
+/*
+  Wait until the write-behind thread is no longer using the SDDS tables.
+  Returns 1 if one of its flushes failed.
+*/
+long WaitForWriter() {
+  bool counted = false;
+
+  if (writer == NULL) {
+    return (0);
+  }
+  while (1) {
+    {
+      epics::pvData::Lock guard(writer->mutex);
+      if (!writer->busy) {
+        return (writer->failed ? 1 : 0);
+      }
+      if (!counted) {
+        writer->backpressure++;
+        counted = true;
+      }
+    }
+    writer->idle.wait();
+  }
+}
+
+long StopWriter() {
+  long result;
+
+  if (writer == NULL) {
+    return (0);
+  }
+  result = WaitForWriter();
+  {
+    epics::pvData::Lock guard(writer->mutex);
+    writer->stop = true;
   }
+  writer->work.signal();
+  writer->thread.join();
+  writer->logger->writerBackpressure = writer->backpressure;
+  delete writer;
+  writer = NULL;
+  return (result);
+}
+
+long OpenTimingStats() {
+  long i;
+
+  timing.row = 0;
+  timing.historyCount = timing.historyNext = 0;
+  if (timing.filename == NULL) {
+    return (0);
+  }
+  if (!SDDS_InitializeOutput(&(timing.table), SDDS_BINARY, 1, NULL, NULL, timing.filename) ||
+      (SDDS_DefineColumn(&(timing.table), "Step", NULL, NULL, NULL, NULL, SDDS_LONG64, 0) < 0) ||
+      (SDDS_DefineColumn(&(timing.table), "ScheduledTime", NULL, "s", "Scheduled sample time, 0 with a data strobe", NULL, SDDS_DOUBLE, 0) < 0) ||
+      (SDDS_DefineColumn(&(timing.table), "SampleTime", NULL, "s", "Time the sample was taken", NULL, SDDS_DOUBLE, 0) < 0)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  for (i = 0; i < LOGGER_TIMING_FIELDS; i++) {
+    if (SDDS_DefineColumn(&(timing.table), timingName[i], NULL, "s", NULL, NULL, SDDS_DOUBLE, 0) < 0) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+  }
+  if ((SDDS_DefineColumn(&(timing.table), "NotConnected", NULL, NULL, "Number of logged PVs not connected", NULL, SDDS_LONG, 0) < 0) ||
+      !SDDS_WriteLayout(&(timing.table)) ||
+      !SDDS_StartPage(&(timing.table), LOGGER_TIMING_FLUSH_ROWS)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  return (0);
+}
+
+/*
+  Finish the timing of the current step from the time stamps taken in the main loop, add it
+  to the history and write it to the stats file.
+*/
+long RecordTiming(PVA_OVERALL **pvaArray, long count, LOGGER_DATA *logger) {
+  long i;
+  double extract = 0;
+
+  for (i = 0; i < count; i++) {
+    if (pvaArray[i] != NULL) {
+      extract += pvaArray[i]->extractTime;
+    }
+  }
+  //In monitor mode the values are extracted while waiting, otherwise during the get
+  timing.value[LOGGER_TIMING_LATENESS] = (timing.scheduled > 0) ? timing.sample - timing.scheduled : 0;
+  timing.value[LOGGER_TIMING_WAIT] = timing.sample - timing.start - (logger->monitor ? extract : 0);
+  timing.value[LOGGER_TIMING_GET] = timing.acquired - timing.sample - (logger->monitor ? 0 : extract);
+  timing.value[LOGGER_TIMING_EXTRACT] = extract;
+  timing.value[LOGGER_TIMING_CYCLE] = getLongDoubleTimeInSecs() - timing.start;
+  for (i = 0; i < LOGGER_TIMING_FIELDS; i++) {
+    timing.history[i][timing.historyNext] = timing.value[i];
+  }
+  timing.historyNext = (timing.historyNext + 1) % LOGGER_TIMING_HISTORY;
+  if (timing.historyCount < LOGGER_TIMING_HISTORY) {
+    timing.historyCount++;
+  }
+
+  if (timing.filename == NULL) {
+    return (0);
+  }
+  if (!SDDS_SetRowValues(&(timing.table), SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE, timing.row,
+                         "Step", (int64_t)logger->step,
+                         "ScheduledTime", (double)timing.scheduled,
+                         "SampleTime", (double)timing.sample,
+                         "NotConnected", (int32_t)pvaArray[0]->numNotConnected, NULL)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  for (i = 0; i < LOGGER_TIMING_FIELDS; i++) {
+    if (!SDDS_SetRowValues(&(timing.table), SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE, timing.row,
+                           timingName[i], timing.value[i], NULL)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+  }
+  timing.row++;
+  if (timing.row == LOGGER_TIMING_FLUSH_ROWS) {
+    if (!SDDS_UpdatePage(&(timing.table), FLUSH_TABLE)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+    timing.row = 0;
+  }
+  return (0);
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return ((x < y) ? -1 : ((x > y) ? 1 : 0));
+}
+
+void PrintTimingSummary(FILE *fp) {
+  long i, n = timing.historyCount;
+  double sorted[LOGGER_TIMING_HISTORY];
+
+  if (n == 0) {
+    return;
+  }
+  fprintf(fp, "Step timing over the last %ld steps (ms):\n", n);
+  for (i = 0; i < LOGGER_TIMING_FIELDS; i++) {
+    memcpy(sorted, timing.history[i], sizeof(double) * n);
+    qsort(sorted, n, sizeof(double), CompareDoubles);
+    fprintf(fp, "  %-14s p50=%9.3f p99=%9.3f max=%9.3f\n", timingName[i],
+            sorted[(n - 1) / 2] * 1e3, sorted[(n - 1) * 99 / 100] * 1e3, sorted[n - 1] * 1e3);
+  }
+  fflush(fp);
+}
+
+long CloseTimingStats() {
+  if (timing.filename == NULL) {
+    return (0);
+  }
+  if (!SDDS_UpdatePage(&(timing.table), FLUSH_TABLE) || !SDDS_Terminate(&(timing.table))) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  timing.filename = NULL;
   return (0);
 }
 
 long CloseFiles(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
   long j, result = 0;
-  if (logger->onePv_OutputDirectory != NULL) {
+
+  if (WaitForWriter() == 1) {
+    result = 1;
+  }
+  if (logger->onePv_segment) {
+    if (!SDDS_UpdatePage(&(SDDS_table[0]), FLUSH_TABLE)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      result = 1;
+    }
+    if (!SDDS_Terminate(&(SDDS_table[0]))) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      result = 1;
+    }
+  } else if (logger->onePv_OutputDirectory != NULL) {
     for (j = 0; j < pva->numPVs; j++) {
       if (logger->expectScalar[j] || logger->treatScalarArrayAsScalar[j]) {
         if (logger->doDisconnect && !SDDS_ReconnectFile(&(SDDS_table[j]))) {
@@ -3557,9 +4934,19 @@ long CloseFiles(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
       }
     }
   } else {
+    if (FlushRowBatch(&(SDDS_table[0]), logger) == 1) {
+      result = 1;
+    }
+    FreeRowBatch(logger);
     if (!SDDS_Terminate(&(SDDS_table[0]))) {
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
       result = 1;
+    } else {
+      WriteResumeIndex(logger);
+    }
+    CloseResumeIndex(logger);
+    if (CloseRollupFiles(pva, logger) == 1) {
+      result = 1;
     }
   }
   return (result);
@@ -3678,8 +5065,13 @@ void InitializeVariables(LOGGER_DATA *logger) {
   logger->emptyStringColumn = NULL;
   logger->n_rows = -1;
   logger->watchInput = false;
+  logger->reloadFirstNew = 0;
+  logger->reloadConnectDeadline = 0;
   logger->monitor = false;
   logger->monitorRandomTimedTrigger = false;
+  logger->monitorQueueSize = 0;
+  logger->queuedValues = NULL;
+  logger->queuedTimes = NULL;
   logger->append = false;
   logger->overwrite = false;
   logger->outputRow = NULL;
@@ -3708,6 +5100,28 @@ void InitializeVariables(LOGGER_DATA *logger) {
   logger->inhibit_provider = NULL;
   logger->inhibit_waittime = 5.0;
   logger->scaleFactor = NULL;
+  logger->monitorRequestQueueSize = NULL;
+  logger->monitorDeadband = NULL;
+  logger->deadband = NULL;
+  logger->keepAlive = 60;
+  logger->logPV = logger->loggedConnected = NULL;
+  logger->loggedValue = NULL;
+  logger->loggedString = NULL;
+  logger->loggedTime = NULL;
+  logger->rollups = 0;
+  logger->rollupInterval = NULL;
+  logger->rollupTable = NULL;
+  logger->rollupFile = NULL;
+  logger->rollupStart = NULL;
+  logger->rollupSamples = logger->rollupErrors = logger->rollupCount = logger->rollupColumn = NULL;
+  logger->rollupRow = NULL;
+  logger->rollupMin = logger->rollupMax = logger->rollupSum = logger->rollupLast = NULL;
+  logger->resumeIndex = false;
+  logger->resumeFile = NULL;
+  logger->resumeFp = NULL;
+  logger->layoutHash = 0;
+  logger->resumeTime = 0;
+  logger->monitorDecimation = NULL;
   logger->scalarArrayStartIndex = NULL;
   logger->scalarArrayEndIndex = NULL;
   logger->treatScalarArrayAsScalar = NULL;
@@ -3726,6 +5140,7 @@ void InitializeVariables(LOGGER_DATA *logger) {
   logger->monthlyFilesVerbose = false;
   logger->verbose = false;
   logger->onePv_OutputDirectory = NULL;
+  logger->onePv_segment = false;
   logger->onePv_outputfile = NULL;
   logger->onePv_outputfileOrig = NULL;
   logger->mallocNeeded = true;
@@ -3736,6 +5151,10 @@ void InitializeVariables(LOGGER_DATA *logger) {
   logger->totalTimeSet = false;
   logger->TotalTime = 0;
   logger->pendIOtime = 10.0;
+  logger->connectThreads = 1;
+  logger->extractThreads = 1;
+  logger->writeBehind = false;
+  logger->writerBackpressure = 0;
   logger->filesPerStep = 1;
   logger->NstepsAdjusted = 0;
   logger->triggerFile = NULL;
@@ -3749,6 +5168,9 @@ void InitializeVariables(LOGGER_DATA *logger) {
   logger->strictPVverification = false;
   logger->truncateWaveforms = false;
   logger->storageType = NULL;
+  logger->rowBatch = NULL;
+  logger->rowBatchType = NULL;
+  logger->rowBatchRows = logger->rowBatchCapacity = 0;
   logger->glitch_MajorAlarmDefined = false;
   logger->glitch_MinorAlarmDefined = false;
   logger->glitch_NoAlarmDefined = false;
@@ -3774,6 +5196,7 @@ void InitializeVariables(LOGGER_DATA *logger) {
   logger->circularbufferDouble = NULL;
   logger->circularbufferLongDouble = NULL;
   logger->circularbufferString = NULL;
+  logger->circularbufferOffset = NULL;
   logger->glitch_alarmLastValue = NULL;
   logger->glitch_transitionLastValue = NULL;
   logger->glitch_glitchBaselineSamplesRead = NULL;
@@ -3794,9 +5217,9 @@ void InitializeVariables(LOGGER_DATA *logger) {
 }
 
 long ReadCommandLineArgs(LOGGER_DATA *logger, int argc, SCANNED_ARG *s_arg) {
-  long i_arg, optionCode;
+  long i_arg, optionCode, i;
   long TimeUnits;
-  unsigned long dummyFlags, dailyFilesFlags, monthlyFilesFlags, strobeFlags;
+  unsigned long dummyFlags, dailyFilesFlags, monthlyFilesFlags, strobeFlags, monitorFlags, onePvFlags = 0;
 
   if (argc == 1) {
     fprintf(stderr, "%s\n", USAGE);
@@ -3885,19 +5308,68 @@ long ReadCommandLineArgs(LOGGER_DATA *logger, int argc, SCANNED_ARG *s_arg) {
           return (1);
         }
         break;
+      case CLO_CONNECTTHREADS:
+        if (s_arg[i_arg].n_items != 2 || sscanf(s_arg[i_arg].list[1], "%ld", &(logger->connectThreads)) != 1 ||
+            logger->connectThreads <= 0) {
+          fprintf(stderr, "invalid -connectThreads syntax\n");
+          return (1);
+        }
+        break;
+      case CLO_EXTRACTTHREADS:
+        if (s_arg[i_arg].n_items != 2 || sscanf(s_arg[i_arg].list[1], "%ld", &(logger->extractThreads)) != 1 ||
+            logger->extractThreads <= 0) {
+          fprintf(stderr, "invalid -extractThreads syntax\n");
+          return (1);
+        }
+        break;
+      case CLO_WRITEBEHIND:
+        logger->writeBehind = true;
+        break;
+      case CLO_STATSFILE:
+        if (s_arg[i_arg].n_items != 2) {
+          fprintf(stderr, "invalid -statsFile syntax\n");
+          return (1);
+        }
+        timing.filename = s_arg[i_arg].list[1];
+        break;
+      case CLO_ROLLUP:
+        if (s_arg[i_arg].n_items < 2) {
+          fprintf(stderr, "invalid -rollup syntax\n");
+          return (1);
+        }
+        logger->rollups = s_arg[i_arg].n_items - 1;
+        logger->rollupInterval = (double *)malloc(sizeof(double) * logger->rollups);
+        for (i = 0; i < logger->rollups; i++) {
+          if ((sscanf(s_arg[i_arg].list[i + 1], "%lf", &(logger->rollupInterval[i])) != 1) || (logger->rollupInterval[i] <= 0)) {
+            fprintf(stderr, "invalid -rollup syntax\n");
+            return (1);
+          }
+        }
+        break;
+      case CLO_KEEPALIVE:
+        if (s_arg[i_arg].n_items != 2 || sscanf(s_arg[i_arg].list[1], "%lf", &(logger->keepAlive)) != 1 ||
+            logger->keepAlive < 0) {
+          fprintf(stderr, "invalid -keepAlive syntax\n");
+          return (1);
+        }
+        break;
       case CLO_WATCHINPUT:
         logger->watchInput = true;
         break;
       case CLO_MONITOR:
         logger->monitor = true;
-        if (s_arg[i_arg].n_items == 2) {
-          if (strncmp((char*)"randomTimedTrigger", s_arg[i_arg].list[1], strlen(s_arg[i_arg].list[1])) == 0) {
-            logger->monitorRandomTimedTrigger = true;
-          } else {
-            fprintf(stderr, "Invalid -monitorMode syntax!\n");
-            return (1);
-          }
+        s_arg[i_arg].n_items -= 1;
+        if (!scanItemList(&monitorFlags, s_arg[i_arg].list + 1, &s_arg[i_arg].n_items, 0,
+                          "randomTimedTrigger", -1, NULL, 0, MONITOR_RANDOMTIMEDTRIGGER,
+                          "queueSize", SDDS_LONG, &(logger->monitorQueueSize), 1, 0,
+                          NULL) ||
+            (logger->monitorQueueSize < 0)) {
+          fprintf(stderr, "Invalid -monitorMode syntax!\n");
+          return (1);
         }
+        s_arg[i_arg].n_items += 1;
+        if (monitorFlags & MONITOR_RANDOMTIMEDTRIGGER)
+          logger->monitorRandomTimedTrigger = true;
         break;
       case CLO_TRUNCATEWAVEFORMS:
         logger->truncateWaveforms = true;
@@ -3907,6 +5379,7 @@ long ReadCommandLineArgs(LOGGER_DATA *logger, int argc, SCANNED_ARG *s_arg) {
         break;
       case CLO_APPEND:
         logger->append = true;
+        logger->resumeIndex = true;
         break;
       case CLO_OVERWRITE:
         logger->overwrite = true;
@@ -4055,7 +5528,7 @@ long ReadCommandLineArgs(LOGGER_DATA *logger, int argc, SCANNED_ARG *s_arg) {
         s_arg[i_arg].n_items += 1;
         break;
       case CLO_ONE_PV_PER_FILE:
-        if (s_arg[i_arg].n_items != 2) {
+        if ((s_arg[i_arg].n_items != 2) && (s_arg[i_arg].n_items != 3)) {
           fprintf(stderr, "Invalid -onePvPerFile syntax!\n");
           return (1);
         }
@@ -4064,6 +5537,18 @@ long ReadCommandLineArgs(LOGGER_DATA *logger, int argc, SCANNED_ARG *s_arg) {
         return (1);
 #endif
         logger->onePv_OutputDirectory = s_arg[i_arg].list[1];
+        if (s_arg[i_arg].n_items == 3) {
+          s_arg[i_arg].n_items -= 2;
+          if (!scanItemList(&onePvFlags, s_arg[i_arg].list + 2, &s_arg[i_arg].n_items, 0,
+                            "segment", -1, NULL, 0, ONEPV_SEGMENT,
+                            NULL)) {
+            fprintf(stderr, "Invalid -onePvPerFile syntax!\n");
+            return (1);
+          }
+          s_arg[i_arg].n_items += 2;
+          if (onePvFlags & ONEPV_SEGMENT)
+            logger->onePv_segment = true;
+        }
         break;
       case CLO_RUNCONTROLPV:
         if ((s_arg[i_arg].n_items -= 1) < 0 ||
@@ -4215,10 +5700,18 @@ long CheckCommandLineArgsValidity(LOGGER_DATA *logger) {
     fprintf(stderr, "-overwrite and -generations are incompatible options\n");
     return (1);
   }
+  if ((logger->rollups > 0) && (logger->onePv_OutputDirectory != NULL)) {
+    fprintf(stderr, "-rollup and -onePvPerFile are incompatible options\n");
+    return (1);
+  }
   if (logger->trigFileSet && (logger->onePv_OutputDirectory != NULL)) {
     fprintf(stderr, "-triggerFile and -onePvPerFile are incompatible options\n");
     return (1);
   }
+  if ((logger->monitorQueueSize > 0) && (logger->onePv_OutputDirectory == NULL)) {
+    fprintf(stderr, "-monitorMode=queueSize requires the -onePvPerFile option\n");
+    return (1);
+  }
 
   if ((logger->append || logger->generations) && (logger->dailyFiles || logger->monthlyFiles)) {
     logger->generationsDigits = 0;
@@ -4270,6 +5763,16 @@ long CheckInputFileValidity(LOGGER_DATA *logger) {
     fprintf(stderr, "Averaging with one pv per file output isn't supported\n");
     return (1);
   }
+  if (logger->onePv_segment) {
+    //The segment file keeps every reading in one double Value column, which cannot hold all 64 bit integers exactly
+    for (j = 0; j < logger->pvCount; j++) {
+      if ((logger->storageType[j] == SDDS_LONG64) || (logger->storageType[j] == SDDS_ULONG64)) {
+        fprintf(stderr, "StorageType %s for %s isn't supported with -onePvPerFile=<dirName>,segment\n",
+                logger->storageType[j] == SDDS_LONG64 ? "long64" : "ulong64", logger->controlName[j]);
+        return (1);
+      }
+    }
+  }
   if ((logger->logInterval > 1) && (logger->average != NULL)) {
     logger->averagedValues = (double *)malloc(sizeof(double) * logger->pvCount);
     for (j = 0; j < logger->pvCount; j++) {
@@ -4429,9 +5932,24 @@ long SetupPVs(PVA_OVERALL *pva, PVA_OVERALL *pvaConditions, PVA_OVERALL *pvaStro
     for (j = 0; j < pva->numPVs; j++) {
       names[j] = logger->controlName[j];
       providerNames[j] = logger->provider[j];
+      //Let the servers limit the monitor updates to what will be logged
+      if (logger->monitorRequestQueueSize) {
+        pva->pvaData[j].monitorRequestQueueSize = logger->monitorRequestQueueSize[j];
+      }
+      if (logger->monitorDeadband) {
+        pva->pvaData[j].monitorDeadband = logger->monitorDeadband[j];
+      }
+      if (logger->monitorDecimation) {
+        pva->pvaData[j].monitorDecimation = logger->monitorDecimation[j];
+      }
     }
     pva->pvaChannelNames = freeze(names);
     pva->pvaProvider = freeze(providerNames);
+    pva->connectThreads = logger->connectThreads;
+    pva->reportConnectProgress = logger->verbose;
+    //Start logging from the shards that are ready unless a missing PV has to stop the logger
+    pva->connectInBackground = (logger->onerrorindex != ONERROR_EXIT);
+    pva->extractThreads = logger->extractThreads;
     ConnectPVA(pva, logger->pendIOtime);
     if (logger->verbose) {
       if (pva->numNotConnected > 0) {
@@ -4439,6 +5957,10 @@ long SetupPVs(PVA_OVERALL *pva, PVA_OVERALL *pvaConditions, PVA_OVERALL *pvaStro
       } else {
         fprintf(stdout, "Connected to all %ld PVs\n", pva->numPVs);
       }
+      if (pva->connectStats.connected > 0) {
+        fprintf(stdout, "Connect time %.2f seconds, time to connect p50=%.2f p90=%.2f p99=%.2f max=%.2f\n",
+                pva->connectStats.elapsed, pva->connectStats.p50, pva->connectStats.p90, pva->connectStats.p99, pva->connectStats.max);
+      }
     }
     pva->limitGetReadings = true;
   }
@@ -4524,27 +6046,25 @@ long GenerationsCheck(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *log
   return (0);
 }
 
-void freeLogger(LOGGER_DATA *logger) {
+/*
+  Set the PV list pointers filled in by ReadPVListFile to NULL.
+*/
+static void ClearPVList(LOGGER_DATA *logger) {
+  logger->controlName = logger->readbackName = logger->provider = logger->units = NULL;
+  logger->expectNumeric = logger->expectScalar = logger->expectScalarArray = logger->treatScalarArrayAsScalar = NULL;
+  logger->storageType = NULL;
+  logger->expectElements = NULL;
+  logger->scaleFactor = logger->monitorDeadband = logger->deadband = NULL;
+  logger->monitorRequestQueueSize = logger->monitorDecimation = NULL;
+  logger->scalarArrayStartIndex = logger->scalarArrayEndIndex = NULL;
+  logger->average = NULL;
+}
+
+/*
+  Free the PV list read by ReadPVListFile.
+*/
+static void FreePVList(LOGGER_DATA *logger) {
   long j;
-  if (logger->onePv_outputfile) {
-    for (j = 0; j < logger->pvCount; j++)
-      free(logger->onePv_outputfile[j]);
-    free(logger->onePv_outputfile);
-  }
-  if (logger->onePv_outputfileOrig) {
-    for (j = 0; j < logger->pvCount; j++)
-      free(logger->onePv_outputfileOrig[j]);
-    free(logger->onePv_outputfileOrig);
-  }
-  if (logger->outputfile)
-    free(logger->outputfile);
-  if (logger->outputRow)
-    free(logger->outputRow);
-  if (logger->outputPage)
-    free(logger->outputPage);
-  if (logger->averagedValues) {
-    free(logger->averagedValues);
-  }
   if (logger->controlName != logger->readbackName) {
     if (logger->readbackName) {
       for (j = 0; j < logger->pvCount; j++)
@@ -4587,9 +6107,125 @@ void freeLogger(LOGGER_DATA *logger) {
   if (logger->scaleFactor) {
     free(logger->scaleFactor);
   }
+  if (logger->monitorRequestQueueSize) {
+    free(logger->monitorRequestQueueSize);
+  }
+  if (logger->monitorDeadband) {
+    free(logger->monitorDeadband);
+  }
+  if (logger->deadband) {
+    free(logger->deadband);
+  }
+  if (logger->treatScalarArrayAsScalar) {
+    free(logger->treatScalarArrayAsScalar);
+  }
+  if (logger->scalarArrayStartIndex) {
+    free(logger->scalarArrayStartIndex);
+  }
+  if (logger->scalarArrayEndIndex) {
+    free(logger->scalarArrayEndIndex);
+  }
+  if (logger->monitorDecimation) {
+    free(logger->monitorDecimation);
+  }
   if (logger->average) {
     free(logger->average);
   }
+  ClearPVList(logger);
+}
+
+/*
+  Free the log on change state of PassesDeadbands, it is allocated again on the next call.
+*/
+static void FreeDeadbandState(LOGGER_DATA *logger) {
+  long j;
+  if (logger->loggedString) {
+    for (j = 0; j < logger->pvCount; j++)
+      free(logger->loggedString[j]);
+    free(logger->loggedString);
+  }
+  free(logger->logPV);
+  free(logger->loggedConnected);
+  free(logger->loggedValue);
+  free(logger->loggedTime);
+  logger->logPV = logger->loggedConnected = NULL;
+  logger->loggedValue = NULL;
+  logger->loggedString = NULL;
+  logger->loggedTime = NULL;
+}
+
+/*
+  Empty column data of n_rows rows written for disconnected scalarArrays.
+*/
+void AllocateEmptyColumns(LOGGER_DATA *logger) {
+  long j;
+  logger->emptyColumn = (double *)malloc(sizeof(double) * logger->n_rows);
+  logger->emptyStringColumn = (char **)malloc(sizeof(char *) * logger->n_rows);
+  for (j = 0; j < logger->n_rows; j++) {
+    logger->emptyStringColumn[j] = (char *)malloc(sizeof(char));
+    logger->emptyStringColumn[j][0] = 0;
+    logger->emptyColumn[j] = 0;
+  }
+}
+
+void FreeEmptyColumns(LOGGER_DATA *logger) {
+  long j;
+  if (logger->emptyStringColumn) {
+    for (j = 0; j < logger->n_rows; j++) {
+      free(logger->emptyStringColumn[j]);
+    }
+    free(logger->emptyStringColumn);
+  }
+  if (logger->emptyColumn)
+    free(logger->emptyColumn);
+  logger->emptyColumn = NULL;
+  logger->emptyStringColumn = NULL;
+}
+
+void freeLogger(LOGGER_DATA *logger) {
+  long j;
+  if (logger->onePv_outputfile) {
+    for (j = 0; j < logger->pvCount; j++)
+      free(logger->onePv_outputfile[j]);
+    free(logger->onePv_outputfile);
+  }
+  if (logger->onePv_outputfileOrig) {
+    for (j = 0; j < logger->pvCount; j++)
+      free(logger->onePv_outputfileOrig[j]);
+    free(logger->onePv_outputfileOrig);
+  }
+  if (logger->outputfile)
+    free(logger->outputfile);
+  if (logger->outputRow)
+    free(logger->outputRow);
+  if (logger->outputPage)
+    free(logger->outputPage);
+  if (logger->averagedValues) {
+    free(logger->averagedValues);
+  }
+  if (logger->queuedValues) {
+    free(logger->queuedValues);
+    free(logger->queuedTimes);
+  }
+  FreePVList(logger);
+  FreeDeadbandState(logger);
+  if (logger->rollupFile) {
+    for (j = 0; j < logger->rollups; j++)
+      free(logger->rollupFile[j]);
+    free(logger->rollupFile);
+  }
+  free(logger->rollupInterval);
+  free(logger->rollupTable);
+  free(logger->rollupStart);
+  free(logger->rollupSamples);
+  free(logger->rollupErrors);
+  free(logger->rollupCount);
+  free(logger->rollupColumn);
+  free(logger->rollupRow);
+  free(logger->rollupMin);
+  free(logger->rollupMax);
+  free(logger->rollupSum);
+  free(logger->rollupLast);
   if (logger->conditions_controlName) {
     for (j = 0; j < logger->conditions_pvCount; j++)
       free(logger->conditions_controlName[j]);
@@ -4658,14 +6294,9 @@ void freeLogger(LOGGER_DATA *logger) {
     free(logger->inhibit_provider);
   }
 
-  if (logger->emptyStringColumn) {
-    for (j = 0; j < logger->n_rows; j++) {
-      free(logger->emptyStringColumn[j]);
-    }
-    free(logger->emptyStringColumn);
-  }
-  if (logger->emptyColumn)
-    free(logger->emptyColumn);
+  FreeEmptyColumns(logger);
+  if (logger->resumeFile)
+    free(logger->resumeFile);
   if (logger->elementIndex)
     free(logger->elementIndex);
   if (logger->verifiedType)
@@ -4709,18 +6340,29 @@ void freeLogger(LOGGER_DATA *logger) {
     free(logger->glitch_alarmSeverityTemp);
 }
 
-long WatchInput(LOGGER_DATA *logger) {
+/*
+  Returns 1 if the logger should exit, 2 after the PV list was reloaded, -1 on error and
+  0 otherwise. A change while -triggerFile is in use exits, since the glitch history is
+  laid out for the PV list read at startup.
+*/
+long WatchInput(SDDS_TABLE **SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
   if (logger->watchInput) {
     if (file_is_modified(logger->inputfile, &(logger->inputfileLastlink), &(logger->filestat))) {
+      if (logger->trigFileSet) {
+        if (logger->verbose) {
+          fprintf(stdout, "The input file has been modified, exiting\n");
+        }
+        return (1);
+      }
       if (logger->verbose) {
-        fprintf(stdout, "The input file has been modified, exiting\n");
+        fprintf(stdout, "The input file has been modified, reloading the PV list\n");
       }
-      return (1);
+      return (ReloadInputFile(SDDS_table, pva, logger));
     }
     if (logger->trigFileSet) {
       if (file_is_modified(logger->triggerFile, &(logger->triggerFileLastlink), &(logger->triggerfilestat))) {
         if (logger->verbose) {
-          fprintf(stdout, "The input file has been modified, exiting\n");
+          fprintf(stdout, "The trigger file has been modified, exiting\n");
         }
         return (1);
       }
@@ -4730,175 +6372,539 @@ long WatchInput(LOGGER_DATA *logger) {
   return (0);
 }
 
-long WriteGlitchPage(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
-  int64_t n, count, i, j, length, n_rows, stepOffset;
-  int32_t result;
-  SDDS_TABLE *sdds;
-  sdds = &(SDDS_table[0]);
+/*
+  Number of PVs that count as connection errors for -onerror. The PVs added by a reload
+  connect in the background and are given pendIOtime before they count.
+*/
+long NotConnectedPVs(PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  long j, num = pva->numNotConnected;
 
-  if (logger->glitch_step > logger->circularbuffer_before) {
-    length = logger->circularbuffer_before + 1 + logger->step - logger->glitch_step;
-    n = logger->circularbuffer_index;
-    for (i = 0; i < logger->circularbuffer_length - length; i++) {
-      n++;
-      if (n == logger->circularbuffer_length) {
-        n = 0;
+  if (getLongDoubleTimeInSecs() < logger->reloadConnectDeadline) {
+    for (j = logger->reloadFirstNew; j < pva->numPVs; j++) {
+      if (pva->isConnected[j] == false) {
+        num--;
       }
     }
-    stepOffset = logger->circularbuffer_before;
-  } else {
-    length = 1 + logger->step;
-    n = 0;
-    stepOffset = logger->glitch_step;
   }
+  return (num);
+}
 
-  if (logger->scalarsAsColumns) {
-    n_rows = length;
+/*
+  Key used to match the PVs of an edited input file with the ones being logged. PVs that
+  ask for different server side monitor filters need a new channel.
+*/
+static std::string PVListKey(LOGGER_DATA *logger, long j) {
+  char filters[100];
+  snprintf(filters, sizeof(filters), " %d %.17g %d",
+           logger->monitorRequestQueueSize ? (int)logger->monitorRequestQueueSize[j] : 0,
+           logger->monitorDeadband ? logger->monitorDeadband[j] : 0,
+           logger->monitorDecimation ? (int)logger->monitorDecimation[j] : 0);
+  return (std::string(logger->provider[j]) + " " + logger->controlName[j] + filters);
+}
+
+template <class T>
+static void PermutePVColumn(T **column, long *order, long count) {
+  long j;
+  T *permuted;
+  if (*column == NULL) {
+    return;
+  }
+  permuted = (T *)malloc(sizeof(T) * count);
+  for (j = 0; j < count; j++) {
+    permuted[j] = (*column)[order[j]];
+  }
+  free(*column);
+  *column = permuted;
+}
+
+/*
+  Move entry order[j] of the PV list to position j.
+*/
+static void PermutePVList(LOGGER_DATA *logger, long *order) {
+  bool sameNames = (logger->readbackName == logger->controlName);
+  PermutePVColumn(&(logger->controlName), order, logger->pvCount);
+  if (sameNames) {
+    logger->readbackName = logger->controlName;
   } else {
-    n_rows = logger->n_rows;
+    PermutePVColumn(&(logger->readbackName), order, logger->pvCount);
+  }
+  PermutePVColumn(&(logger->provider), order, logger->pvCount);
+  PermutePVColumn(&(logger->units), order, logger->pvCount);
+  PermutePVColumn(&(logger->expectNumeric), order, logger->pvCount);
+  PermutePVColumn(&(logger->expectScalar), order, logger->pvCount);
+  PermutePVColumn(&(logger->expectScalarArray), order, logger->pvCount);
+  PermutePVColumn(&(logger->treatScalarArrayAsScalar), order, logger->pvCount);
+  PermutePVColumn(&(logger->storageType), order, logger->pvCount);
+  PermutePVColumn(&(logger->expectElements), order, logger->pvCount);
+  PermutePVColumn(&(logger->scaleFactor), order, logger->pvCount);
+  PermutePVColumn(&(logger->monitorDeadband), order, logger->pvCount);
+  PermutePVColumn(&(logger->deadband), order, logger->pvCount);
+  PermutePVColumn(&(logger->monitorRequestQueueSize), order, logger->pvCount);
+  PermutePVColumn(&(logger->monitorDecimation), order, logger->pvCount);
+  PermutePVColumn(&(logger->scalarArrayStartIndex), order, logger->pvCount);
+  PermutePVColumn(&(logger->scalarArrayEndIndex), order, logger->pvCount);
+  PermutePVColumn(&(logger->average), order, logger->pvCount);
+}
+
+static void SwapPVList(LOGGER_DATA *a, LOGGER_DATA *b) {
+  std::swap(a->pvCount, b->pvCount);
+  std::swap(a->controlName, b->controlName);
+  std::swap(a->readbackName, b->readbackName);
+  std::swap(a->provider, b->provider);
+  std::swap(a->units, b->units);
+  std::swap(a->expectNumeric, b->expectNumeric);
+  std::swap(a->expectScalar, b->expectScalar);
+  std::swap(a->expectScalarArray, b->expectScalarArray);
+  std::swap(a->treatScalarArrayAsScalar, b->treatScalarArrayAsScalar);
+  std::swap(a->storageType, b->storageType);
+  std::swap(a->expectElements, b->expectElements);
+  std::swap(a->scaleFactor, b->scaleFactor);
+  std::swap(a->monitorDeadband, b->monitorDeadband);
+  std::swap(a->deadband, b->deadband);
+  std::swap(a->monitorRequestQueueSize, b->monitorRequestQueueSize);
+  std::swap(a->monitorDecimation, b->monitorDecimation);
+  std::swap(a->scalarArrayStartIndex, b->scalarArrayStartIndex);
+  std::swap(a->scalarArrayEndIndex, b->scalarArrayEndIndex);
+  std::swap(a->average, b->average);
+  std::swap(a->averagedValues, b->averagedValues);
+  std::swap(a->scalarsAsColumns, b->scalarsAsColumns);
+}
+
+/*
+  True if PV j of the new list expects the same data as PV i of the current one.
+*/
+static bool SamePVExpectations(LOGGER_DATA *logger, long i, LOGGER_DATA *next, long j) {
+  int32_t start = 0, end = 0, nextStart = 0, nextEnd = 0;
+  if (logger->scalarArrayStartIndex && logger->scalarArrayEndIndex) {
+    start = logger->scalarArrayStartIndex[i];
+    end = logger->scalarArrayEndIndex[i];
+  }
+  if (next->scalarArrayStartIndex && next->scalarArrayEndIndex) {
+    nextStart = next->scalarArrayStartIndex[j];
+    nextEnd = next->scalarArrayEndIndex[j];
+  }
+  return ((logger->expectNumeric[i] == next->expectNumeric[j]) &&
+          (logger->expectScalar[i] == next->expectScalar[j]) &&
+          (logger->expectScalarArray[i] == next->expectScalarArray[j]) &&
+          (logger->treatScalarArrayAsScalar[i] == next->treatScalarArrayAsScalar[j]) &&
+          (logger->expectElements[i] == next->expectElements[j]) &&
+          (logger->storageType[i] == next->storageType[j]) &&
+          (start == nextStart) && (end == nextEnd));
+}
+
+/*
+  Switch to the PV list of the modified input file without dropping the connections of the
+  PVs it still lists. Removed PVs and their channels are released. New PVs are placed after
+  the kept ones and connect in the background, so the sampling thread doesn't wait for them;
+  the next GetPVAValues or PollMonitoredPVA picks each one up as it connects. The output files are only closed and restarted if the logged columns
+  changed, which needs -generations, -dailyFiles or -monthlyFiles for a new file name.
+  Returns 0 if the file could not be read (the current list stays in use), 1 if the logger
+  should exit, 2 after a reload and -1 on error.
+*/
+long ReloadInputFile(SDDS_TABLE **SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  LOGGER_DATA next;
+  long i, j, kept = 0, added, *keep, *order;
+  bool identity, sameLayout, *verifiedType;
+  std::multimap<std::string, long> current;
+  std::multimap<std::string, long>::iterator it;
+
+  if (WaitForWriter() == 1) {
+    return (-1);
+  }
+
+  //Read the new list into a copy so the current one stays in use if the file is bad
+  next = *logger;
+  ClearPVList(&next);
+  next.averagedValues = NULL;
+  if ((ReadPVListFile(&next) != 0) || (CheckInputFileValidity(&next) != 0)) {
+    fprintf(stderr, "Warning (sddspvalogger): unable to reload %s, still logging the previous PV list\n", logger->inputfile);
+    FreePVList(&next);
+    free(next.averagedValues);
+    return (0);
   }
 
-  for (count = 0; count < length; count++) {
-    if ((logger->scalarsAsColumns == false) || (count == 0)) {
-      if (!SDDS_StartPage(sdds, n_rows)) {
+  //Kept PVs take the order of the new file and the new PVs follow them
+  for (i = 0; i < logger->pvCount; i++) {
+    current.insert(std::make_pair(PVListKey(logger, i), i));
+  }
+  keep = (long *)malloc(sizeof(long) * next.pvCount);
+  order = (long *)malloc(sizeof(long) * next.pvCount);
+  std::vector<bool> matched(next.pvCount, false);
+  for (j = 0; j < next.pvCount; j++) {
+    it = current.find(PVListKey(&next, j));
+    if (it != current.end()) {
+      keep[kept] = it->second;
+      order[kept++] = j;
+      matched[j] = true;
+      current.erase(it);
+    }
+  }
+  added = kept;
+  for (j = 0; j < next.pvCount; j++) {
+    if (!matched[j]) {
+      order[added++] = j;
+    }
+  }
+  PermutePVList(&next, order);
+  free(order);
+
+  identity = (kept == logger->pvCount) && (next.pvCount == kept);
+  for (j = 0; identity && (j < kept); j++) {
+    identity = (keep[j] == j);
+  }
+  sameLayout = (next.pvCount == logger->pvCount) && (next.scalarsAsColumns == logger->scalarsAsColumns);
+  for (j = 0; sameLayout && (j < next.pvCount); j++) {
+    sameLayout = (strcmp(next.readbackName[j], logger->readbackName[j]) == 0) &&
+                 (strcmp(next.units ? next.units[j] : "", logger->units ? logger->units[j] : "") == 0) &&
+                 SamePVExpectations(logger, j, &next, j);
+  }
+  if (!sameLayout && !logger->generations && !logger->dailyFiles && !logger->monthlyFiles) {
+    if (logger->verbose) {
+      fprintf(stdout, "The logged columns changed, exiting\n");
+    }
+    FreePVList(&next);
+    free(next.averagedValues);
+    free(keep);
+    return (1);
+  }
+  if (logger->verbose) {
+    fprintf(stdout, "Keeping %ld PVs, removing %ld and adding %ld\n", kept, (long)logger->pvCount - kept, (long)next.pvCount - kept);
+  }
+
+  if (!sameLayout) {
+    //Finish the current files while the current PV list is still in place
+    if ((logger->verbose) && (logger->onePv_OutputDirectory == NULL)) {
+      fprintf(stdout, "Data written to %s\n", logger->outputfile);
+    }
+    if (CloseFiles(*SDDS_table, pva, logger) == 1) {
+      return (-1);
+    }
+    FreeEmptyColumns(logger);
+    if (logger->onePv_outputfile) {
+      for (j = 0; j < logger->pvCount; j++) {
+        free(logger->onePv_outputfile[j]);
+        free(logger->onePv_outputfileOrig[j]);
+      }
+      free(logger->onePv_outputfile);
+      free(logger->onePv_outputfileOrig);
+      logger->onePv_outputfile = logger->onePv_outputfileOrig = NULL;
+    }
+    if (logger->onePv_segment) {
+      free(logger->outputfileOrig);
+      logger->outputfileOrig = NULL;
+    }
+    free(logger->outputfile);
+    free(logger->elementIndex);
+    free(logger->outputRow);
+    free(logger->outputPage);
+    free(logger->rollupColumn);
+    free(logger->rollupCount);
+    free(logger->rollupMin);
+    free(logger->rollupMax);
+    free(logger->rollupSum);
+    free(logger->rollupLast);
+    logger->outputfile = NULL;
+    logger->elementIndex = NULL;
+    logger->outputRow = logger->outputPage = NULL;
+    logger->rollupColumn = logger->rollupCount = NULL;
+    logger->rollupMin = logger->rollupMax = logger->rollupSum = logger->rollupLast = NULL;
+    logger->mallocNeeded = true;
+  }
+
+  if (!identity) {
+    FreeDeadbandState(logger);
+    SelectPVA(pva, keep, kept);
+  }
+  verifiedType = (bool *)malloc(sizeof(bool) * next.pvCount);
+  for (j = 0; j < next.pvCount; j++) {
+    verifiedType[j] = (j < kept) && logger->verifiedType[keep[j]] && SamePVExpectations(logger, keep[j], &next, j);
+  }
+  free(logger->verifiedType);
+  logger->verifiedType = verifiedType;
+  SwapPVList(logger, &next);
+  FreePVList(&next);
+  free(next.averagedValues);
+  free(keep);
+
+  if (logger->pvCount > kept) {
+    //Issue the connects of the new PVs without waiting, the kept ones stay on their channels
+    reallocPVA(pva, logger->pvCount);
+    epics::pvData::shared_vector<std::string> names(pva->numPVs);
+    epics::pvData::shared_vector<std::string> providerNames(pva->numPVs);
+    for (j = 0; j < pva->numPVs; j++) {
+      names[j] = logger->controlName[j];
+      providerNames[j] = logger->provider[j];
+      if (j < kept) {
+        continue;
+      }
+      if (logger->monitorRequestQueueSize) {
+        pva->pvaData[j].monitorRequestQueueSize = logger->monitorRequestQueueSize[j];
+      }
+      if (logger->monitorDeadband) {
+        pva->pvaData[j].monitorDeadband = logger->monitorDeadband[j];
+      }
+      if (logger->monitorDecimation) {
+        pva->pvaData[j].monitorDecimation = logger->monitorDecimation[j];
+      }
+    }
+    pva->pvaChannelNames = freeze(names);
+    pva->pvaProvider = freeze(providerNames);
+    ConnectPVA(pva, 0);
+    logger->reloadFirstNew = kept;
+    logger->reloadConnectDeadline = getLongDoubleTimeInSecs() + logger->pendIOtime;
+    if (logger->verbose) {
+      fprintf(stdout, "Connecting %ld new PVs in the background\n", pva->numPVs - kept);
+    }
+  } else if (!identity) {
+    CloseUnusedPVAChannels(pva);
+    logger->reloadConnectDeadline = 0;
+  }
+  if (!identity) {
+    //The types of the new PVs are verified by the main loop once they connect
+    for (j = 0; j < pva->numPVs; j++) {
+      pva->pvaData[j].useNativeValues = logger->expectScalarArray[j] && !logger->treatScalarArrayAsScalar[j] && logger->expectNumeric[j];
+    }
+    freePVAGetReadings(pva);
+  }
+  if (logger->monitor && !identity && (MonitorPVAValues(pva) == 1)) {
+    return (-1);
+  }
+
+  if (!sameLayout) {
+    if ((logger->onePv_OutputDirectory != NULL) && !logger->onePv_segment) {
+      *SDDS_table = (SDDS_TABLE *)realloc(*SDDS_table, sizeof(SDDS_TABLE) * pva->numPVs);
+      if (pva->numPVs > 40) {
+        logger->doDisconnect = true;
+      }
+    }
+    if (writer) {
+      writer->SDDS_table = *SDDS_table;
+    }
+    if (logger->onePv_OutputDirectory == NULL) {
+      //Let WriteHeaders choose between columns and arrays again
+      logger->n_rows = -1;
+      logger->scalarArraysAsColumns = true;
+    }
+    logger->NstepsAdjusted -= logger->step;
+    logger->step = 0;
+    if (WriteHeaders(*SDDS_table, pva, logger)) {
+      return (-1);
+    }
+    AllocateEmptyColumns(logger);
+  }
+  return (2);
+}
+
+static long SetGlitchParameters(SDDS_TABLE *sdds, LOGGER_DATA *logger) {
+  int64_t j;
+  int32_t result;
+
+  result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                             logger->triggerTimeIndex, (double)(logger->glitch_time));
+  if (result == 0) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+
+  for (j = 0; j < logger->glitch_pvCount; j++) {
+    if (logger->glitch_TransitionThresholdDefined && logger->glitch_TransitionDirectionDefined && (logger->glitch_transitionDirection[j] != 0)) {
+      result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                                 logger->glitch_triggerIndex[j], logger->glitch_triggered[j]);
+      if (result == 0) {
         SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
         return (1);
       }
-
+    }
+    if (((logger->glitch_NoAlarmDefined) && (logger->glitch_noAlarm[j] != 0)) ||
+        ((logger->glitch_MinorAlarmDefined) && (logger->glitch_minorAlarm[j] != 0)) ||
+        ((logger->glitch_MajorAlarmDefined) && (logger->glitch_majorAlarm[j] != 0))) {
       result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
-                                 logger->triggerTimeIndex, (double)(logger->glitch_time));
+                                 logger->glitch_alarmIndex[j], logger->glitch_alarmed[j]);
       if (result == 0) {
         SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
         return (1);
       }
-
-      for (j = 0; j < logger->glitch_pvCount; j++) {
-        if (logger->glitch_TransitionThresholdDefined && logger->glitch_TransitionDirectionDefined && (logger->glitch_transitionDirection[j] != 0)) {
-          result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
-                                     logger->glitch_triggerIndex[j], logger->glitch_triggered[j]);
-          if (result == 0) {
-            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-            return (1);
-          }
-        }
-        if (((logger->glitch_NoAlarmDefined) && (logger->glitch_noAlarm[j] != 0)) ||
-            ((logger->glitch_MinorAlarmDefined) && (logger->glitch_minorAlarm[j] != 0)) ||
-            ((logger->glitch_MajorAlarmDefined) && (logger->glitch_majorAlarm[j] != 0))) {
-          result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
-                                     logger->glitch_alarmIndex[j], logger->glitch_alarmed[j]);
-          if (result == 0) {
-            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-            return (1);
-          }
-          result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
-                                     logger->glitch_alarmSeverityIndex[j], logger->glitch_alarmSeverity[j]);
-          if (result == 0) {
-            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-            return (1);
-          }
-        }
-        if (logger->glitch_GlitchThresholdDefined && (logger->glitch_glitchThreshold[j] != 0) &&
-            logger->glitch_GlitchBaselineSamplesDefined && (logger->glitch_glitchBaselineSamples[j] > 0)) {
-          result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
-                                     logger->glitch_glitchIndex[j], logger->glitch_glitched[j]);
-          if (result == 0) {
-            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-            return (1);
-          }
-        }
+      result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                                 logger->glitch_alarmSeverityIndex[j], logger->glitch_alarmSeverity[j]);
+      if (result == 0) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        return (1);
       }
     }
-
-    if (logger->scalarsAsColumns) {
-      result = SDDS_SetRowValues(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, count,
-                                 logger->caErrorsIndex, (int32_t)(logger->circularbufferDouble[pva->numPVs][n][0]),
-                                 logger->timeIndex, (double)(logger->circularbufferLongDouble[n]),
-                                 logger->stepIndex, (int32_t)(count - stepOffset),
-                                 logger->timeofdayIndex, (float)(logger->circularbufferDouble[pva->numPVs + 1][n][0]),
-                                 logger->dayofmonthIndex, (float)(logger->circularbufferDouble[pva->numPVs + 2][n][0]),
-                                 -1);
+    if (logger->glitch_GlitchThresholdDefined && (logger->glitch_glitchThreshold[j] != 0) &&
+        logger->glitch_GlitchBaselineSamplesDefined && (logger->glitch_glitchBaselineSamples[j] > 0)) {
+      result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                                 logger->glitch_glitchIndex[j], logger->glitch_glitched[j]);
       if (result == 0) {
         SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
         return (1);
       }
-      for (i = 0; i < pva->numPVs; i++) {
+    }
+  }
+
+  return (0);
+}
+
+/* Gather one value per slot of the glitch window into a contiguous column buffer */
+static void GatherCircularBufferColumn(LOGGER_DATA *logger, long i, int64_t n, int64_t length, double *column) {
+  int64_t count;
+  double *data = CircularBufferDoubles(logger, i, 0);
+  long stride = CircularBufferElements(logger, i);
+  for (count = 0; count < length; count++) {
+    column[count] = data[n * stride];
+    if (++n == logger->circularbuffer_length) {
+      n = 0;
+    }
+  }
+}
+
+long WriteGlitchPage(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logger) {
+  int64_t n, count, i, k, length, n_rows, stepOffset;
+  int32_t result;
+  SDDS_TABLE *sdds;
+  sdds = &(SDDS_table[0]);
+
+  if (logger->glitch_step > logger->circularbuffer_before) {
+    length = logger->circularbuffer_before + 1 + logger->step - logger->glitch_step;
+    n = (logger->circularbuffer_index + logger->circularbuffer_length - length) % logger->circularbuffer_length;
+    stepOffset = logger->circularbuffer_before;
+  } else {
+    length = 1 + logger->step;
+    n = 0;
+    stepOffset = logger->glitch_step;
+  }
+
+  if (logger->scalarsAsColumns) {
+    //The whole window is one page, so each column is gathered out of the ring and set in one call
+    double *column;
+    char **stringColumn;
+    int64_t m;
+    n_rows = length;
+    if (!SDDS_StartPage(sdds, n_rows)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+    if (SetGlitchParameters(sdds, logger)) {
+      return (1);
+    }
+    column = (double *)malloc(sizeof(double) * length);
+    stringColumn = (char **)malloc(sizeof(char *) * length);
+    result = 1;
+    for (count = 0, m = n; count < length; count++) {
+      column[count] = (double)(logger->circularbufferLongDouble[m]);
+      if (++m == logger->circularbuffer_length) {
+        m = 0;
+      }
+    }
+    result = result && SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, column, length, logger->timeIndex);
+    for (count = 0; count < length; count++) {
+      column[count] = (double)(count - stepOffset);
+    }
+    result = result && SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, column, length, logger->stepIndex);
+    GatherCircularBufferColumn(logger, pva->numPVs, n, length, column);
+    result = result && SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, column, length, logger->caErrorsIndex);
+    GatherCircularBufferColumn(logger, pva->numPVs + 1, n, length, column);
+    result = result && SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, column, length, logger->timeofdayIndex);
+    GatherCircularBufferColumn(logger, pva->numPVs + 2, n, length, column);
+    result = result && SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, column, length, logger->dayofmonthIndex);
+    for (i = 0; result && (i < pva->numPVs); i++) {
+      if (logger->expectNumeric[i]) {
+        GatherCircularBufferColumn(logger, i, n, length, column);
+        result = SDDS_SetColumnFromDoubles(sdds, SDDS_SET_BY_INDEX, column, length, logger->elementIndex[i]);
+      } else {
+        for (count = 0, m = n; count < length; count++) {
+          stringColumn[count] = CircularBufferString(logger, i, m, 0);
+          if (++m == logger->circularbuffer_length) {
+            m = 0;
+          }
+        }
+        result = SDDS_SetColumn(sdds, SDDS_SET_BY_INDEX, stringColumn, length, logger->elementIndex[i]);
+      }
+    }
+    free(column);
+    free(stringColumn);
+    if ((result == 0) || !SDDS_WriteTable(sdds)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+    return (0);
+  }
+
+  n_rows = logger->n_rows;
+  for (count = 0; count < length; count++) {
+    if (!SDDS_StartPage(sdds, n_rows)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+    if (SetGlitchParameters(sdds, logger)) {
+      return (1);
+    }
+    result = SDDS_SetParameters(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                                logger->caErrorsIndex, (int32_t)(CircularBufferDoubles(logger, pva->numPVs, n)[0]),
+                                logger->timeIndex, (double)(logger->circularbufferLongDouble[n]),
+                                logger->stepIndex, (int32_t)(count - stepOffset),
+                                logger->timeofdayIndex, (float)(CircularBufferDoubles(logger, pva->numPVs + 1, n)[0]),
+                                logger->dayofmonthIndex, (float)(CircularBufferDoubles(logger, pva->numPVs + 2, n)[0]),
+                                -1);
+    if (result == 0) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+    for (i = 0; i < pva->numPVs; i++) {
+      if (logger->expectScalar[i] || logger->treatScalarArrayAsScalar[i]) {
         if (logger->expectNumeric[i]) {
-          result = SDDS_SetRowValues(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, count,
-                                     logger->elementIndex[i], logger->circularbufferDouble[i][n][0], -1);
+          result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                                     logger->elementIndex[i], CircularBufferDoubles(logger, i, n)[0]);
         } else {
-          result = SDDS_SetRowValues(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, count,
-                                     logger->elementIndex[i], logger->circularbufferString[i][n][0], -1);
+          result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                                     logger->elementIndex[i], CircularBufferString(logger, i, n, 0));
         }
         if (result == 0) {
           SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
           return (1);
         }
-      }
-    } else {
-      result = SDDS_SetParameters(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
-                                  logger->caErrorsIndex, (int32_t)(logger->circularbufferDouble[pva->numPVs][n][0]),
-                                  logger->timeIndex, (double)(logger->circularbufferLongDouble[n]),
-                                  logger->stepIndex, (int32_t)(count - stepOffset),
-                                  logger->timeofdayIndex, (float)(logger->circularbufferDouble[pva->numPVs + 1][n][0]),
-                                  logger->dayofmonthIndex, (float)(logger->circularbufferDouble[pva->numPVs + 2][n][0]),
-                                  -1);
-      if (result == 0) {
-        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-        return (1);
-      }
-      for (i = 0; i < pva->numPVs; i++) {
-        if (logger->expectScalar[i] || logger->treatScalarArrayAsScalar[i]) {
+      } else {
+        int32_t start = 1;
+        int32_t ee = logger->expectElements[i];
+        char **strings = NULL;
+        if ((logger->scalarArrayStartIndex != NULL) && (logger->scalarArrayEndIndex != NULL)) {
+          start = logger->scalarArrayStartIndex[i];
+          ee = logger->scalarArrayEndIndex[i] - logger->scalarArrayStartIndex[i] + 1;
+        }
+        if (!logger->expectNumeric[i]) {
+          strings = (char **)malloc(sizeof(char *) * ee);
+          for (k = 0; k < ee; k++) {
+            strings[k] = CircularBufferString(logger, i, n, start - 1 + k);
+          }
+        }
+        if (logger->scalarArraysAsColumns) {
           if (logger->expectNumeric[i]) {
-            result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
-                                       logger->elementIndex[i], logger->circularbufferDouble[i][n][0]);
+            result = SDDS_SetColumn(sdds, SDDS_SET_BY_INDEX,
+                                    CircularBufferDoubles(logger, i, n) + (start - 1), ee, logger->elementIndex[i]);
           } else {
-            result = SDDS_SetParameter(sdds, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
-                                       logger->elementIndex[i], logger->circularbufferString[i][n][0]);
-          }
-          if (result == 0) {
-            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-            return (1);
+            result = SDDS_SetColumn(sdds, SDDS_SET_BY_INDEX, strings, ee, logger->elementIndex[i]);
           }
         } else {
-          int32_t start = 1;
-          int32_t ee = logger->expectElements[i];
-          if ((logger->scalarArrayStartIndex != NULL) && (logger->scalarArrayEndIndex != NULL)) {
-            start = logger->scalarArrayStartIndex[i];
-            ee = logger->scalarArrayEndIndex[i] - logger->scalarArrayStartIndex[i] + 1;
-          }
-          if (logger->scalarArraysAsColumns) {
-            if (logger->expectNumeric[i]) {
-              result = SDDS_SetColumn(sdds, SDDS_SET_BY_INDEX,
-                                      logger->circularbufferDouble[i][n] + (start - 1), ee, logger->elementIndex[i]);
-            } else {
-              result = SDDS_SetColumn(sdds, SDDS_SET_BY_INDEX,
-                                      logger->circularbufferString[i][n] + (start - 1), ee, logger->elementIndex[i]);
-            }
-            if (result == 0) {
-              SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-              return (1);
-            }
+          if (logger->expectNumeric[i]) {
+            result = SDDS_SetArrayVararg(sdds, (char *)logger->readbackName[i], SDDS_CONTIGUOUS_DATA,
+                                         CircularBufferDoubles(logger, i, n) + (start - 1), ee);
           } else {
-            if (logger->expectNumeric[i]) {
-              result = SDDS_SetArrayVararg(sdds, (char *)logger->readbackName[i], SDDS_CONTIGUOUS_DATA,
-                                           logger->circularbufferDouble[i][n] + (start - 1), ee);
-            } else {
-              result = SDDS_SetArrayVararg(sdds, (char *)logger->readbackName[i], SDDS_CONTIGUOUS_DATA,
-                                           logger->circularbufferString[i][n] + (start - 1), ee);
-            }
-            if (result == 0) {
-              SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-              return (1);
-            }
+            result = SDDS_SetArrayVararg(sdds, (char *)logger->readbackName[i], SDDS_CONTIGUOUS_DATA,
+                                         strings, ee);
           }
         }
+        if (strings) {
+          free(strings);
+        }
+        if (result == 0) {
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+          return (1);
+        }
       }
     }
-    if (logger->scalarsAsColumns == false) {
-      if (!SDDS_WriteTable(sdds)) {
-        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-        return (1);
-      }
+    if (!SDDS_WriteTable(sdds)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
     }
 
     n++;
@@ -4907,13 +6913,6 @@ long WriteGlitchPage(SDDS_TABLE *SDDS_table, PVA_OVERALL *pva, LOGGER_DATA *logg
     }
   }
 
-  if (logger->scalarsAsColumns) {
-    if (!SDDS_WriteTable(sdds)) {
-      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-      return (1);
-    }
-  }
-
   return (0);
 }
 
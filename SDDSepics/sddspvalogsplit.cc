@@ -0,0 +1,308 @@
+/*
+ * sddspvalogsplit
+ *
+ * Splits a segment file written by sddspvalogger -onePvPerFile=<dirName>,segment
+ * into the <outputDirectory>/<ReadbackName>/log files that sddspvalogger writes
+ * without the segment qualifier. A generation or date suffix on the segment file
+ * name (segment-0001, segment.2024-0101) is kept on the per PV file names.
+ */
+
+#include <string>
+#include <vector>
+#include <cinttypes>
+
+#include "mdb.h"
+#include "SDDS.h"
+#include "scan.h"
+#ifndef _WIN32
+#  include <unistd.h>
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#endif
+
+#define CLO_OVERWRITE 0
+#define CLO_VERBOSE 1
+#define COMMANDLINE_OPTIONS 2
+static char *commandline_option[COMMANDLINE_OPTIONS] = {
+  (char *)"overwrite",
+  (char *)"verbose"};
+
+static char *USAGE = (char *)"sddspvalogsplit <segmentFile> <outputDirectory>\n\
+  [-overwrite] [-verbose]\n\n\
+Writes one SDDS file per PV from a segment file made by\n\
+sddspvalogger -onePvPerFile=<dirName>,segment.\n\
+segmentFile      The segment file.\n\
+outputDirectory  The files are written to <outputDirectory>/<ReadbackName>/log<suffix>\n\
+                 where <suffix> is whatever follows \"segment\" in the segment file name.\n\
+-overwrite       Replace existing files.\n\
+-verbose         Print the name of each file written.\n";
+
+typedef struct
+{
+  int32_t numPVs;
+  char **readbackName, **units, **storageType;
+  int64_t rows;
+  int32_t *pvIndex, *caErrors;
+  double *time, *value;
+  char **stringValue;
+} SEGMENT_DATA;
+
+/*
+  Read every page of the segment file. The ReadbackName, Units and StorageType arrays
+  are taken from the first page.
+*/
+static long ReadSegment(char *filename, SEGMENT_DATA *segment) {
+  SDDS_DATASET SDDS_in;
+  SDDS_ARRAY *array;
+  int64_t rows;
+  int32_t *pvIndex, *caErrors;
+  double *time, *value;
+  char **stringValue;
+  const char *arrayName[3] = {"ReadbackName", "Units", "StorageType"};
+  char ***arrayData[3];
+  long i;
+
+  arrayData[0] = &(segment->readbackName);
+  arrayData[1] = &(segment->units);
+  arrayData[2] = &(segment->storageType);
+  if (!SDDS_InitializeInput(&SDDS_in, filename)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  while (SDDS_ReadPage(&SDDS_in) > 0) {
+    if (segment->readbackName == NULL) {
+      for (i = 0; i < 3; i++) {
+        if ((array = SDDS_GetArray(&SDDS_in, (char *)arrayName[i], NULL)) == NULL) {
+          fprintf(stderr, "error: %s is not a segment file\n", filename);
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+          return (1);
+        }
+        segment->numPVs = array->elements;
+        *(arrayData[i]) = (char **)array->data;
+        array->data = NULL;
+        SDDS_FreeArray(array);
+      }
+    }
+    if ((rows = SDDS_RowCount(&SDDS_in)) <= 0) {
+      continue;
+    }
+    if (((pvIndex = SDDS_GetColumnInLong(&SDDS_in, (char *)"PVIndex")) == NULL) ||
+        ((caErrors = SDDS_GetColumnInLong(&SDDS_in, (char *)"CAerrors")) == NULL) ||
+        ((time = SDDS_GetColumnInDoubles(&SDDS_in, (char *)"Time")) == NULL) ||
+        ((value = SDDS_GetColumnInDoubles(&SDDS_in, (char *)"Value")) == NULL) ||
+        ((stringValue = (char **)SDDS_GetColumn(&SDDS_in, (char *)"StringValue")) == NULL)) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      return (1);
+    }
+    segment->pvIndex = (int32_t *)SDDS_Realloc(segment->pvIndex, sizeof(int32_t) * (segment->rows + rows));
+    segment->caErrors = (int32_t *)SDDS_Realloc(segment->caErrors, sizeof(int32_t) * (segment->rows + rows));
+    segment->time = (double *)SDDS_Realloc(segment->time, sizeof(double) * (segment->rows + rows));
+    segment->value = (double *)SDDS_Realloc(segment->value, sizeof(double) * (segment->rows + rows));
+    segment->stringValue = (char **)SDDS_Realloc(segment->stringValue, sizeof(char *) * (segment->rows + rows));
+    memcpy(segment->pvIndex + segment->rows, pvIndex, sizeof(int32_t) * rows);
+    memcpy(segment->caErrors + segment->rows, caErrors, sizeof(int32_t) * rows);
+    memcpy(segment->time + segment->rows, time, sizeof(double) * rows);
+    memcpy(segment->value + segment->rows, value, sizeof(double) * rows);
+    memcpy(segment->stringValue + segment->rows, stringValue, sizeof(char *) * rows);
+    segment->rows += rows;
+    free(pvIndex);
+    free(caErrors);
+    free(time);
+    free(value);
+    free(stringValue);
+  }
+  if (!SDDS_Terminate(&SDDS_in)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  if (segment->readbackName == NULL) {
+    fprintf(stderr, "error: %s has no data\n", filename);
+    return (1);
+  }
+  return (0);
+}
+
+/*
+  Write the given rows of one PV with the CAerrors, Time and <ReadbackName> columns
+  sddspvalogger uses for scalar PVs.
+*/
+static long WritePVFile(char *filename, SEGMENT_DATA *segment, int32_t pv, int64_t *row, int64_t rows) {
+  SDDS_DATASET SDDS_out;
+  int32_t type;
+  int32_t *caErrors;
+  double *time, *value;
+  char **strings, *characters;
+  int64_t i;
+  long result = 0;
+
+  if ((type = SDDS_IdentifyType(segment->storageType[pv])) == 0) {
+    fprintf(stderr, "error: invalid storage type %s for %s\n", segment->storageType[pv], segment->readbackName[pv]);
+    return (1);
+  }
+  if (!SDDS_InitializeOutput(&SDDS_out, SDDS_BINARY, 1, NULL, NULL, filename) ||
+      !SDDS_SetRowCountMode(&SDDS_out, SDDS_FIXEDROWCOUNT) ||
+      (SDDS_DefineColumn(&SDDS_out, "CAerrors", NULL, NULL, "Channel access errors for this row", NULL, SDDS_LONG, 0) < 0) ||
+      (SDDS_DefineColumn(&SDDS_out, "Time", NULL, "s", "Time since start of epoch", NULL, SDDS_DOUBLE, 0) < 0) ||
+      (SDDS_DefineColumn(&SDDS_out, segment->readbackName[pv], NULL, segment->units[pv], NULL, NULL, type, 0) < 0) ||
+      !SDDS_WriteLayout(&SDDS_out) || !SDDS_StartPage(&SDDS_out, rows)) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+    return (1);
+  }
+  caErrors = (int32_t *)malloc(sizeof(int32_t) * (rows + 1));
+  time = (double *)malloc(sizeof(double) * (rows + 1));
+  value = (double *)malloc(sizeof(double) * (rows + 1));
+  strings = (char **)malloc(sizeof(char *) * (rows + 1));
+  characters = (char *)malloc(sizeof(char) * (rows + 1));
+  for (i = 0; i < rows; i++) {
+    caErrors[i] = segment->caErrors[row[i]];
+    time[i] = segment->time[row[i]];
+    value[i] = segment->value[row[i]];
+    strings[i] = segment->stringValue[row[i]];
+    characters[i] = strings[i][0];
+  }
+  if (!SDDS_SetColumnFromLongs(&SDDS_out, SDDS_SET_BY_NAME, caErrors, rows, (char *)"CAerrors") ||
+      !SDDS_SetColumnFromDoubles(&SDDS_out, SDDS_SET_BY_NAME, time, rows, (char *)"Time")) {
+    result = 1;
+  } else if (type == SDDS_STRING) {
+    result = !SDDS_SetColumn(&SDDS_out, SDDS_SET_BY_NAME, strings, rows, segment->readbackName[pv]);
+  } else if (type == SDDS_CHARACTER) {
+    result = !SDDS_SetColumn(&SDDS_out, SDDS_SET_BY_NAME, characters, rows, segment->readbackName[pv]);
+  } else {
+    result = !SDDS_SetColumnFromDoubles(&SDDS_out, SDDS_SET_BY_NAME, value, rows, segment->readbackName[pv]);
+  }
+  if ((result == 1) || !SDDS_WritePage(&SDDS_out)) {
+    result = 1;
+  }
+  if (!SDDS_Terminate(&SDDS_out)) {
+    result = 1;
+  }
+  if (result == 1) {
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+  }
+  free(caErrors);
+  free(time);
+  free(value);
+  free(strings);
+  free(characters);
+  return (result);
+}
+
+static long MakeDirectory(const char *directory) {
+#ifndef _WIN32
+  mode_t mode;
+  if (access(directory, F_OK) == 0) {
+    return (0);
+  }
+  mode = umask(0);
+  umask(mode);
+  mode = (0777 & ~mode) | S_IRUSR | S_IWUSR | S_IXUSR;
+  if (mkdir(directory, mode) != 0) {
+    fprintf(stderr, "Unable to create directory %s\n", directory);
+    return (1);
+  }
+#endif
+  return (0);
+}
+
+int main(int argc, char *argv[]) {
+  SCANNED_ARG *s_arg;
+  SEGMENT_DATA segment;
+  char *segmentFile = NULL, *outputDirectory = NULL;
+  bool overwrite = false, verbose = false;
+  std::string suffix, directory, filename;
+  std::vector<int64_t> first, rowList;
+  int64_t i;
+  int32_t j;
+  const char *base;
+
+  SDDS_RegisterProgramName(argv[0]);
+  argc = scanargs(&s_arg, argc, argv);
+  if (argc < 3) {
+    fprintf(stderr, "%s", USAGE);
+    return (1);
+  }
+  for (i = 1; i < argc; i++) {
+    if (s_arg[i].arg_type == OPTION) {
+      switch (match_string(s_arg[i].list[0], commandline_option, COMMANDLINE_OPTIONS, 0)) {
+      case CLO_OVERWRITE:
+        overwrite = true;
+        break;
+      case CLO_VERBOSE:
+        verbose = true;
+        break;
+      default:
+        fprintf(stderr, "unrecognized option: %s\n", s_arg[i].list[0]);
+        return (1);
+      }
+    } else if (segmentFile == NULL) {
+      segmentFile = s_arg[i].list[0];
+    } else if (outputDirectory == NULL) {
+      outputDirectory = s_arg[i].list[0];
+    } else {
+      fprintf(stderr, "too many filenames given\n%s", USAGE);
+      return (1);
+    }
+  }
+  if (outputDirectory == NULL) {
+    fprintf(stderr, "%s", USAGE);
+    return (1);
+  }
+
+  base = strrchr(segmentFile, '/');
+  base = base ? base + 1 : segmentFile;
+  if (strncmp(base, "segment", 7) == 0) {
+    suffix = base + 7;
+  }
+
+  memset(&segment, 0, sizeof(segment));
+  if (ReadSegment(segmentFile, &segment) == 1) {
+    return (1);
+  }
+
+  //Group the rows by PV, keeping their order
+  first.assign(segment.numPVs + 1, 0);
+  for (i = 0; i < segment.rows; i++) {
+    if ((segment.pvIndex[i] < 0) || (segment.pvIndex[i] >= segment.numPVs)) {
+      fprintf(stderr, "error: invalid PVIndex %" PRId32 " in row %" PRId64 "\n", segment.pvIndex[i], i);
+      return (1);
+    }
+    first[segment.pvIndex[i] + 1]++;
+  }
+  for (j = 0; j < segment.numPVs; j++) {
+    first[j + 1] += first[j];
+  }
+  rowList.resize(segment.rows);
+  {
+    std::vector<int64_t> next(first.begin(), first.end() - 1);
+    for (i = 0; i < segment.rows; i++) {
+      rowList[next[segment.pvIndex[i]]++] = i;
+    }
+  }
+
+  for (j = 0; j < segment.numPVs; j++) {
+    std::string name(segment.readbackName[j]);
+    for (size_t k = 0; k < name.size(); k++) {
+      if (name[k] == '/') {
+        name[k] = '+';
+      }
+    }
+    directory = std::string(outputDirectory) + "/" + name;
+    if (MakeDirectory(directory.c_str()) == 1) {
+      return (1);
+    }
+    filename = directory + "/log" + suffix;
+    if (!overwrite && fexists((char *)filename.c_str())) {
+      fprintf(stderr, "error: File %s already exists.\n", filename.c_str());
+      return (1);
+    }
+    if (WritePVFile((char *)filename.c_str(), &segment, j, rowList.data() + first[j], first[j + 1] - first[j]) == 1) {
+      return (1);
+    }
+    if (verbose) {
+      fprintf(stdout, "%s: %" PRId64 " rows\n", filename.c_str(), first[j + 1] - first[j]);
+    }
+  }
+
+  free_scanargs(&s_arg, argc);
+  return (0);
+}
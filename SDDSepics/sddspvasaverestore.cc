@@ -1257,6 +1257,7 @@ long SetupPVAConnection(CONTROL_NAME *control_name, PVA_OVERALL *pva) {
   }
   pva->pvaChannelNames = freeze(names);
   pva->pvaProvider = freeze(providerNames);
+  pva->pipelinePuts = true;
   ConnectPVA(pva, control_name->pendIOTime); //skip field not used. All new PVs are connected
   if (GetPVAValues(pva) == 1)                //skip fields honored
   {
@@ -344,6 +344,7 @@ int main(int argc, char **argv) {
 #if (EPICS_VERSION > 3)
       //Allocate memory for pva structure
       allocPVA(&pva, PVs, 0);
+      pva.pipelinePuts = true;
       //List PV names
       epics::pvData::shared_vector<std::string> names(pva.numPVs);
       epics::pvData::shared_vector<std::string> provider(pva.numPVs);
@@ -457,6 +457,7 @@ int main(int argc, char **argv) {
     if (GetPVAValues(&pva) == 1) {
       return (EXIT_FAILURE);
     }
+    pva.useMonitorReadyList = true;
     if (MonitorPVAValues(&pva) == 1) {
       return (EXIT_FAILURE);
     }
@@ -933,8 +934,8 @@ long waitForEventPVA(PVA_OVERALL *pva, double timeLimit, double interval, long i
       if (result)
         return EVENT;
     }
-    epicsThreadSleep(interval);
-    if (PollMonitoredPVA(pva)) {
+    //Wake as soon as a monitored PV changes rather than sleeping the full interval
+    if (WaitAnyMonitoredPVA(pva, interval)) {
       //fprintf(stderr, "something changed\n");
     }
     timeNow = getTimeInSecs();
@@ -23,6 +23,9 @@
 #include "pv/pvaClient.h"
 #include "pv/pvaClientMultiChannel.h"
 #include "pv/pvEnumerated.h"
+#include "pv/event.h"
+#include "pv/lock.h"
+#include <thread>
 //#include "../modules/pvAccess/src/ca/caChannel.h"
 
 /* Example Callback Requesters
@@ -153,8 +156,23 @@ typedef struct
 {
   double *values;
   char **stringValues;
+  void *nativeValues; /* Numeric array data in its native scalarType when useNativeValues is set */
+  bool valuesStale;   /* values must be refreshed from nativeValues before use */
 } PVA_DATA;
 
+#define PVA_MONITOR_EXTRACT_UNRESOLVED 0
+#define PVA_MONITOR_EXTRACT_IGNORE 1
+#define PVA_MONITOR_EXTRACT_SCALAR 2
+#define PVA_MONITOR_EXTRACT_SCALARARRAY 3
+#define PVA_MONITOR_EXTRACT_ENUM 4
+#define PVA_MONITOR_EXTRACT_STRUCTURE 5
+
+/* putStatus values filled in by PutPVAValues when pipelinePuts is set */
+#define PVA_PUT_NONE -1
+#define PVA_PUT_OK 0
+#define PVA_PUT_FAILED 1
+#define PVA_PUT_TIMEOUT 2
+
 typedef struct
 {
   long numGetElements;
@@ -177,16 +195,150 @@ typedef struct
   int L1Ptr;
   int L2Ptr;
   bool skip;
+  /* Keep numeric array readings in their native type. Use GetPVANativeValues or
+     GetPVADoubleValues to read them since values is only filled in on demand. */
+  bool useNativeValues;
+  /* Ring of monitor readings kept when PVA_OVERALL.monitorQueueSize > 0 (numeric scalars only;
+     array PVs are never queued). Times are the server time stamps in seconds since 1970. */
+  double *monitorQueueValues;
+  double *monitorQueueTimes;
+  long monitorQueueHead, monitorQueueCount;
+  long monitorQueueOverflows;
+  double getLatency; /* Round-trip seconds of the last get, -1 if it timed out */
+  long putStatus;    /* PVA_PUT_* result of the last pipelined put */
+  double putLatency; /* Round-trip seconds of the last pipelined put, -1 if it did not complete */
+  /* Monitor extractor resolved on the first event and the offset of the field handed to
+     the extractor. The introspection interface it was resolved for is kept in
+     PVA_OVERALL.monitorStructure. */
+  int monitorExtractor;
+  size_t monitorFieldOffset;
+  /* Server-side rate limiting set before ConnectPVA/MonitorPVAValues. monitorRequestQueueSize
+     is sent as record[queueSize] in the monitor pvRequest (0 uses PVA_OVERALL.monitorQueueSize).
+     monitorDeadband (> 0) and monitorDecimation (> 1) are added to the channel name as the
+     EPICS 7 dbnd and dec channel filters, so only IOCs with those filters will connect. */
+  long monitorRequestQueueSize;
+  double monitorDeadband;
+  long monitorDecimation;
 } PVA_DATA_ALL_READINGS;
 
+/* Ready-list of the monitored PVs. When useMonitorReadyList is set the monitor callbacks
+   record the index of each PV that received an event so PollMonitoredPVA only visits
+   those PVs; ready and queued stay empty otherwise. waiter is the event of the
+   WaitAnyMonitoredPVA call blocked on this PVA structure, if any, and is signalled on
+   every monitor event. requesters holds the requester of each PV's monitor. */
+typedef struct
+{
+  epics::pvData::Mutex mutex;
+  std::vector<long> ready;
+  std::vector<bool> queued;
+  std::vector<epics::pvaClient::PvaClientMonitorRequesterPtr> requesters;
+  epics::pvData::Event *waiter;
+} PVA_MONITOR_READY_LIST;
+
+/* Completion state filled in by the get requester that GetPVAValues installs so it can
+   wait on all outstanding gets at once instead of calling waitGet on each PV in turn.
+   active marks a get that was issued and has not reported getDone yet, and pending counts
+   them. event is signalled on every completion. requesters holds the completion requester
+   of each PV's get. */
+typedef struct
+{
+  epics::pvData::Mutex mutex;
+  epics::pvData::Event event;
+  std::vector<bool> done;
+  std::vector<double> doneTime;
+  std::vector<bool> active;
+  long pending;
+  std::vector<epics::pvaClient::PvaClientGetRequesterPtr> requesters;
+} PVA_GET_COMPLETION;
+
+/* Completion state of the puts issued by PutPVAValues when pipelinePuts is set. active marks
+   a put that was issued and has not reported putDone yet, which is still the case after a
+   timeout. requesters holds the completion requester of each PV's put, and a putDone from a
+   requester that has since been replaced is ignored. */
+typedef struct
+{
+  epics::pvData::Mutex mutex;
+  epics::pvData::Event event;
+  std::vector<bool> done;
+  std::vector<double> doneTime;
+  std::vector<bool> active;
+  std::vector<epics::pvaClient::PvaClientPutRequesterPtr> requesters;
+} PVA_PUT_COMPLETION;
+
+/* Slab allocator that owns the get/monitor reading buffers of one PVA_OVERALL. Requests up
+   to PVA_ARENA_MAX_SLOT bytes are rounded up to a power of two and carved out of large
+   blocks. Freed slots go on a per-size free list and are handed out again, so steady state
+   monitoring does not call malloc, and freePVA releases the blocks instead of each buffer. */
+#define PVA_ARENA_SIZE_CLASSES 13 /* 16 bytes to 64 KiB */
+#define PVA_ARENA_MAX_SLOT (16 << (PVA_ARENA_SIZE_CLASSES - 1))
+#define PVA_ARENA_BLOCK_SIZE (1 << 20)
+typedef struct
+{
+  epics::pvData::Mutex mutex;
+  std::vector<char *> blocks;
+  std::vector<char *> largeSlots;
+  size_t blockUsed;
+  void *freeSlots[PVA_ARENA_SIZE_CLASSES];
+  size_t bytesReserved;
+  size_t bytesInUse;
+  size_t peakBytesInUse;
+  long systemAllocations;
+  long reusedSlots;
+} PVA_ARENA;
+
+typedef struct
+{
+  size_t bytesReserved;  /* Bytes obtained with malloc */
+  size_t bytesInUse;     /* Bytes in slots currently handed out */
+  size_t peakBytesInUse;
+  long systemAllocations; /* Number of malloc calls made by the arena */
+  long reusedSlots;       /* Number of requests satisfied from a free list or in place */
+} PVA_ARENA_STATS;
+
+/* Channels per PvaClientMultiChannel shard when ConnectPVA uses connectThreads */
+#define PVA_CONNECT_SHARD_SIZE 2000
+
+/* Smallest number of PVs given to each ExtractPVAValues thread when extractThreads > 1 */
+#define PVA_EXTRACT_MIN_RANGE 256
+
+/* Shards that ConnectPVA left connecting in the background. Each connect thread works on
+   multiChannels, and ready marks the shards whose connect has returned. start holds the
+   first channel of each shard followed by the channel count. */
+typedef struct PVA_CONNECT_SHARDS
+{
+  epics::pvData::Mutex mutex;
+  epics::pvData::Event event;
+  std::vector<epics::pvaClient::PvaClientMultiChannelPtr> multiChannels;
+  std::vector<long> start;
+  std::vector<double> time;
+  std::vector<bool> ready;
+  bool changed; /* A shard became ready since PollMonitoredPVA last looked */
+  long nextShard, shardsDone, channelsConnected;
+  std::vector<std::thread> threads;
+  ~PVA_CONNECT_SHARDS();
+} PVA_CONNECT_SHARDS;
+
+/* Connection summary filled in by ConnectPVA. Times are seconds from the start of the
+   connect and have the resolution of one shard. Only the channels connected when
+   ConnectPVA returned are counted. */
+typedef struct
+{
+  long channels;
+  long connected;
+  double elapsed;
+  double p50, p90, p99, max; /* Time-to-connect percentiles, -1 if nothing connected */
+} PVA_CONNECT_STATS;
+
 typedef struct
 {
   epics::pvaClient::PvaClientPtr pvaClientPtr;
   std::vector<epics::pvaClient::PvaClientMultiChannelPtr> pvaClientMultiChannelPtr;
   int numMultiChannels;
+  int numShards; /* PvaClientMultiChannels made by the first ConnectPVA, the ones after them hold added PVs */
   std::vector<epics::pvaClient::PvaClientGetPtr> pvaClientGetPtr;
   std::vector<epics::pvaClient::PvaClientPutPtr> pvaClientPutPtr;
   std::vector<epics::pvaClient::PvaClientMonitorPtr> pvaClientMonitorPtr;
+  std::vector<epics::pvData::StructureConstPtr> monitorStructure; /* Structure each PV's monitor extractor was resolved for */
 
   epics::pvData::shared_vector<const std::string> pvaChannelNames;
   epics::pvData::shared_vector<const std::string> pvaChannelNamesTop;
@@ -202,6 +354,26 @@ typedef struct
   bool useGetCallbacks;
   bool useMonitorCallbacks;
   bool usePutCallbacks;
+  bool useMonitorReadyList;
+  std::tr1::shared_ptr<PVA_MONITOR_READY_LIST> monitorReadyList;
+  long monitorQueueSize;
+  std::tr1::shared_ptr<PVA_GET_COMPLETION> getCompletion;
+  std::tr1::shared_ptr<PVA_ARENA> arena;
+  double getTimeout; /* Deadline in seconds for the gets issued by GetPVAValues, defaults to the ConnectPVA pendIOTime */
+  /* Issue every put, then wait for all completions against one putTimeout deadline and
+     record putStatus/putLatency for each PV instead of stopping at the first failure.
+     As without it, nothing is put if a PV with a value is not connected. */
+  bool pipelinePuts;
+  std::tr1::shared_ptr<PVA_PUT_COMPLETION> putCompletion;
+  double putTimeout; /* Deadline in seconds for pipelined puts, defaults to the ConnectPVA pendIOTime.
+                        A put still outstanding at the next PutPVAValues call is recreated. */
+  long connectThreads;        /* Connect shards of PVA_CONNECT_SHARD_SIZE channels on this many threads when > 1 */
+  bool reportConnectProgress; /* Print progress to stdout as the shards finish connecting */
+  bool connectInBackground;   /* Return from ConnectPVA once connectThreads shards are ready */
+  std::tr1::shared_ptr<PVA_CONNECT_SHARDS> connectShards;
+  PVA_CONNECT_STATS connectStats;
+  long extractThreads; /* Split ExtractPVAValues across this many threads when > 1, 1 keeps the serial loop */
+  double extractTime;  /* Seconds spent extracting get and monitor values, accumulated until the caller resets it */
   bool includeAlarmSeverity;
   long numPVs, prevNumPVs, numInternalPVs, prevNumInternalPVs, numNotConnected;
   PVA_DATA_ALL_READINGS *pvaData;
@@ -212,10 +384,12 @@ void allocPVA(PVA_OVERALL *pva, long PVs);
 void allocPVA(PVA_OVERALL *pva, long PVs, long repeats);
 void reallocPVA(PVA_OVERALL *pva, long PVs);
 void reallocPVA(PVA_OVERALL *pva, long PVs, long repeats);
+void SelectPVA(PVA_OVERALL *pva, long *keep, long count);
 void freePVA(PVA_OVERALL *pva);
 void freePVAGetReadings(PVA_OVERALL *pva);
 void freePVAMonitorReadings(PVA_OVERALL *pva);
 void ConnectPVA(PVA_OVERALL *pva, double pendIOTime);
+void CloseUnusedPVAChannels(PVA_OVERALL *pva);
 long GetPVAValues(PVA_OVERALL *pva);
 long GetPVAValues(PVA_OVERALL **pva, long count);
 long PrepPut(PVA_OVERALL *pva, long index, double value);
@@ -229,6 +403,12 @@ long MonitorPVAValues(PVA_OVERALL *pva);
 long PollMonitoredPVA(PVA_OVERALL *pva);
 long PollMonitoredPVA(PVA_OVERALL **pva, long count);
 long WaitEventMonitoredPVA(PVA_OVERALL *pva, long index, double secondsToWait);
+long WaitAnyMonitoredPVA(PVA_OVERALL *pva, double secondsToWait);
+long WaitAnyMonitoredPVA(PVA_OVERALL **pva, long count, double secondsToWait);
+long DrainPVAMonitorQueue(PVA_OVERALL *pva, long index, double *values, double *timeStamps, long maxReadings);
+void *GetPVANativeValues(PVA_OVERALL *pva, long index, long reading, bool monitorMode);
+double *GetPVADoubleValues(PVA_OVERALL *pva, long index, long reading, bool monitorMode);
+void GetPVAArenaStats(PVA_OVERALL *pva, PVA_ARENA_STATS *stats);
 long count_chars(char *string, char c);
 long ExtractPVAUnits(PVA_OVERALL *pva);
 void PausePVAMonitoring(PVA_OVERALL **pva, long count);
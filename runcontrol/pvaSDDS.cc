@@ -41,8 +41,14 @@
  */
 
 #include "pvaSDDS.h"
+#include "pv/timeStamp.h"
 #include <unordered_map>
 #include <inttypes.h>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <exception>
 
 typedef std::unordered_multimap<std::string, long> Mymap;
 typedef std::unordered_multimap<std::string, long>::iterator MymapIterator;
@@ -54,6 +60,369 @@ static long ExtractByPath(PVA_OVERALL *pva, long index, epics::pvData::PVStructu
 static long PutByPath(PVA_OVERALL *pva, long index, epics::pvData::PVStructurePtr root, const std::string &path);
 
 static bool ParseIndexedToken(const std::string &token, std::string &name, long &arrayIndex, bool &hasIndex);
+static long ExtractMonitorEvent(PVA_OVERALL *pva, long index);
+static long ExtractEnumeratedValue(PVA_OVERALL *pva, long index, epics::pvData::PVFieldPtr PVFieldPtr, bool monitorMode);
+static long ResolveMonitorExtractor(PVA_OVERALL *pva, long index, epics::pvData::PVStructurePtr pvStructurePtr);
+static void QueueMonitorReading(PVA_OVERALL *pva, long index, epics::pvData::PVStructurePtr pvStructurePtr);
+
+/*
+  Seconds on a monotonic clock, used for get deadlines and latencies.
+*/
+static double MonotonicSeconds() {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+  Get requester installed by GetPVAValues when useGetCallbacks is not set. It records the
+  completion time of the PV's get and wakes the GetPVAValues call waiting on its PVA_OVERALL.
+  A getDone from a requester that has since been replaced is ignored.
+*/
+class pvaGetCompletionRequester;
+typedef std::tr1::shared_ptr<pvaGetCompletionRequester> pvaGetCompletionRequesterPtr;
+
+class pvaGetCompletionRequester : public epics::pvaClient::PvaClientGetRequester,
+                                  public std::tr1::enable_shared_from_this<pvaGetCompletionRequester> {
+public:
+  POINTER_DEFINITIONS(pvaGetCompletionRequester);
+  pvaGetCompletionRequester(std::tr1::shared_ptr<PVA_GET_COMPLETION> const &completion, long index)
+    : completion(completion), index(index) {
+  }
+
+  static pvaGetCompletionRequesterPtr create(std::tr1::shared_ptr<PVA_GET_COMPLETION> const &completion, long index) {
+    pvaGetCompletionRequesterPtr client(pvaGetCompletionRequesterPtr(new pvaGetCompletionRequester(completion, index)));
+    return client;
+  }
+
+  virtual void getDone(const epics::pvData::Status &status,
+                       epics::pvaClient::PvaClientGetPtr const &clientGet) {
+    {
+      epics::pvData::Lock guard(completion->mutex);
+      if ((index >= (long)completion->requesters.size()) || (completion->requesters[index].get() != this) ||
+          (index >= (long)completion->active.size()) || !completion->active[index]) {
+        return;
+      }
+      completion->active[index] = false;
+      completion->done[index] = true;
+      completion->doneTime[index] = MonotonicSeconds();
+      completion->pending--;
+    }
+    completion->event.signal();
+  }
+
+private:
+  std::tr1::shared_ptr<PVA_GET_COMPLETION> completion;
+  long index;
+};
+
+/*
+  Install a new completion requester on the get of PV i. It is kept in getCompletion so it
+  lives as long as the get, and any requester it replaces stops reporting for PV i.
+*/
+static void SetGetCompletionRequester(PVA_OVERALL *pva, long i) {
+  pvaGetCompletionRequesterPtr requester(pvaGetCompletionRequester::create(pva->getCompletion, i));
+  {
+    epics::pvData::Lock guard(pva->getCompletion->mutex);
+    if ((long)pva->getCompletion->requesters.size() <= i) {
+      pva->getCompletion->requesters.resize(i + 1);
+    }
+    pva->getCompletion->requesters[i] = requester;
+    if ((i < (long)pva->getCompletion->active.size()) && pva->getCompletion->active[i]) {
+      pva->getCompletion->active[i] = false;
+      pva->getCompletion->pending--;
+    }
+  }
+  pva->pvaClientGetPtr[i]->setRequester(requester);
+}
+
+/*
+  Put requester installed by PutPVAValues when pipelinePuts is set. It records the completion
+  time of the PV's put and wakes the waiting PutPVAValues call, unless it has been replaced
+  by the requester of a newer put for the same PV.
+*/
+class pvaPutCompletionRequester;
+typedef std::tr1::shared_ptr<pvaPutCompletionRequester> pvaPutCompletionRequesterPtr;
+
+class pvaPutCompletionRequester : public epics::pvaClient::PvaClientPutRequester,
+                                  public std::tr1::enable_shared_from_this<pvaPutCompletionRequester> {
+public:
+  POINTER_DEFINITIONS(pvaPutCompletionRequester);
+  pvaPutCompletionRequester(std::tr1::shared_ptr<PVA_PUT_COMPLETION> const &completion, long index)
+    : completion(completion), index(index) {
+  }
+
+  static pvaPutCompletionRequesterPtr create(std::tr1::shared_ptr<PVA_PUT_COMPLETION> const &completion, long index) {
+    pvaPutCompletionRequesterPtr client(pvaPutCompletionRequesterPtr(new pvaPutCompletionRequester(completion, index)));
+    return client;
+  }
+
+  virtual void putDone(const epics::pvData::Status &status,
+                       epics::pvaClient::PvaClientPutPtr const &clientPut) {
+    {
+      epics::pvData::Lock guard(completion->mutex);
+      if ((index >= (long)completion->requesters.size()) || (completion->requesters[index].get() != this)) {
+        return;
+      }
+      completion->active[index] = false;
+      if (index < (long)completion->done.size()) {
+        completion->done[index] = true;
+        completion->doneTime[index] = MonotonicSeconds();
+      }
+    }
+    completion->event.signal();
+  }
+
+private:
+  std::tr1::shared_ptr<PVA_PUT_COMPLETION> completion;
+  long index;
+};
+
+/*
+  Install a new completion requester on the put of PV i. It is kept in putCompletion so it
+  lives as long as the put, and any requester it replaces stops reporting for PV i.
+*/
+static void SetPutCompletionRequester(PVA_OVERALL *pva, long i) {
+  pvaPutCompletionRequesterPtr requester(pvaPutCompletionRequester::create(pva->putCompletion, i));
+  {
+    epics::pvData::Lock guard(pva->putCompletion->mutex);
+    if ((long)pva->putCompletion->requesters.size() <= i) {
+      pva->putCompletion->requesters.resize(i + 1);
+      pva->putCompletion->active.resize(i + 1, false);
+    }
+    pva->putCompletion->requesters[i] = requester;
+    pva->putCompletion->active[i] = false;
+  }
+  pva->pvaClientPutPtr[i]->setRequester(requester);
+}
+
+/*
+  Monitor requester installed on each PV by MonitorPVAValues. When useMonitorReadyList is
+  set it records the PV index in the ready-list. It always wakes the WaitAnyMonitoredPVA
+  call waiting on the list, and then forwards the event to the user's monitorReqPtr if
+  useMonitorCallbacks is also set.
+*/
+class pvaReadyListMonitorRequester;
+typedef std::tr1::shared_ptr<pvaReadyListMonitorRequester> pvaReadyListMonitorRequesterPtr;
+
+class pvaReadyListMonitorRequester : public epics::pvaClient::PvaClientMonitorRequester,
+                                     public std::tr1::enable_shared_from_this<pvaReadyListMonitorRequester> {
+public:
+  POINTER_DEFINITIONS(pvaReadyListMonitorRequester);
+  pvaReadyListMonitorRequester(std::tr1::shared_ptr<PVA_MONITOR_READY_LIST> const &readyList, long index,
+                               epics::pvaClient::PvaClientMonitorRequesterPtr const &chained)
+    : readyList(readyList), index(index), chained(chained) {
+  }
+
+  static pvaReadyListMonitorRequesterPtr create(std::tr1::shared_ptr<PVA_MONITOR_READY_LIST> const &readyList, long index,
+                                                epics::pvaClient::PvaClientMonitorRequesterPtr const &chained) {
+    pvaReadyListMonitorRequesterPtr client(pvaReadyListMonitorRequesterPtr(new pvaReadyListMonitorRequester(readyList, index, chained)));
+    return client;
+  }
+
+  virtual void monitorConnect(const epics::pvData::Status &status,
+                              epics::pvaClient::PvaClientMonitorPtr const &monitor,
+                              epics::pvData::StructureConstPtr const &structure) {
+    if (chained) {
+      chained->monitorConnect(status, monitor, structure);
+    }
+  }
+  virtual void event(epics::pvaClient::PvaClientMonitorPtr const &monitor) {
+    {
+      epics::pvData::Lock guard(readyList->mutex);
+      //A PV dropped by SelectPVA may still see a late event
+      if ((index < (long)readyList->queued.size()) && (readyList->queued[index] == false)) {
+        readyList->queued[index] = true;
+        readyList->ready.push_back(index);
+      }
+      if (readyList->waiter) {
+        readyList->waiter->signal();
+      }
+    }
+    if (chained) {
+      chained->event(monitor);
+    }
+  }
+  virtual void unlisten() {
+    if (chained) {
+      chained->unlisten();
+    }
+  }
+
+private:
+  std::tr1::shared_ptr<PVA_MONITOR_READY_LIST> readyList;
+  long index;
+  epics::pvaClient::PvaClientMonitorRequesterPtr chained;
+};
+
+/*
+  Install a ready-list requester on the monitor of PV i. It is kept in the ready-list so it
+  lives as long as the monitor.
+*/
+static void SetReadyListMonitorRequester(PVA_OVERALL *pva, long i) {
+  epics::pvaClient::PvaClientMonitorRequesterPtr chained;
+  pvaReadyListMonitorRequesterPtr requester;
+
+  if (pva->useMonitorCallbacks) {
+    chained = pva->monitorReqPtr;
+  }
+  requester = pvaReadyListMonitorRequester::create(pva->monitorReadyList, i, chained);
+  {
+    epics::pvData::Lock guard(pva->monitorReadyList->mutex);
+    if ((long)pva->monitorReadyList->requesters.size() <= i) {
+      pva->monitorReadyList->requesters.resize(i + 1);
+    }
+    pva->monitorReadyList->requesters[i] = requester;
+  }
+  pva->pvaClientMonitorPtr[i]->setRequester(requester);
+}
+
+/*
+  Header placed in front of every arena slot. It is 16 bytes so the slot data stays aligned
+  for doubles and 64 bit integers.
+*/
+typedef struct
+{
+  size_t capacity;
+  long sizeClass; /* -1 for requests too large to pool */
+} PVA_ARENA_SLOT;
+
+static std::tr1::shared_ptr<PVA_ARENA> NewPVAArena() {
+  std::tr1::shared_ptr<PVA_ARENA> arena(new PVA_ARENA);
+  arena->blockUsed = 0;
+  for (long c = 0; c < PVA_ARENA_SIZE_CLASSES; c++) {
+    arena->freeSlots[c] = NULL;
+  }
+  arena->bytesReserved = 0;
+  arena->bytesInUse = 0;
+  arena->peakBytesInUse = 0;
+  arena->systemAllocations = 0;
+  arena->reusedSlots = 0;
+  return arena;
+}
+
+static void *PVAArenaAlloc(PVA_OVERALL *pva, size_t size) {
+  PVA_ARENA *arena = pva->arena.get();
+  PVA_ARENA_SLOT *slot;
+  size_t capacity = 16;
+  long sizeClass = 0;
+
+  epics::pvData::Lock guard(arena->mutex);
+  if (size > PVA_ARENA_MAX_SLOT) {
+    slot = (PVA_ARENA_SLOT *)malloc(sizeof(PVA_ARENA_SLOT) + size);
+    slot->capacity = size;
+    slot->sizeClass = -1;
+    arena->largeSlots.push_back((char *)slot);
+    arena->bytesReserved += sizeof(PVA_ARENA_SLOT) + size;
+    arena->systemAllocations++;
+  } else {
+    while (capacity < size) {
+      capacity <<= 1;
+      sizeClass++;
+    }
+    if (arena->freeSlots[sizeClass]) {
+      slot = (PVA_ARENA_SLOT *)arena->freeSlots[sizeClass];
+      arena->freeSlots[sizeClass] = *(void **)(slot + 1);
+      arena->reusedSlots++;
+    } else {
+      if (arena->blocks.empty() || (arena->blockUsed + sizeof(PVA_ARENA_SLOT) + capacity > PVA_ARENA_BLOCK_SIZE)) {
+        arena->blocks.push_back((char *)malloc(PVA_ARENA_BLOCK_SIZE));
+        arena->blockUsed = 0;
+        arena->bytesReserved += PVA_ARENA_BLOCK_SIZE;
+        arena->systemAllocations++;
+      }
+      slot = (PVA_ARENA_SLOT *)(arena->blocks.back() + arena->blockUsed);
+      arena->blockUsed += sizeof(PVA_ARENA_SLOT) + capacity;
+      slot->capacity = capacity;
+      slot->sizeClass = sizeClass;
+    }
+  }
+  arena->bytesInUse += slot->capacity;
+  if (arena->bytesInUse > arena->peakBytesInUse) {
+    arena->peakBytesInUse = arena->bytesInUse;
+  }
+  return slot + 1;
+}
+
+static void PVAArenaFree(PVA_OVERALL *pva, void *ptr) {
+  PVA_ARENA *arena = pva->arena.get();
+  PVA_ARENA_SLOT *slot;
+
+  if (ptr == NULL) {
+    return;
+  }
+  slot = (PVA_ARENA_SLOT *)ptr - 1;
+  epics::pvData::Lock guard(arena->mutex);
+  arena->bytesInUse -= slot->capacity;
+  if (slot->sizeClass < 0) {
+    std::vector<char *>::iterator it = std::find(arena->largeSlots.begin(), arena->largeSlots.end(), (char *)slot);
+    if (it != arena->largeSlots.end()) {
+      arena->largeSlots.erase(it);
+    }
+    arena->bytesReserved -= sizeof(PVA_ARENA_SLOT) + slot->capacity;
+    free(slot);
+  } else {
+    *(void **)ptr = arena->freeSlots[slot->sizeClass];
+    arena->freeSlots[slot->sizeClass] = slot;
+  }
+}
+
+/*
+  Allocate an array of string slots with every entry set to NULL.
+*/
+static char **PVAArenaStringArray(PVA_OVERALL *pva, long count) {
+  char **array = (char **)PVAArenaAlloc(pva, sizeof(char *) * count);
+  memset(array, 0, sizeof(char *) * count);
+  return array;
+}
+
+/*
+  Copy a string into an arena slot. The old slot is reused in place when it is large enough
+  so string PVs that change value do not allocate on every event.
+*/
+static char *PVAArenaStrcpy(PVA_OVERALL *pva, char *old, const char *s, size_t length) {
+  char *p;
+  if (old && (((PVA_ARENA_SLOT *)old - 1)->capacity > length)) {
+    memcpy(old, s, length + 1);
+    epics::pvData::Lock guard(pva->arena->mutex);
+    pva->arena->reusedSlots++;
+    return old;
+  }
+  PVAArenaFree(pva, old);
+  p = (char *)PVAArenaAlloc(pva, length + 1);
+  memcpy(p, s, length + 1);
+  return p;
+}
+
+/*
+  Release every arena block at once.
+*/
+static void ReleasePVAArena(PVA_OVERALL *pva) {
+  if (!pva->arena) {
+    return;
+  }
+  for (size_t b = 0; b < pva->arena->blocks.size(); b++) {
+    free(pva->arena->blocks[b]);
+  }
+  for (size_t b = 0; b < pva->arena->largeSlots.size(); b++) {
+    free(pva->arena->largeSlots[b]);
+  }
+  pva->arena.reset();
+}
+
+/*
+  Report how much memory the reading buffers of a pva structure are using.
+*/
+void GetPVAArenaStats(PVA_OVERALL *pva, PVA_ARENA_STATS *stats) {
+  memset(stats, 0, sizeof(PVA_ARENA_STATS));
+  if ((pva == NULL) || !pva->arena) {
+    return;
+  }
+  epics::pvData::Lock guard(pva->arena->mutex);
+  stats->bytesReserved = pva->arena->bytesReserved;
+  stats->bytesInUse = pva->arena->bytesInUse;
+  stats->peakBytesInUse = pva->arena->peakBytesInUse;
+  stats->systemAllocations = pva->arena->systemAllocations;
+  stats->reusedSlots = pva->arena->reusedSlots;
+}
 
 /*
   Allocate memory for the pva structure.
@@ -68,28 +437,37 @@ void allocPVA(PVA_OVERALL *pva, long PVs, long repeats) {
   pva->numPVs = PVs;
   pva->prevNumPVs = 0;
   pva->pvaData = (PVA_DATA_ALL_READINGS *)malloc(sizeof(PVA_DATA_ALL_READINGS) * pva->numPVs);
+  pva->arena = NewPVAArena();
   if (repeats < 2) {
     for (j = 0; j < pva->numPVs; j++) {
-      pva->pvaData[j].getData = (PVA_DATA *)malloc(sizeof(PVA_DATA));
+      pva->pvaData[j].getData = (PVA_DATA *)PVAArenaAlloc(pva, sizeof(PVA_DATA));
       pva->pvaData[j].getData[0].values = NULL;
       pva->pvaData[j].getData[0].stringValues = NULL;
+      pva->pvaData[j].getData[0].nativeValues = NULL;
+      pva->pvaData[j].getData[0].valuesStale = false;
     }
   } else {
     for (j = 0; j < pva->numPVs; j++) {
-      pva->pvaData[j].getData = (PVA_DATA *)malloc(sizeof(PVA_DATA) * repeats);
+      pva->pvaData[j].getData = (PVA_DATA *)PVAArenaAlloc(pva, sizeof(PVA_DATA) * repeats);
       for (i = 0; i < repeats; i++) {
         pva->pvaData[j].getData[i].values = NULL;
         pva->pvaData[j].getData[i].stringValues = NULL;
+        pva->pvaData[j].getData[i].nativeValues = NULL;
+        pva->pvaData[j].getData[i].valuesStale = false;
       }
     }
   }
   for (j = 0; j < pva->numPVs; j++) {
-    pva->pvaData[j].putData = (PVA_DATA *)malloc(sizeof(PVA_DATA));
-    pva->pvaData[j].monitorData = (PVA_DATA *)malloc(sizeof(PVA_DATA));
+    pva->pvaData[j].putData = (PVA_DATA *)PVAArenaAlloc(pva, sizeof(PVA_DATA));
+    pva->pvaData[j].monitorData = (PVA_DATA *)PVAArenaAlloc(pva, sizeof(PVA_DATA));
     pva->pvaData[j].putData[0].values = NULL;
     pva->pvaData[j].putData[0].stringValues = NULL;
+    pva->pvaData[j].putData[0].nativeValues = NULL;
+    pva->pvaData[j].putData[0].valuesStale = false;
     pva->pvaData[j].monitorData[0].values = NULL;
     pva->pvaData[j].monitorData[0].stringValues = NULL;
+    pva->pvaData[j].monitorData[0].nativeValues = NULL;
+    pva->pvaData[j].monitorData[0].valuesStale = false;
   }
   for (j = 0; j < pva->numPVs; j++) {
     pva->pvaData[j].numGetElements = 0;
@@ -108,6 +486,20 @@ void allocPVA(PVA_OVERALL *pva, long PVs, long repeats) {
     pva->pvaData[j].L1Ptr = j;
     pva->pvaData[j].L2Ptr = j;
     pva->pvaData[j].skip = false;
+    pva->pvaData[j].monitorQueueValues = NULL;
+    pva->pvaData[j].monitorQueueTimes = NULL;
+    pva->pvaData[j].monitorQueueHead = 0;
+    pva->pvaData[j].monitorQueueCount = 0;
+    pva->pvaData[j].monitorQueueOverflows = 0;
+    pva->pvaData[j].getLatency = -1;
+    pva->pvaData[j].putStatus = PVA_PUT_NONE;
+    pva->pvaData[j].putLatency = -1;
+    pva->pvaData[j].useNativeValues = false;
+    pva->pvaData[j].monitorExtractor = PVA_MONITOR_EXTRACT_UNRESOLVED;
+    pva->pvaData[j].monitorFieldOffset = 0;
+    pva->pvaData[j].monitorRequestQueueSize = 0;
+    pva->pvaData[j].monitorDeadband = 0;
+    pva->pvaData[j].monitorDecimation = 0;
   }
   pva->numNotConnected = PVs;
   pva->limitGetReadings = false;
@@ -115,14 +507,25 @@ void allocPVA(PVA_OVERALL *pva, long PVs, long repeats) {
   pva->useGetCallbacks = false;
   pva->useMonitorCallbacks = false;
   pva->usePutCallbacks = false;
+  pva->useMonitorReadyList = false;
+  pva->monitorQueueSize = 0;
+  pva->getTimeout = -1;
+  pva->pipelinePuts = false;
+  pva->putTimeout = -1;
+  pva->connectThreads = 1;
+  pva->reportConnectProgress = false;
+  pva->extractThreads = 1;
+  pva->extractTime = 0;
   pva->includeAlarmSeverity = false;
 
-  pva->numMultiChannels = 1;
+  pva->numMultiChannels = pva->numShards = 1;
   pva->pvaClientMultiChannelPtr.resize(pva->numMultiChannels);
+  pva->connectInBackground = false;
 
   pva->pvaClientGetPtr.resize(pva->numPVs);
   pva->pvaClientPutPtr.resize(pva->numPVs);
   pva->pvaClientMonitorPtr.resize(pva->numPVs);
+  pva->monitorStructure.resize(pva->numPVs);
 
   return;
 }
@@ -136,31 +539,42 @@ void reallocPVA(PVA_OVERALL *pva, long PVs, long repeats) {
   pva->prevNumPVs = pva->numPVs;
   pva->numPVs = PVs;
   pva->pvaData = (PVA_DATA_ALL_READINGS *)realloc(pva->pvaData, sizeof(PVA_DATA_ALL_READINGS) * pva->numPVs);
+  if (!pva->arena) {
+    pva->arena = NewPVAArena();
+  }
   pva->pvaChannelNames.resize(pva->numPVs);
   pva->pvaProvider.resize(pva->numPVs);
 
   if (repeats < 2) {
     for (j = pva->prevNumPVs; j < pva->numPVs; j++) {
-      pva->pvaData[j].getData = (PVA_DATA *)malloc(sizeof(PVA_DATA));
+      pva->pvaData[j].getData = (PVA_DATA *)PVAArenaAlloc(pva, sizeof(PVA_DATA));
       pva->pvaData[j].getData[0].values = NULL;
       pva->pvaData[j].getData[0].stringValues = NULL;
+      pva->pvaData[j].getData[0].nativeValues = NULL;
+      pva->pvaData[j].getData[0].valuesStale = false;
     }
   } else {
     for (j = pva->prevNumPVs; j < pva->numPVs; j++) {
-      pva->pvaData[j].getData = (PVA_DATA *)malloc(sizeof(PVA_DATA) * repeats);
+      pva->pvaData[j].getData = (PVA_DATA *)PVAArenaAlloc(pva, sizeof(PVA_DATA) * repeats);
       for (i = 0; i < repeats; i++) {
         pva->pvaData[j].getData[i].values = NULL;
         pva->pvaData[j].getData[i].stringValues = NULL;
+        pva->pvaData[j].getData[i].nativeValues = NULL;
+        pva->pvaData[j].getData[i].valuesStale = false;
       }
     }
   }
   for (j = pva->prevNumPVs; j < pva->numPVs; j++) {
-    pva->pvaData[j].putData = (PVA_DATA *)malloc(sizeof(PVA_DATA));
-    pva->pvaData[j].monitorData = (PVA_DATA *)malloc(sizeof(PVA_DATA));
+    pva->pvaData[j].putData = (PVA_DATA *)PVAArenaAlloc(pva, sizeof(PVA_DATA));
+    pva->pvaData[j].monitorData = (PVA_DATA *)PVAArenaAlloc(pva, sizeof(PVA_DATA));
     pva->pvaData[j].putData[0].values = NULL;
     pva->pvaData[j].putData[0].stringValues = NULL;
+    pva->pvaData[j].putData[0].nativeValues = NULL;
+    pva->pvaData[j].putData[0].valuesStale = false;
     pva->pvaData[j].monitorData[0].values = NULL;
     pva->pvaData[j].monitorData[0].stringValues = NULL;
+    pva->pvaData[j].monitorData[0].nativeValues = NULL;
+    pva->pvaData[j].monitorData[0].valuesStale = false;
   }
   for (j = pva->prevNumPVs; j < pva->numPVs; j++) {
     pva->pvaData[j].numGetElements = 0;
@@ -179,6 +593,20 @@ void reallocPVA(PVA_OVERALL *pva, long PVs, long repeats) {
     pva->pvaData[j].L1Ptr = j;
     pva->pvaData[j].L2Ptr = j;
     pva->pvaData[j].skip = false;
+    pva->pvaData[j].monitorQueueValues = NULL;
+    pva->pvaData[j].monitorQueueTimes = NULL;
+    pva->pvaData[j].monitorQueueHead = 0;
+    pva->pvaData[j].monitorQueueCount = 0;
+    pva->pvaData[j].monitorQueueOverflows = 0;
+    pva->pvaData[j].getLatency = -1;
+    pva->pvaData[j].putStatus = PVA_PUT_NONE;
+    pva->pvaData[j].putLatency = -1;
+    pva->pvaData[j].useNativeValues = false;
+    pva->pvaData[j].monitorExtractor = PVA_MONITOR_EXTRACT_UNRESOLVED;
+    pva->pvaData[j].monitorFieldOffset = 0;
+    pva->pvaData[j].monitorRequestQueueSize = 0;
+    pva->pvaData[j].monitorDeadband = 0;
+    pva->pvaData[j].monitorDecimation = 0;
   }
   pva->numNotConnected += pva->numPVs - pva->prevNumPVs;
 
@@ -188,44 +616,179 @@ void reallocPVA(PVA_OVERALL *pva, long PVs, long repeats) {
   pva->pvaClientGetPtr.resize(pva->numPVs);
   pva->pvaClientPutPtr.resize(pva->numPVs);
   pva->pvaClientMonitorPtr.resize(pva->numPVs);
+  pva->monitorStructure.resize(pva->numPVs);
 
   return;
 }
 
 /*
-  Free memory for the pva structure.
+  Release the reading buffers and the get, put and monitor operations of one PV.
 */
-void freePVA(PVA_OVERALL *pva) {
-  long i, j, k;
+static void FreePVAEntry(PVA_OVERALL *pva, long i) {
+  long j, k, readings;
+  PVA_DATA_ALL_READINGS *data = &(pva->pvaData[i]);
 
-  if (pva == NULL) {
-    return;
+  if (data->haveMonitorPtr && pva->pvaClientMonitorPtr[i]) {
+    pva->pvaClientMonitorPtr[i]->stop();
+  }
+  pva->pvaClientGetPtr[i].reset();
+  pva->pvaClientPutPtr[i].reset();
+  pva->pvaClientMonitorPtr[i].reset();
+  pva->monitorStructure[i].reset();
+  readings = (data->numGetReadings > 1) ? data->numGetReadings : 1;
+  for (j = 0; j < readings; j++) {
+    PVAArenaFree(pva, data->getData[j].values);
+    PVAArenaFree(pva, data->getData[j].nativeValues);
+    if (data->getData[j].stringValues) {
+      for (k = 0; k < data->numGetElements; k++) {
+        PVAArenaFree(pva, data->getData[j].stringValues[k]);
+      }
+      PVAArenaFree(pva, data->getData[j].stringValues);
+    }
+  }
+  PVAArenaFree(pva, data->getData);
+  PVAArenaFree(pva, data->monitorData[0].values);
+  PVAArenaFree(pva, data->monitorData[0].nativeValues);
+  if (data->monitorData[0].stringValues) {
+    for (k = 0; k < data->numMonitorElements; k++) {
+      PVAArenaFree(pva, data->monitorData[0].stringValues[k]);
+    }
+    PVAArenaFree(pva, data->monitorData[0].stringValues);
+  }
+  PVAArenaFree(pva, data->monitorData);
+  if (data->putData[0].values) {
+    free(data->putData[0].values);
+  }
+  if (data->putData[0].stringValues) {
+    free(data->putData[0].stringValues);
+  }
+  PVAArenaFree(pva, data->putData);
+  PVAArenaFree(pva, data->monitorQueueValues);
+  PVAArenaFree(pva, data->monitorQueueTimes);
+  PVAArenaFree(pva, data->units);
+}
+
+/*
+  Keep only the PVs listed in keep, in that order, without touching the channels or the
+  monitors of the PVs that stay. The operations and buffers of the other PVs are released.
+  Their channels stay open until the next ConnectPVA or CloseUnusedPVAChannels, so a PV
+  added back with reallocPVA and ConnectPVA in the meantime reuses the connection.
+*/
+void SelectPVA(PVA_OVERALL *pva, long *keep, long count) {
+  long i, k, num = 0;
+  std::vector<bool> kept(pva->numPVs, false);
+  PVA_DATA_ALL_READINGS *pvaData;
+  std::vector<epics::pvaClient::PvaClientGetPtr> getPtr(count);
+  std::vector<epics::pvaClient::PvaClientPutPtr> putPtr(count);
+  std::vector<epics::pvaClient::PvaClientMonitorPtr> monitorPtr(count);
+  std::vector<epics::pvData::StructureConstPtr> monitorStructure(count);
+  epics::pvData::shared_vector<std::string> names(count), provider(count), subnames(count);
+  epics::pvData::shared_vector<epics::pvData::boolean> connected(count);
+
+  for (k = 0; k < count; k++) {
+    kept[keep[k]] = true;
   }
   for (i = 0; i < pva->numPVs; i++) {
-    //get variables
-    for (j = 0; j < pva->pvaData[i].numGetReadings; j++) {
-      if (pva->pvaData[i].getData[j].values) {
-        free(pva->pvaData[i].getData[j].values);
+    if (!kept[i]) {
+      FreePVAEntry(pva, i);
+    }
+  }
+  if (pva->putCompletion) {
+    //A put still waiting for putDone can't move to another index, so it is recreated by the next PutPVAValues
+    epics::pvData::Lock guard(pva->putCompletion->mutex);
+    for (k = 0; k < count; k++) {
+      i = keep[k];
+      if ((i != k) && (i < (long)pva->putCompletion->active.size()) && pva->putCompletion->active[i]) {
+        pva->pvaClientPutPtr[i].reset();
+        pva->pvaData[i].havePutPtr = false;
       }
-      if (pva->pvaData[i].getData[j].stringValues) {
-        for (k = 0; k < pva->pvaData[i].numGetElements; k++) {
-          if (pva->pvaData[i].getData[j].stringValues[k])
-            free(pva->pvaData[i].getData[j].stringValues[k]);
-        }
-        free(pva->pvaData[i].getData[j].stringValues);
+    }
+  }
+  pvaData = (PVA_DATA_ALL_READINGS *)malloc(sizeof(PVA_DATA_ALL_READINGS) * (count > 0 ? count : 1));
+  for (k = 0; k < count; k++) {
+    i = keep[k];
+    pvaData[k] = pva->pvaData[i];
+    pvaData[k].L1Ptr = k;
+    getPtr[k] = pva->pvaClientGetPtr[i];
+    putPtr[k] = pva->pvaClientPutPtr[i];
+    monitorPtr[k] = pva->pvaClientMonitorPtr[i];
+    monitorStructure[k] = pva->monitorStructure[i];
+    names[k] = pva->pvaChannelNames[i];
+    provider[k] = pva->pvaProvider[i];
+    if (i < (long)pva->pvaChannelNamesSub.size()) {
+      subnames[k] = pva->pvaChannelNamesSub[i];
+    }
+    connected[k] = pva->isConnected[i];
+    if (!connected[k]) {
+      num++;
+    }
+  }
+  free(pva->pvaData);
+  pva->pvaData = pvaData;
+  pva->pvaClientGetPtr = getPtr;
+  pva->pvaClientPutPtr = putPtr;
+  pva->pvaClientMonitorPtr = monitorPtr;
+  pva->monitorStructure = monitorStructure;
+  pva->pvaChannelNames = freeze(names);
+  pva->pvaProvider = freeze(provider);
+  pva->pvaChannelNamesSub = freeze(subnames);
+  pva->isConnected = connected;
+  pva->numPVs = pva->prevNumPVs = count;
+  pva->numNotConnected = num;
+
+  //The completion and ready-list requesters know their PV by index
+  if (pva->putCompletion) {
+    epics::pvData::Lock guard(pva->putCompletion->mutex);
+    pva->putCompletion->requesters.resize(count);
+    pva->putCompletion->active.resize(count, false);
+    for (k = 0; k < count; k++) {
+      if (keep[k] != k) {
+        pva->putCompletion->requesters[k].reset();
+        pva->putCompletion->active[k] = false;
       }
     }
-    //monitor variables
-    if (pva->pvaData[i].monitorData[0].values) {
-      free(pva->pvaData[i].monitorData[0].values);
+  }
+  for (k = 0; k < count; k++) {
+    if (keep[k] == k) {
+      continue;
     }
-    if (pva->pvaData[i].monitorData[0].stringValues) {
-      for (k = 0; k < pva->pvaData[i].numMonitorElements; k++) {
-        if (pva->pvaData[i].monitorData[0].stringValues[k])
-          free(pva->pvaData[i].monitorData[0].stringValues[k]);
+    if (pva->pvaData[k].haveGetPtr && (pva->useGetCallbacks == false) && pva->getCompletion) {
+      SetGetCompletionRequester(pva, k);
+    }
+    if (pva->pvaData[k].havePutPtr && pva->pipelinePuts && pva->putCompletion) {
+      SetPutCompletionRequester(pva, k);
+    }
+    if (pva->pvaData[k].haveMonitorPtr && pva->monitorReadyList) {
+      SetReadyListMonitorRequester(pva, k);
+    }
+  }
+  if (pva->monitorReadyList) {
+    epics::pvData::Lock guard(pva->monitorReadyList->mutex);
+    if ((long)pva->monitorReadyList->requesters.size() > count) {
+      pva->monitorReadyList->requesters.resize(count);
+    }
+    if (pva->useMonitorReadyList) {
+      //Events that arrived before the requesters were moved may be filed under an old index, so visit every PV once
+      pva->monitorReadyList->ready.clear();
+      pva->monitorReadyList->queued.assign(count, true);
+      for (k = 0; k < count; k++) {
+        pva->monitorReadyList->ready.push_back(k);
       }
-      free(pva->pvaData[i].monitorData[0].stringValues);
     }
+  }
+}
+
+/*
+  Free memory for the pva structure.
+*/
+void freePVA(PVA_OVERALL *pva) {
+  long i;
+
+  if (pva == NULL) {
+    return;
+  }
+  //get and monitor variables are released with the arena below
+  for (i = 0; i < pva->numPVs; i++) {
     //put variables
     if (pva->pvaData[i].putData[0].values) {
       free(pva->pvaData[i].putData[0].values);
@@ -244,15 +807,14 @@ void freePVA(PVA_OVERALL *pva) {
     if (pva->pvaData[i].haveMonitorPtr == false) {
       pva->pvaClientMonitorPtr[i].reset();
     }
-
-    free(pva->pvaData[i].getData);
-    free(pva->pvaData[i].putData);
-    free(pva->pvaData[i].monitorData);
-    if (pva->pvaData[i].units) {
-      free(pva->pvaData[i].units);
-    }
   }
   free(pva->pvaData);
+  ReleasePVAArena(pva);
+  pva->monitorStructure.clear();
+  pva->monitorReadyList.reset();
+  pva->getCompletion.reset();
+  pva->putCompletion.reset();
+  pva->connectShards.reset();
 
   return;
 }
@@ -272,19 +834,23 @@ void freePVAGetReadings(PVA_OVERALL *pva) {
     for (j = 0; j < pva->pvaData[i].numGetReadings; j++) {
       if (pva->limitGetReadings == false) {
         if (pva->pvaData[i].getData[j].values) {
-          free(pva->pvaData[i].getData[j].values);
+          PVAArenaFree(pva, pva->pvaData[i].getData[j].values);
           pva->pvaData[i].getData[j].values = NULL;
         }
+        if (pva->pvaData[i].getData[j].nativeValues) {
+          PVAArenaFree(pva, pva->pvaData[i].getData[j].nativeValues);
+          pva->pvaData[i].getData[j].nativeValues = NULL;
+        }
       }
       if (pva->pvaData[i].getData[j].stringValues) {
         for (k = 0; k < pva->pvaData[i].numGetElements; k++) {
           if (pva->pvaData[i].getData[j].stringValues[k]) {
-            free(pva->pvaData[i].getData[j].stringValues[k]);
+            PVAArenaFree(pva, pva->pvaData[i].getData[j].stringValues[k]);
             pva->pvaData[i].getData[j].stringValues[k] = NULL;
           }
         }
         if (pva->limitGetReadings == false) {
-          free(pva->pvaData[i].getData[j].stringValues);
+          PVAArenaFree(pva, pva->pvaData[i].getData[j].stringValues);
           pva->pvaData[i].getData[j].stringValues = NULL;
         }
       }
@@ -309,15 +875,19 @@ void freePVAMonitorReadings(PVA_OVERALL *pva) {
       continue;
     }
     if (pva->pvaData[i].monitorData[0].values) {
-      free(pva->pvaData[i].monitorData[0].values);
+      PVAArenaFree(pva, pva->pvaData[i].monitorData[0].values);
       pva->pvaData[i].monitorData[0].values = NULL;
     }
+    if (pva->pvaData[i].monitorData[0].nativeValues) {
+      PVAArenaFree(pva, pva->pvaData[i].monitorData[0].nativeValues);
+      pva->pvaData[i].monitorData[0].nativeValues = NULL;
+    }
     if (pva->pvaData[i].monitorData[0].stringValues) {
       for (k = 0; k < pva->pvaData[i].numMonitorElements; k++) {
         if (pva->pvaData[i].monitorData[0].stringValues[k])
-          free(pva->pvaData[i].monitorData[0].stringValues[k]);
+          PVAArenaFree(pva, pva->pvaData[i].monitorData[0].stringValues[k]);
       }
-      free(pva->pvaData[i].monitorData[0].stringValues);
+      PVAArenaFree(pva, pva->pvaData[i].monitorData[0].stringValues);
       pva->pvaData[i].monitorData[0].stringValues = NULL;
     }
     pva->pvaData[i].numMonitorReadings = 0;
@@ -325,21 +895,335 @@ void freePVAMonitorReadings(PVA_OVERALL *pva) {
   return;
 }
 
+/*
+  Wait for the connect threads of the shards that were still connecting when ConnectPVA returned.
+*/
+PVA_CONNECT_SHARDS::~PVA_CONNECT_SHARDS() {
+  for (size_t t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+}
+
+/*
+  False while shard m is still connecting in the background. The PvaClientMultiChannel of
+  such a shard belongs to its connect thread and is not touched until it is ready.
+*/
+static bool PVAShardReady(PVA_OVERALL *pva, long m) {
+  if (!pva->connectShards || (m >= pva->numShards)) {
+    return (true);
+  }
+  epics::pvData::Lock guard(pva->connectShards->mutex);
+  return (pva->connectShards->ready[m]);
+}
+
+/*
+  True once after a background shard has finished connecting.
+*/
+static bool PVAShardsChanged(PVA_OVERALL *pva) {
+  bool changed;
+  if (!pva->connectShards) {
+    return (false);
+  }
+  epics::pvData::Lock guard(pva->connectShards->mutex);
+  changed = pva->connectShards->changed;
+  pva->connectShards->changed = false;
+  return (changed);
+}
+
+/*
+  Gather the connection state and channels of every PvaClientMultiChannel in order. The
+  channels of a shard that is still connecting count as not connected and are left empty.
+*/
+static void CollectPVAChannels(PVA_OVERALL *pva, epics::pvaClient::PvaClientChannelArray &channels) {
+  for (long m = 0; m < pva->numMultiChannels; m++) {
+    epics::pvData::shared_vector<epics::pvData::boolean> isConnected;
+    epics::pvaClient::PvaClientChannelArray channelsAdd;
+    if (PVAShardReady(pva, m)) {
+      isConnected = pva->pvaClientMultiChannelPtr[m]->getIsConnected();
+      channelsAdd = pva->pvaClientMultiChannelPtr[m]->getPvaClientChannelArray();
+    } else {
+      long count = pva->connectShards->start[m + 1] - pva->connectShards->start[m];
+      isConnected = epics::pvData::shared_vector<epics::pvData::boolean>(count, false);
+      channelsAdd.resize(count);
+    }
+    if (m == 0) {
+      pva->isInternalConnected = isConnected;
+      channels = channelsAdd;
+    } else {
+      std::copy(isConnected.begin(), isConnected.end(), std::back_inserter(pva->isInternalConnected));
+      std::copy(channelsAdd.begin(), channelsAdd.end(), std::back_inserter(channels));
+    }
+  }
+}
+
+/*
+  Find the channel of a PV when the channels are spread over several PvaClientMultiChannels.
+*/
+static epics::pvaClient::PvaClientChannelPtr GetPVAChannel(PVA_OVERALL *pva, long index) {
+  long k = pva->pvaData[index].L2Ptr, size;
+  for (long m = 0; m < pva->numMultiChannels; m++) {
+    if (!PVAShardReady(pva, m)) {
+      size = pva->connectShards->start[m + 1] - pva->connectShards->start[m];
+      if (k < size) {
+        return epics::pvaClient::PvaClientChannelPtr();
+      }
+      k -= size;
+      continue;
+    }
+    epics::pvaClient::PvaClientChannelArray channels = pva->pvaClientMultiChannelPtr[m]->getPvaClientChannelArray();
+    if (k < (long)channels.size()) {
+      return channels[k];
+    }
+    k -= channels.size();
+  }
+  return epics::pvaClient::PvaClientChannelPtr();
+}
+
+/*
+  Split the channels into shards of about PVA_CONNECT_SHARD_SIZE, give each its own
+  PvaClientMultiChannel, and connect them on connectThreads threads. With connectInBackground
+  this returns as soon as connectThreads shards are ready, and the other shards keep
+  connecting on the threads; later GetPVAValues and PollMonitoredPVA calls pick up each
+  shard once it is ready. Otherwise it returns when every shard is done. Channels that are
+  still unconnected when their shard times out keep connecting in the background as well.
+  shardStart and shardTime are filled in with the first channel of each shard and the
+  seconds the shards that are done took (-1 for the others).
+*/
+static void ConnectPVAShards(PVA_OVERALL *pva, epics::pvData::shared_vector<const std::string> const &names,
+                             epics::pvData::shared_vector<const std::string> const &provider, double pendIOTime,
+                             std::vector<long> &shardStart, std::vector<double> &shardTime) {
+  long numInternalPVs = names.size();
+  long shards, numThreads, wanted;
+  double start;
+  bool report = pva->reportConnectProgress;
+  bool useStateChangeCallbacks = pva->useStateChangeCallbacks;
+  epics::pvaClient::PvaClientChannelStateChangeRequesterPtr stateChangeReqPtr = pva->stateChangeReqPtr;
+  PVA_CONNECT_SHARDS *state;
+
+  shards = (numInternalPVs + PVA_CONNECT_SHARD_SIZE - 1) / PVA_CONNECT_SHARD_SIZE;
+  if (shards < pva->connectThreads) {
+    shards = pva->connectThreads;
+  }
+  if (shards > numInternalPVs) {
+    shards = numInternalPVs;
+  }
+  numThreads = (pva->connectThreads < shards) ? pva->connectThreads : shards;
+  pva->numShards = pva->numMultiChannels = shards;
+  pva->pvaClientMultiChannelPtr.resize(shards);
+  pva->connectShards.reset(new PVA_CONNECT_SHARDS);
+  state = pva->connectShards.get();
+  state->start.resize(shards + 1);
+  state->time.assign(shards, -1);
+  state->ready.assign(shards, false);
+  state->changed = false;
+  state->nextShard = state->shardsDone = state->channelsConnected = 0;
+  for (long m = 0; m <= shards; m++) {
+    state->start[m] = m * numInternalPVs / shards;
+  }
+  for (long m = 0; m < shards; m++) {
+    long count = state->start[m + 1] - state->start[m];
+    epics::pvData::shared_vector<std::string> shardNames(count);
+    epics::pvData::shared_vector<std::string> shardProvider(count);
+    std::copy(names.begin() + state->start[m], names.begin() + state->start[m + 1], shardNames.begin());
+    std::copy(provider.begin() + state->start[m], provider.begin() + state->start[m + 1], shardProvider.begin());
+    pva->pvaClientMultiChannelPtr[m] = epics::pvaClient::PvaClientMultiChannel::create(pva->pvaClientPtr, freeze(shardNames), "pva", count, freeze(shardProvider));
+  }
+  //The threads work on their own copy, reallocPVA may grow pvaClientMultiChannelPtr meanwhile
+  state->multiChannels = pva->pvaClientMultiChannelPtr;
+
+  start = MonotonicSeconds();
+  for (long t = 0; t < numThreads; t++) {
+    state->threads.push_back(std::thread([=]() {
+      while (1) {
+        long m, connected = 0;
+        {
+          epics::pvData::Lock guard(state->mutex);
+          if (state->nextShard >= shards) {
+            return;
+          }
+          m = state->nextShard++;
+        }
+        state->multiChannels[m]->connect(pendIOTime);
+        epics::pvData::shared_vector<epics::pvData::boolean> isConnected = state->multiChannels[m]->getIsConnected();
+        for (size_t k = 0; k < isConnected.size(); k++) {
+          if (isConnected[k]) {
+            connected++;
+          }
+        }
+        if (useStateChangeCallbacks) {
+          epics::pvaClient::PvaClientChannelArray channels = state->multiChannels[m]->getPvaClientChannelArray();
+          for (size_t k = 0; k < channels.size(); k++) {
+            channels[k]->setStateChangeRequester(stateChangeReqPtr);
+          }
+        }
+        {
+          epics::pvData::Lock guard(state->mutex);
+          state->time[m] = MonotonicSeconds() - start;
+          state->channelsConnected += connected;
+          state->shardsDone++;
+          state->ready[m] = true;
+          state->changed = true;
+          if (report) {
+            fprintf(stdout, "Connected %ld of %ld channels (%ld of %ld shards done, %.1f seconds)\n",
+                    state->channelsConnected, numInternalPVs, state->shardsDone, shards, MonotonicSeconds() - start);
+            fflush(stdout);
+          }
+        }
+        state->event.signal();
+      }
+    }));
+  }
+  wanted = pva->connectInBackground ? numThreads : shards;
+  while (1) {
+    {
+      epics::pvData::Lock guard(state->mutex);
+      if (state->shardsDone >= wanted) {
+        shardStart = state->start;
+        shardTime = state->time;
+        break;
+      }
+    }
+    state->event.wait();
+  }
+  if (std::find(shardTime.begin(), shardTime.end(), -1) == shardTime.end()) {
+    //Nothing is left in the background
+    pva->connectShards.reset();
+  }
+}
+
+/*
+  Fill in pva->connectStats from the time each channel was seen connected.
+*/
+static void ComputeConnectStats(PVA_OVERALL *pva, long firstInternal, std::vector<long> &shardStart,
+                                std::vector<double> &shardTime, double elapsed) {
+  std::vector<double> times;
+  long numInternalPVs = pva->isInternalConnected.size() - firstInternal;
+  size_t m = 0;
+
+  for (long k = 0; k < numInternalPVs; k++) {
+    if (pva->isInternalConnected[firstInternal + k] == false) {
+      continue;
+    }
+    if (shardTime.empty()) {
+      times.push_back(elapsed);
+    } else {
+      while ((m + 1 < shardTime.size()) && (k >= shardStart[m + 1])) {
+        m++;
+      }
+      times.push_back(shardTime[m]);
+    }
+  }
+  std::sort(times.begin(), times.end());
+  pva->connectStats.channels = numInternalPVs;
+  pva->connectStats.connected = times.size();
+  pva->connectStats.elapsed = elapsed;
+  if (times.empty()) {
+    pva->connectStats.p50 = pva->connectStats.p90 = pva->connectStats.p99 = pva->connectStats.max = -1;
+  } else {
+    pva->connectStats.p50 = times[(times.size() - 1) * 50 / 100];
+    pva->connectStats.p90 = times[(times.size() - 1) * 90 / 100];
+    pva->connectStats.p99 = times[(times.size() - 1) * 99 / 100];
+    pva->connectStats.max = times.back();
+  }
+}
+
+/*
+  Append the dbnd and dec channel filters requested for a PV to its channel name
+*/
+static std::string AddPVAChannelFilters(const std::string &name, PVA_DATA_ALL_READINGS *data) {
+  std::string filters;
+  char buffer[100];
+
+  if (data->monitorDeadband > 0) {
+    snprintf(buffer, sizeof(buffer), "\"dbnd\":{\"abs\":%.15g}", data->monitorDeadband);
+    filters = buffer;
+  }
+  if (data->monitorDecimation > 1) {
+    snprintf(buffer, sizeof(buffer), "\"dec\":{\"n\":%ld}", data->monitorDecimation);
+    if (filters.length() > 0) {
+      filters += ",";
+    }
+    filters += buffer;
+  }
+  if (filters.length() == 0) {
+    return name;
+  }
+  //The filters follow the field name, which is empty (VAL) when the name has no dot
+  if (name.find('.') == std::string::npos) {
+    return name + ".{" + filters + "}";
+  }
+  return name + "{" + filters + "}";
+}
+
+/*
+  Close the channels that no PV uses any more, such as those of the PVs dropped by SelectPVA.
+  Their names are cleared so ConnectPVA gives a PV added later a new channel.
+*/
+void CloseUnusedPVAChannels(PVA_OVERALL *pva) {
+  long j, k;
+  epics::pvaClient::PvaClientChannelArray channels;
+  std::vector<bool> used(pva->pvaChannelNamesTop.size(), false);
+  epics::pvData::shared_vector<std::string> names(pva->pvaChannelNamesTop.size());
+  bool closed = false;
+
+  for (j = 0; j < pva->numPVs; j++) {
+    if (pva->pvaData[j].L2Ptr < (long)used.size()) {
+      used[pva->pvaData[j].L2Ptr] = true;
+    }
+  }
+  CollectPVAChannels(pva, channels);
+  std::copy(pva->pvaChannelNamesTop.begin(), pva->pvaChannelNamesTop.end(), names.begin());
+  for (k = 0; k < (long)names.size(); k++) {
+    if (used[k] || (names[k].length() == 0) || (k >= (long)channels.size()) || !channels[k]) {
+      //A channel of a shard that is still connecting is closed by a later call
+      continue;
+    }
+    if (channels[k]->getChannel()) {
+      channels[k]->getChannel()->destroy();
+    }
+    names[k] = "";
+    closed = true;
+  }
+  if (closed) {
+    pva->pvaChannelNamesTop = freeze(names);
+    CollectPVAChannels(pva, channels);
+  }
+}
+
 /*
   Connect to the PVs using PvaClientMultiChannel
 */
 void ConnectPVA(PVA_OVERALL *pva, double pendIOTime) {
-  long i, j, n, num = 0, numInternalPVs;
+  long i, j, k, n, num = 0, numInternalPVs;
   size_t pos;
   epics::pvData::shared_vector<std::string> namesTmp(pva->numPVs);
   epics::pvData::shared_vector<std::string> subnames(pva->numPVs);
   epics::pvData::Status status;
   epics::pvaClient::PvaClientChannelArray pvaClientChannelArray;
   epics::pvData::shared_vector<epics::pvData::boolean> connected(pva->numPVs);
-  Mymap m;
+  Mymap m, previous;
   MymapIterator mIter;
+  std::vector<long> shardStart;
+  std::vector<double> shardTime;
+  double start = MonotonicSeconds();
 
+  if (pva->putTimeout <= 0) {
+    pva->putTimeout = pendIOTime;
+  }
+  if (pva->getTimeout <= 0) {
+    pva->getTimeout = pendIOTime;
+  }
   i = n = 0;
+  if (pva->numMultiChannels > pva->numShards) {
+    //Adding PVs. The PVs already present keep their channels and new channels are numbered after them.
+    i = pva->numInternalPVs;
+    //Channels left open by SelectPVA can be taken over by the new PVs
+    for (k = 0; k < (long)pva->pvaChannelNamesTop.size(); k++) {
+      if (pva->pvaChannelNamesTop[k].length() > 0) {
+        previous.insert(Mymap::value_type(pva->pvaChannelNamesTop[k], k));
+      }
+    }
+  }
   for (j = 0; j < pva->numPVs; j++) {
     if (pva->pvaProvider[j].compare("pva") == 0) {
       pos = pva->pvaChannelNames[j].find('.');
@@ -360,19 +1244,38 @@ void ConnectPVA(PVA_OVERALL *pva, double pendIOTime) {
       namesTmp[j] = pva->pvaChannelNames[j];
       subnames[j] = "";
     }
+    namesTmp[j] = AddPVAChannelFilters(namesTmp[j], &(pva->pvaData[j]));
     mIter = m.find(namesTmp[j]);
-    if (mIter == m.end()) {
+    if ((pva->numMultiChannels > pva->numShards) && (j < pva->prevNumPVs)) {
+      if (mIter == m.end()) {
+        m.insert(Mymap::value_type(namesTmp[j], j));
+      }
+    } else if (mIter == m.end()) {
       m.insert(Mymap::value_type(namesTmp[j], j));
       pva->pvaData[j].L1Ptr = j;
-      pva->pvaData[j].L2Ptr = i;
-      i++;
+      mIter = previous.find(namesTmp[j]);
+      if (mIter != previous.end()) {
+        pva->pvaData[j].L2Ptr = mIter->second;
+      } else {
+        pva->pvaData[j].L2Ptr = i;
+        i++;
+      }
     } else {
       pva->pvaData[j].L1Ptr = mIter->second;
       pva->pvaData[j].L2Ptr = pva->pvaData[pva->pvaData[j].L1Ptr].L2Ptr;
+      if (mIter->second < pva->prevNumPVs) {
+        //The get shared by the PVs of this channel has to ask for the new field as well
+        for (k = 0; k < pva->prevNumPVs; k++) {
+          if (pva->pvaData[k].L2Ptr == pva->pvaData[j].L2Ptr) {
+            pva->pvaClientGetPtr[k].reset();
+            pva->pvaData[k].haveGetPtr = false;
+          }
+        }
+      }
     }
   }
 
-  if (pva->numMultiChannels == 1) {
+  if (pva->numMultiChannels == pva->numShards) {
     pva->numInternalPVs = numInternalPVs = i;
     epics::pvData::shared_vector<std::string> names(pva->numInternalPVs);
     epics::pvData::shared_vector<std::string> provider(pva->numInternalPVs);
@@ -385,15 +1288,19 @@ void ConnectPVA(PVA_OVERALL *pva, double pendIOTime) {
     pva->pvaChannelNamesTop = freeze(names);
     pva->pvaChannelNamesSub = freeze(subnames);
     constProvider = freeze(provider);
-    //Connect to PVs all at once
     pva->pvaClientPtr = epics::pvaClient::PvaClient::get("pva ca");
     //pva->pvaClientPtr->setDebug(true);
-    pva->pvaClientMultiChannelPtr[0] = epics::pvaClient::PvaClientMultiChannel::create(pva->pvaClientPtr, pva->pvaChannelNamesTop, "pva", numInternalPVs, constProvider);
-    status = pva->pvaClientMultiChannelPtr[0]->connect(pendIOTime);
-
-    pva->isInternalConnected = pva->pvaClientMultiChannelPtr[0]->getIsConnected();
+    if ((pva->connectThreads > 1) && (numInternalPVs > 1)) {
+      //Connect to PVs in shards on several threads
+      ConnectPVAShards(pva, pva->pvaChannelNamesTop, constProvider, pendIOTime, shardStart, shardTime);
+    } else {
+      //Connect to PVs all at once
+      pva->pvaClientMultiChannelPtr[0] = epics::pvaClient::PvaClientMultiChannel::create(pva->pvaClientPtr, pva->pvaChannelNamesTop, "pva", numInternalPVs, constProvider);
+      status = pva->pvaClientMultiChannelPtr[0]->connect(pendIOTime);
+    }
 
-    pvaClientChannelArray = pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray();
+    CollectPVAChannels(pva, pvaClientChannelArray);
+    ComputeConnectStats(pva, 0, shardStart, shardTime, MonotonicSeconds() - start);
   } else {
     //This will execute if we are adding additional PVs. It is sort of a hack
     pva->prevNumInternalPVs = pva->numInternalPVs;
@@ -406,6 +1313,8 @@ void ConnectPVA(PVA_OVERALL *pva, double pendIOTime) {
     
     epics::pvData::shared_vector<const std::string> constProvider;
     
+    //Channels whose PVs were dropped by SelectPVA keep their names
+    std::copy(pva->pvaChannelNamesTop.begin(), pva->pvaChannelNamesTop.end(), names.begin());
     for (j = 0; j < pva->numPVs; j++) {
       names[pva->pvaData[j].L2Ptr] = namesTmp[j];
       if (pva->pvaData[j].L2Ptr >= pva->prevNumInternalPVs) {
@@ -418,16 +1327,22 @@ void ConnectPVA(PVA_OVERALL *pva, double pendIOTime) {
     constNames = freeze(newnames);
     constProvider = freeze(provider);
 
-    pva->pvaClientMultiChannelPtr[pva->numMultiChannels - 1] = epics::pvaClient::PvaClientMultiChannel::create(pva->pvaClientPtr, constNames, "pva", numInternalPVs, constProvider);
-    status = pva->pvaClientMultiChannelPtr[pva->numMultiChannels - 1]->connect(pendIOTime);
+    if (numInternalPVs == 0) {
+      //Every new PV uses a channel that is already open
+      pva->numMultiChannels--;
+      pva->pvaClientMultiChannelPtr.resize(pva->numMultiChannels);
+    } else {
+      pva->pvaClientMultiChannelPtr[pva->numMultiChannels - 1] = epics::pvaClient::PvaClientMultiChannel::create(pva->pvaClientPtr, constNames, "pva", numInternalPVs, constProvider);
+      status = pva->pvaClientMultiChannelPtr[pva->numMultiChannels - 1]->connect(pendIOTime);
+      pvaClientChannelArray = pva->pvaClientMultiChannelPtr[pva->numMultiChannels - 1]->getPvaClientChannelArray();
+    }
 
-    pva->isInternalConnected = pva->pvaClientMultiChannelPtr[0]->getIsConnected();
-    for (j = 1; j < pva->numMultiChannels; j++) {
-      epics::pvData::shared_vector<epics::pvData::boolean> isConnected;
-      isConnected = pva->pvaClientMultiChannelPtr[j]->getIsConnected();
-      std::copy(isConnected.begin(), isConnected.end(), std::back_inserter(pva->isInternalConnected));
+    {
+      epics::pvaClient::PvaClientChannelArray channels;
+      CollectPVAChannels(pva, channels);
     }
-    pvaClientChannelArray = pva->pvaClientMultiChannelPtr[pva->numMultiChannels - 1]->getPvaClientChannelArray();
+    ComputeConnectStats(pva, pva->prevNumInternalPVs, shardStart, shardTime, MonotonicSeconds() - start);
+    CloseUnusedPVAChannels(pva);
   }
 
   for (j = 0; j < pva->numPVs; j++) {
@@ -439,7 +1354,8 @@ void ConnectPVA(PVA_OVERALL *pva, double pendIOTime) {
   pva->isConnected = connected;
   pva->numNotConnected = num;
   for (j = 0; j < numInternalPVs; j++) {
-    if (pva->useStateChangeCallbacks) {
+    //The connect threads set it on the shards that are still connecting
+    if (pva->useStateChangeCallbacks && pvaClientChannelArray[j]) {
       pvaClientChannelArray[j]->setStateChangeRequester((epics::pvaClient::PvaClientChannelStateChangeRequesterPtr)pva->stateChangeReqPtr);
     }
   }
@@ -465,16 +1381,7 @@ long GetPVAValuesOld(PVA_OVERALL **pva, long count) {
 
   for (n = 0; n < count; n++) {
     if (pva[n] != NULL) {
-      pva[n]->isInternalConnected = pva[n]->pvaClientMultiChannelPtr[0]->getIsConnected();
-      pvaClientChannelArray = pva[n]->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray();
-      for (i = 1; i < pva[n]->numMultiChannels; i++) {
-        epics::pvData::shared_vector<epics::pvData::boolean> isConnected;
-        epics::pvaClient::PvaClientChannelArray pvaClientChannelArrayAdd;
-        isConnected = pva[n]->pvaClientMultiChannelPtr[i]->getIsConnected();
-        std::copy(isConnected.begin(), isConnected.end(), std::back_inserter(pva[n]->isInternalConnected));
-        pvaClientChannelArrayAdd = pva[n]->pvaClientMultiChannelPtr[i]->getPvaClientChannelArray();
-        std::copy(pvaClientChannelArrayAdd.begin(), pvaClientChannelArrayAdd.end(), std::back_inserter(pvaClientChannelArray));
-      }
+      CollectPVAChannels(pva[n], pvaClientChannelArray);
       for (i = 0; i < pva[n]->numPVs; i++) {
         if (pva[n]->pvaData[i].skip == true) {
           continue;
@@ -524,9 +1431,11 @@ long GetPVAValuesOld(PVA_OVERALL **pva, long count) {
   }
   for (n = 0; n < count; n++) {
     if ((pva[n] != NULL) && (pva[n]->useGetCallbacks == false)) {
+      double start = MonotonicSeconds();
       if (ExtractPVAValues(pva[n]) == 1) {
         return (1);
       }
+      pva[n]->extractTime += MonotonicSeconds() - start;
     }
   }
   return (0);
@@ -575,26 +1484,32 @@ std::string convertToProperRequestFormat(const std::vector<std::string>& input)
 }
 
 long GetPVAValues(PVA_OVERALL **pva, long count) {
-  long i, ii, n;
+  long i, ii, n, pending;
+  double wait;
   epics::pvData::Status status;
   epics::pvaClient::PvaClientChannelArray pvaClientChannelArray;
   std::ostringstream pvaFields;
+  std::vector<double> issueTime(count, 0);
+  std::vector<std::vector<long> > getOwner(count);
 
   for (n = 0; n < count; n++) {
     if (pva[n] != NULL) {
       long numNotConnected = 0;
       std::vector<bool> isInternalGetIssued(pva[n]->numInternalPVs, false);
       std::vector<long> InternalGetIndex(pva[n]->numInternalPVs, 0);
-      pva[n]->isInternalConnected = pva[n]->pvaClientMultiChannelPtr[0]->getIsConnected();
-      pvaClientChannelArray = pva[n]->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray();
-      for (i = 1; i < pva[n]->numMultiChannels; i++) {
-        epics::pvData::shared_vector<epics::pvData::boolean> isConnected;
-        epics::pvaClient::PvaClientChannelArray pvaClientChannelArrayAdd;
-        isConnected = pva[n]->pvaClientMultiChannelPtr[i]->getIsConnected();
-        std::copy(isConnected.begin(), isConnected.end(), std::back_inserter(pva[n]->isInternalConnected));
-        pvaClientChannelArrayAdd = pva[n]->pvaClientMultiChannelPtr[i]->getPvaClientChannelArray();
-        std::copy(pvaClientChannelArrayAdd.begin(), pvaClientChannelArrayAdd.end(), std::back_inserter(pvaClientChannelArray));
+      getOwner[n].assign(pva[n]->numPVs, -1);
+      if (pva[n]->useGetCallbacks == false) {
+        if (!pva[n]->getCompletion) {
+          pva[n]->getCompletion.reset(new PVA_GET_COMPLETION);
+        }
+        epics::pvData::Lock guard(pva[n]->getCompletion->mutex);
+        pva[n]->getCompletion->done.assign(pva[n]->numPVs, false);
+        pva[n]->getCompletion->doneTime.assign(pva[n]->numPVs, 0);
+        pva[n]->getCompletion->active.assign(pva[n]->numPVs, false);
+        pva[n]->getCompletion->pending = 0;
       }
+      CollectPVAChannels(pva[n], pvaClientChannelArray);
+      issueTime[n] = MonotonicSeconds();
       for (i = 0; i < pva[n]->numPVs; i++) {
         if (pva[n]->pvaData[i].skip == true) {
           continue;
@@ -608,6 +1523,8 @@ long GetPVAValues(PVA_OVERALL **pva, long count) {
               pva[n]->pvaData[i].haveGetPtr = true;
               if (pva[n]->useGetCallbacks) {
                 pva[n]->pvaClientGetPtr[i]->setRequester((epics::pvaClient::PvaClientGetRequesterPtr)pva[n]->getReqPtr);
+              } else {
+                SetGetCompletionRequester(pva[n], i);
               }
             }
           } else {
@@ -632,10 +1549,13 @@ long GetPVAValues(PVA_OVERALL **pva, long count) {
                 if (pva[n]->useGetCallbacks) {
                   // This need to be tested now that we are sharing a get requests for a single PVA PV
                   pva[n]->pvaClientGetPtr[i]->setRequester((epics::pvaClient::PvaClientGetRequesterPtr)pva[n]->getReqPtr);
+                } else {
+                  SetGetCompletionRequester(pva[n], i);
                 }
               } else {
                 //pva[n]->pvaData[i].haveGetPtr = false;
                 pva[n]->pvaClientGetPtr[i] = pva[n]->pvaClientGetPtr[InternalGetIndex[pva[n]->pvaData[i].L2Ptr]];
+                getOwner[n][i] = InternalGetIndex[pva[n]->pvaData[i].L2Ptr];
               }
             } else {
               //If we call GetPVAValues a second time, this is needed
@@ -646,11 +1566,23 @@ long GetPVAValues(PVA_OVERALL **pva, long count) {
           }
             
           if (pva[n]->pvaData[i].haveGetPtr) {
+            if (pva[n]->useGetCallbacks == false) {
+              epics::pvData::Lock guard(pva[n]->getCompletion->mutex);
+              pva[n]->getCompletion->active[i] = true;
+              pva[n]->getCompletion->pending++;
+            }
             try {
               pva[n]->pvaClientGetPtr[i]->issueGet();
             } catch (std::exception &e) {
               numNotConnected++;
               pva[n]->isConnected[i] = false;
+              if (pva[n]->useGetCallbacks == false) {
+                epics::pvData::Lock guard(pva[n]->getCompletion->mutex);
+                if (pva[n]->getCompletion->active[i]) {
+                  pva[n]->getCompletion->active[i] = false;
+                  pva[n]->getCompletion->pending--;
+                }
+              }
             }
           }
         } else {
@@ -661,29 +1593,104 @@ long GetPVAValues(PVA_OVERALL **pva, long count) {
       pva[n]->numNotConnected = numNotConnected;
     }
   }
+
+  /*
+    Wait for all outstanding gets at once. Each PVA_OVERALL gets a single deadline measured
+    from when its gets were issued, so one unresponsive IOC does not delay the others.
+  */
   for (n = 0; n < count; n++) {
     if ((pva[n] != NULL) && (pva[n]->useGetCallbacks == false)) {
       for (i = 0; i < pva[n]->numPVs; i++) {
-        if (pva[n]->pvaData[i].skip == true) {
+        if (pva[n]->pvaData[i].skip == false) {
+          pva[n]->pvaData[i].getLatency = -1;
+        }
+      }
+    }
+  }
+  for (n = 0; n < count; n++) {
+    if ((pva[n] == NULL) || (pva[n]->useGetCallbacks)) {
+      continue;
+    }
+    //The requesters count down pending and signal the event of this PVA_OVERALL only
+    while (1) {
+      {
+        epics::pvData::Lock guard(pva[n]->getCompletion->mutex);
+        pending = pva[n]->getCompletion->pending;
+      }
+      if (pending <= 0) {
+        break;
+      }
+      if (pva[n]->getTimeout <= 0) {
+        pva[n]->getCompletion->event.wait();
+        continue;
+      }
+      wait = issueTime[n] + pva[n]->getTimeout - MonotonicSeconds();
+      if (wait <= 0) {
+        break;
+      }
+      pva[n]->getCompletion->event.wait(wait);
+    }
+    for (i = 0; i < pva[n]->numPVs; i++) {
+      if ((pva[n]->pvaData[i].skip == true) || (pva[n]->isConnected[i] == false) ||
+          (pva[n]->pvaData[i].haveGetPtr == false)) {
+        continue;
+      }
+      bool done;
+      double doneTime;
+      {
+        epics::pvData::Lock guard(pva[n]->getCompletion->mutex);
+        done = pva[n]->getCompletion->done[i];
+        doneTime = pva[n]->getCompletion->doneTime[i];
+      }
+      if (done) {
+        //The get has completed so waitGet returns immediately with its status
+        status = pva[n]->pvaClientGetPtr[i]->waitGet();
+        if (!status.isSuccess()) {
+          fprintf(stderr, "error: %s did not respond to the \"get\" request\n", pva[n]->pvaChannelNames[i].c_str());
+          pva[n]->isConnected[i] = false;
+          pva[n]->numNotConnected++;
+        } else {
+          pva[n]->pvaData[i].getLatency = doneTime - issueTime[n];
+        }
+      } else {
+        fprintf(stderr, "error: %s did not respond to the \"get\" request\n", pva[n]->pvaChannelNames[i].c_str());
+        pva[n]->isConnected[i] = false;
+        pva[n]->numNotConnected++;
+        //The get is still outstanding and issueGet would throw, so the next call creates a new one
+        pva[n]->pvaClientGetPtr[i].reset();
+        pva[n]->pvaData[i].haveGetPtr = false;
+        epics::pvData::Lock guard(pva[n]->getCompletion->mutex);
+        pva[n]->getCompletion->requesters[i].reset();
+        if (pva[n]->getCompletion->active[i]) {
+          pva[n]->getCompletion->active[i] = false;
+          pva[n]->getCompletion->pending--;
+        }
+      }
+    }
+  }
+  //PVs sharing another PV's get request take on its result
+  for (n = 0; n < count; n++) {
+    if ((pva[n] != NULL) && (pva[n]->useGetCallbacks == false)) {
+      for (i = 0; i < pva[n]->numPVs; i++) {
+        ii = getOwner[n][i];
+        if ((ii < 0) || (pva[n]->pvaData[i].skip == true) || (pva[n]->isConnected[i] == false)) {
           continue;
         }
-        if (pva[n]->isConnected[i] && pva[n]->pvaData[i].haveGetPtr) {
-          status = pva[n]->pvaClientGetPtr[i]->waitGet();
-          if (!status.isSuccess()) {
-            fprintf(stderr, "error: %s did not respond to the \"get\" request\n", pva[n]->pvaChannelNames[i].c_str());
-            pva[n]->isConnected[i] = false;
-            pva[n]->numNotConnected++;
-            //return (1);
-          }
+        pva[n]->pvaData[i].getLatency = pva[n]->pvaData[ii].getLatency;
+        if (pva[n]->isConnected[ii] == false) {
+          pva[n]->isConnected[i] = false;
+          pva[n]->numNotConnected++;
         }
       }
     }
   }
   for (n = 0; n < count; n++) {
     if ((pva[n] != NULL) && (pva[n]->useGetCallbacks == false)) {
+      double start = MonotonicSeconds();
       if (ExtractPVAValues(pva[n]) == 1) {
         return (1);
       }
+      pva[n]->extractTime += MonotonicSeconds() - start;
     }
   }
   return (0);
@@ -702,11 +1709,6 @@ long ExtractScalarValue(PVA_OVERALL *pva, long index, epics::pvData::PVFieldPtr
       pva->pvaData[index].fieldType = scalarConstPtr->getType(); //should always be epics::pvData::scalar
       pva->pvaData[index].scalarType = scalarConstPtr->getScalarType();
       pva->pvaData[index].numMonitorElements = 1;
-    } else {
-      if (pva->pvaData[index].nonnumeric) {
-        if (pva->pvaData[index].monitorData[0].stringValues[0])
-          free(pva->pvaData[index].monitorData[0].stringValues[0]);
-      }
     }
   } else {
     i = pva->pvaData[index].numGetReadings;
@@ -731,13 +1733,13 @@ long ExtractScalarValue(PVA_OVERALL *pva, long index, epics::pvData::PVFieldPtr
   case epics::pvData::pvUByte: {
     if (monitorMode) {
       if (pva->pvaData[index].monitorData[0].values == NULL) {
-        pva->pvaData[index].monitorData[0].values = (double *)malloc(sizeof(double));
+        pva->pvaData[index].monitorData[0].values = (double *)PVAArenaAlloc(pva, sizeof(double));
         pva->pvaData[index].numeric = true;
       }
       pva->pvaData[index].monitorData[0].values[0] = pvScalarPtr->getAs<double>();
     } else {
       if (pva->pvaData[index].getData[i].values == NULL) {
-        pva->pvaData[index].getData[i].values = (double *)malloc(sizeof(double));
+        pva->pvaData[index].getData[i].values = (double *)PVAArenaAlloc(pva, sizeof(double));
         pva->pvaData[index].numeric = true;
       }
       pva->pvaData[index].getData[i].values[0] = pvScalarPtr->getAs<double>();
@@ -749,19 +1751,17 @@ long ExtractScalarValue(PVA_OVERALL *pva, long index, epics::pvData::PVFieldPtr
     std::string s = pvScalarPtr->getAs<std::string>();
     if (monitorMode) {
       if (pva->pvaData[index].monitorData[0].stringValues == NULL) {
-        pva->pvaData[index].monitorData[0].stringValues = (char **)malloc(sizeof(char *) * 1);
+        pva->pvaData[index].monitorData[0].stringValues = PVAArenaStringArray(pva, 1);
       }
-      pva->pvaData[index].monitorData[0].stringValues[0] = (char *)malloc(sizeof(char) * (s.length() + 1));
-      strcpy(pva->pvaData[index].monitorData[0].stringValues[0], s.c_str());
+      pva->pvaData[index].monitorData[0].stringValues[0] = PVAArenaStrcpy(pva, pva->pvaData[index].monitorData[0].stringValues[0], s.c_str(), s.length());
       if (pva->pvaData[index].numMonitorReadings == 0) {
         pva->pvaData[index].nonnumeric = true;
       }
     } else {
       if (pva->pvaData[index].getData[i].stringValues == NULL) {
-        pva->pvaData[index].getData[i].stringValues = (char **)malloc(sizeof(char *) * 1);
+        pva->pvaData[index].getData[i].stringValues = PVAArenaStringArray(pva, 1);
       }
-      pva->pvaData[index].getData[i].stringValues[0] = (char *)malloc(sizeof(char) * (s.length() + 1));
-      strcpy(pva->pvaData[index].getData[i].stringValues[0], s.c_str());
+      pva->pvaData[index].getData[i].stringValues[0] = PVAArenaStrcpy(pva, pva->pvaData[index].getData[i].stringValues[0], s.c_str(), s.length());
       if (pva->pvaData[index].numGetReadings == 0) {
         pva->pvaData[index].nonnumeric = true;
       }
@@ -782,26 +1782,147 @@ long ExtractScalarValue(PVA_OVERALL *pva, long index, epics::pvData::PVFieldPtr
       pva->pvaData[index].numGetReadings++;
     }
   }
-  return (0);
+  return (0);
+}
+
+long ExtractNTScalarValue(PVA_OVERALL *pva, long index, epics::pvData::PVStructurePtr pvStructurePtr, bool monitorMode) {
+  long j, fieldCount;
+  epics::pvData::PVFieldPtrArray PVFieldPtrArray;
+  std::string fieldName;
+  PVFieldPtrArray = pvStructurePtr->getPVFields();
+  fieldCount = pvStructurePtr->getStructure()->getNumberFields();
+  for (j = 0; j < fieldCount; j++) {
+    fieldName = PVFieldPtrArray[j]->getFieldName();
+    if (fieldName == "value") {
+      if (ExtractScalarValue(pva, index, PVFieldPtrArray[j], monitorMode)) {
+        return (1);
+      }
+      return (0);
+    }
+  }
+  std::cerr << "ERROR: Value field is missing." << std::endl;
+  return (1);
+}
+
+/*
+  Copy a numeric scalar array into a buffer of its native type, padding with zeros.
+*/
+template <typename T>
+static void CopyNativeArray(PVA_OVERALL *pva, epics::pvData::PVScalarArrayPtr pvScalarArrayPtr, PVA_DATA *data, long count) {
+  typename epics::pvData::shared_vector<const T> dataVector;
+  long have, copyCount;
+  pvScalarArrayPtr->PVScalarArray::getAs<T>(dataVector);
+  if (data->nativeValues == NULL) {
+    data->nativeValues = PVAArenaAlloc(pva, sizeof(T) * count);
+  }
+  have = dataVector.size();
+  copyCount = (count < have ? count : have);
+  if (copyCount > 0) {
+    memcpy(data->nativeValues, dataVector.data(), sizeof(T) * copyCount);
+  }
+  if (copyCount < count) {
+    memset((T *)data->nativeValues + copyCount, 0, sizeof(T) * (count - copyCount));
+  }
+  data->valuesStale = true;
+}
+
+static void CopyNativeArray(PVA_OVERALL *pva, epics::pvData::PVScalarArrayPtr pvScalarArrayPtr, epics::pvData::ScalarType scalarType, PVA_DATA *data, long count) {
+  switch (scalarType) {
+  case epics::pvData::pvDouble:
+    CopyNativeArray<double>(pva, pvScalarArrayPtr, data, count);
+    break;
+  case epics::pvData::pvFloat:
+    CopyNativeArray<float>(pva, pvScalarArrayPtr, data, count);
+    break;
+  case epics::pvData::pvLong:
+    CopyNativeArray<int64_t>(pva, pvScalarArrayPtr, data, count);
+    break;
+  case epics::pvData::pvULong:
+    CopyNativeArray<uint64_t>(pva, pvScalarArrayPtr, data, count);
+    break;
+  case epics::pvData::pvInt:
+    CopyNativeArray<int32_t>(pva, pvScalarArrayPtr, data, count);
+    break;
+  case epics::pvData::pvUInt:
+    CopyNativeArray<uint32_t>(pva, pvScalarArrayPtr, data, count);
+    break;
+  case epics::pvData::pvShort:
+    CopyNativeArray<int16_t>(pva, pvScalarArrayPtr, data, count);
+    break;
+  case epics::pvData::pvUShort:
+    CopyNativeArray<uint16_t>(pva, pvScalarArrayPtr, data, count);
+    break;
+  default:
+    break;
+  }
+}
+
+template <typename T>
+static void ConvertNativeArray(PVA_DATA *data, long count) {
+  const T *native = (const T *)data->nativeValues;
+  for (long k = 0; k < count; k++) {
+    data->values[k] = (double)native[k];
+  }
 }
 
-long ExtractNTScalarValue(PVA_OVERALL *pva, long index, epics::pvData::PVStructurePtr pvStructurePtr, bool monitorMode) {
-  long j, fieldCount;
-  epics::pvData::PVFieldPtrArray PVFieldPtrArray;
-  std::string fieldName;
-  PVFieldPtrArray = pvStructurePtr->getPVFields();
-  fieldCount = pvStructurePtr->getStructure()->getNumberFields();
-  for (j = 0; j < fieldCount; j++) {
-    fieldName = PVFieldPtrArray[j]->getFieldName();
-    if (fieldName == "value") {
-      if (ExtractScalarValue(pva, index, PVFieldPtrArray[j], monitorMode)) {
-        return (1);
-      }
-      return (0);
+/*
+  Return the native buffer of a PV reading kept with useNativeValues, or NULL if the reading
+  is stored as doubles. The element type is given by pvaData[index].scalarType.
+*/
+void *GetPVANativeValues(PVA_OVERALL *pva, long index, long reading, bool monitorMode) {
+  PVA_DATA *data;
+  data = monitorMode ? &(pva->pvaData[index].monitorData[0]) : &(pva->pvaData[index].getData[reading]);
+  return data->nativeValues;
+}
+
+/*
+  Return the readings of a numeric PV as doubles. Readings kept in their native type are
+  converted the first time this is called after they change.
+*/
+double *GetPVADoubleValues(PVA_OVERALL *pva, long index, long reading, bool monitorMode) {
+  PVA_DATA *data;
+  long count;
+  data = monitorMode ? &(pva->pvaData[index].monitorData[0]) : &(pva->pvaData[index].getData[reading]);
+  if (data->nativeValues == NULL) {
+    return data->values;
+  }
+  count = monitorMode ? pva->pvaData[index].numMonitorElements : pva->pvaData[index].numGetElements;
+  if (data->values == NULL) {
+    data->values = (double *)PVAArenaAlloc(pva, sizeof(double) * count);
+    data->valuesStale = true;
+  }
+  if (data->valuesStale) {
+    switch (pva->pvaData[index].scalarType) {
+    case epics::pvData::pvDouble:
+      ConvertNativeArray<double>(data, count);
+      break;
+    case epics::pvData::pvFloat:
+      ConvertNativeArray<float>(data, count);
+      break;
+    case epics::pvData::pvLong:
+      ConvertNativeArray<int64_t>(data, count);
+      break;
+    case epics::pvData::pvULong:
+      ConvertNativeArray<uint64_t>(data, count);
+      break;
+    case epics::pvData::pvInt:
+      ConvertNativeArray<int32_t>(data, count);
+      break;
+    case epics::pvData::pvUInt:
+      ConvertNativeArray<uint32_t>(data, count);
+      break;
+    case epics::pvData::pvShort:
+      ConvertNativeArray<int16_t>(data, count);
+      break;
+    case epics::pvData::pvUShort:
+      ConvertNativeArray<uint16_t>(data, count);
+      break;
+    default:
+      break;
     }
+    data->valuesStale = false;
   }
-  std::cerr << "ERROR: Value field is missing." << std::endl;
-  return (1);
+  return data->values;
 }
 
 long ExtractScalarArrayValue(PVA_OVERALL *pva, long index, epics::pvData::PVFieldPtr PVFieldPtr, bool monitorMode) {
@@ -817,13 +1938,6 @@ long ExtractScalarArrayValue(PVA_OVERALL *pva, long index, epics::pvData::PVFiel
       pva->pvaData[index].fieldType = scalarArrayConstPtr->getType(); //should always be epics::pvData::scalar
       pva->pvaData[index].scalarType = scalarArrayConstPtr->getElementType();
       pva->pvaData[index].numMonitorElements = GetElementCountFromNelm(pva, index, pvScalarArrayPtr->getLength());
-    } else {
-      if (pva->pvaData[index].nonnumeric) {
-        for (long k = 0; k < pva->pvaData[index].numMonitorElements; k++) {
-          if (pva->pvaData[index].monitorData[0].stringValues[k])
-            free(pva->pvaData[index].monitorData[0].stringValues[k]);
-        }
-      }
     }
   } else {
     i = pva->pvaData[index].numGetReadings;
@@ -844,11 +1958,21 @@ long ExtractScalarArrayValue(PVA_OVERALL *pva, long index, epics::pvData::PVFiel
   case epics::pvData::pvUInt:
   case epics::pvData::pvShort:
   case epics::pvData::pvUShort: {
+    if (pva->pvaData[index].useNativeValues) {
+      //Keep the readings in their native type and convert only if GetPVADoubleValues is called
+      pva->pvaData[index].numeric = true;
+      if (monitorMode) {
+        CopyNativeArray(pva, pvScalarArrayPtr, pva->pvaData[index].scalarType, &(pva->pvaData[index].monitorData[0]), pva->pvaData[index].numMonitorElements);
+      } else {
+        CopyNativeArray(pva, pvScalarArrayPtr, pva->pvaData[index].scalarType, &(pva->pvaData[index].getData[i]), pva->pvaData[index].numGetElements);
+      }
+      break;
+    }
     epics::pvData::PVDoubleArray::const_svector dataVector;
     pvScalarArrayPtr->PVScalarArray::getAs<double>(dataVector);
     if (monitorMode) {
       if (pva->pvaData[index].monitorData[0].values == NULL) {
-        pva->pvaData[index].monitorData[0].values = (double *)malloc(sizeof(double) * pva->pvaData[index].numMonitorElements);
+        pva->pvaData[index].monitorData[0].values = (double *)PVAArenaAlloc(pva, sizeof(double) * pva->pvaData[index].numMonitorElements);
         pva->pvaData[index].numeric = true;
       }
       long count = pva->pvaData[index].numMonitorElements;
@@ -861,7 +1985,7 @@ long ExtractScalarArrayValue(PVA_OVERALL *pva, long index, epics::pvData::PVFiel
       }
     } else {
       if (pva->pvaData[index].getData[i].values == NULL) {
-        pva->pvaData[index].getData[i].values = (double *)malloc(sizeof(double) * pva->pvaData[index].numGetElements);
+        pva->pvaData[index].getData[i].values = (double *)PVAArenaAlloc(pva, sizeof(double) * pva->pvaData[index].numGetElements);
         pva->pvaData[index].numeric = true;
       }
       long count = pva->pvaData[index].numGetElements;
@@ -887,7 +2011,7 @@ long ExtractScalarArrayValue(PVA_OVERALL *pva, long index, epics::pvData::PVFiel
     }
     if (monitorMode) {
       if (pva->pvaData[index].monitorData[0].values == NULL) {
-        pva->pvaData[index].monitorData[0].values = (double *)malloc(sizeof(double) * nLength);
+        pva->pvaData[index].monitorData[0].values = (double *)PVAArenaAlloc(pva, sizeof(double) * nLength);
         pva->pvaData[index].numeric = true;
       }
       std::copy(dataVector.begin(), dataVector.end(), pva->pvaData[index].monitorData[0].values);
@@ -896,7 +2020,7 @@ long ExtractScalarArrayValue(PVA_OVERALL *pva, long index, epics::pvData::PVFiel
       }
     } else {
       if (pva->pvaData[index].getData[i].values == NULL) {
-        pva->pvaData[index].getData[i].values = (double *)malloc(sizeof(double) * nLength);
+        pva->pvaData[index].getData[i].values = (double *)PVAArenaAlloc(pva, sizeof(double) * nLength);
         pva->pvaData[index].numeric = true;
       }
       std::copy(dataVector.begin(), dataVector.end(), pva->pvaData[index].getData[i].values);
@@ -921,35 +2045,31 @@ long ExtractScalarArrayValue(PVA_OVERALL *pva, long index, epics::pvData::PVFiel
     pvScalarArrayPtr->PVScalarArray::getAs<std::string>(dataVector);
     if (monitorMode) {
       if (pva->pvaData[index].monitorData[0].stringValues == NULL) {
-        pva->pvaData[index].monitorData[0].stringValues = (char **)malloc(sizeof(char *) * pva->pvaData[index].numMonitorElements);
+        pva->pvaData[index].monitorData[0].stringValues = PVAArenaStringArray(pva, pva->pvaData[index].numMonitorElements);
         pva->pvaData[index].nonnumeric = true;
       }
       long count = pva->pvaData[index].numMonitorElements;
       long have = dataVector.size();
       long copyCount = (count < have ? count : have);
       for (long k = 0; k < copyCount; k++) {
-        pva->pvaData[index].monitorData[0].stringValues[k] = (char *)malloc(sizeof(char) * (dataVector[k].length() + 1));
-        strcpy(pva->pvaData[index].monitorData[0].stringValues[k], dataVector[k].c_str());
+        pva->pvaData[index].monitorData[0].stringValues[k] = PVAArenaStrcpy(pva, pva->pvaData[index].monitorData[0].stringValues[k], dataVector[k].c_str(), dataVector[k].length());
       }
       for (long k = copyCount; k < count; k++) {
-        pva->pvaData[index].monitorData[0].stringValues[k] = (char *)malloc(sizeof(char));
-        pva->pvaData[index].monitorData[0].stringValues[k][0] = 0;
+        pva->pvaData[index].monitorData[0].stringValues[k] = PVAArenaStrcpy(pva, pva->pvaData[index].monitorData[0].stringValues[k], "", 0);
       }
     } else {
       if (pva->pvaData[index].getData[i].stringValues == NULL) {
-        pva->pvaData[index].getData[i].stringValues = (char **)malloc(sizeof(char *) * pva->pvaData[index].numGetElements);
+        pva->pvaData[index].getData[i].stringValues = PVAArenaStringArray(pva, pva->pvaData[index].numGetElements);
         pva->pvaData[index].nonnumeric = true;
       }
       long count = pva->pvaData[index].numGetElements;
       long have = dataVector.size();
       long copyCount = (count < have ? count : have);
       for (long k = 0; k < copyCount; k++) {
-        pva->pvaData[index].getData[i].stringValues[k] = (char *)malloc(sizeof(char) * (dataVector[k].length() + 1));
-        strcpy(pva->pvaData[index].getData[i].stringValues[k], dataVector[k].c_str());
+        pva->pvaData[index].getData[i].stringValues[k] = PVAArenaStrcpy(pva, pva->pvaData[index].getData[i].stringValues[k], dataVector[k].c_str(), dataVector[k].length());
       }
       for (long k = copyCount; k < count; k++) {
-        pva->pvaData[index].getData[i].stringValues[k] = (char *)malloc(sizeof(char));
-        pva->pvaData[index].getData[i].stringValues[k][0] = 0;
+        pva->pvaData[index].getData[i].stringValues[k] = PVAArenaStrcpy(pva, pva->pvaData[index].getData[i].stringValues[k], "", 0);
       }
     }
     break;
@@ -1265,7 +2385,7 @@ long ExtractNTScalarArrayValue(PVA_OVERALL *pva, long index, epics::pvData::PVSt
 }
 
 long ExtractNTEnumValue(PVA_OVERALL *pva, long index, epics::pvData::PVStructurePtr pvStructurePtr, bool monitorMode) {
-  long i, j, fieldCount;
+  long j, fieldCount;
   epics::pvData::PVFieldPtrArray PVFieldPtrArray;
   std::string fieldName;
   PVFieldPtrArray = pvStructurePtr->getPVFields();
@@ -1273,66 +2393,73 @@ long ExtractNTEnumValue(PVA_OVERALL *pva, long index, epics::pvData::PVStructure
   for (j = 0; j < fieldCount; j++) {
     fieldName = PVFieldPtrArray[j]->getFieldName();
     if (fieldName == "value") {
-      epics::pvData::PVStructurePtr pvStructurePtr;
-      epics::pvData::PVEnumerated pvEnumerated;
-      std::string s;
-      pvStructurePtr = std::tr1::static_pointer_cast<epics::pvData::PVStructure>(PVFieldPtrArray[j]);
-      pvEnumerated.attach(pvStructurePtr);
-      if (monitorMode) {
-        if (pva->pvaData[index].numMonitorReadings == 0) {
-          pva->pvaData[index].fieldType = pvStructurePtr->getField()->getType(); //should always be epics::pvData::structure
-          pva->pvaData[index].pvEnumeratedStructure = true;
-          pva->pvaData[index].numMonitorElements = 1;
-          pva->pvaData[index].numeric = true;
-          pva->pvaData[index].nonnumeric = true;
-          pva->pvaData[index].scalarType = epics::pvData::pvString;
-          pva->pvaData[index].monitorData[0].values = (double *)malloc(sizeof(double));
-          pva->pvaData[index].monitorData[0].stringValues = (char **)malloc(sizeof(char *) * 1);
-        } else {
-          if (pva->pvaData[index].monitorData[0].stringValues[0])
-            free(pva->pvaData[index].monitorData[0].stringValues[0]);
-        }
-        pva->pvaData[index].monitorData[0].values[0] = pvEnumerated.getIndex();
-        s = pvEnumerated.getChoice();
-        pva->pvaData[index].monitorData[0].stringValues[0] = (char *)malloc(sizeof(char) * (s.length() + 1));
-        strcpy(pva->pvaData[index].monitorData[0].stringValues[0], s.c_str());
-        pva->pvaData[index].numMonitorReadings = 1;
-      } else {
-        i = pva->pvaData[index].numGetReadings;
-        if (pva->pvaData[index].numGetReadings == 0) {
-          pva->pvaData[index].fieldType = pvStructurePtr->getField()->getType(); //should always be epics::pvData::structure
-          pva->pvaData[index].pvEnumeratedStructure = true;
-          pva->pvaData[index].numGetElements = 1;
-          pva->pvaData[index].numeric = true;
-          pva->pvaData[index].nonnumeric = true;
-          pva->pvaData[index].scalarType = epics::pvData::pvString;
-        } else if (pva->limitGetReadings) {
-          i = 0;
-        }
-        if (pva->pvaData[index].getData[i].values == NULL) {
-          pva->pvaData[index].getData[i].values = (double *)malloc(sizeof(double));
-        }
-        if (pva->pvaData[index].getData[i].stringValues == NULL) {
-          pva->pvaData[index].getData[i].stringValues = (char **)malloc(sizeof(char *) * 1);
-        }
-        pva->pvaData[index].getData[i].values[0] = pvEnumerated.getIndex();
-        s = pvEnumerated.getChoice();
-        pva->pvaData[index].getData[i].stringValues[0] = (char *)malloc(sizeof(char) * (s.length() + 1));
-        strcpy(pva->pvaData[index].getData[i].stringValues[0], s.c_str());
-        if (pva->limitGetReadings) {
-          pva->pvaData[index].numGetReadings = 1;
-        } else {
-          pva->pvaData[index].numGetReadings++;
-        }
-      }
-      pvEnumerated.detach();
-      return (0);
+      return ExtractEnumeratedValue(pva, index, PVFieldPtrArray[j], monitorMode);
     }
   }
   std::cerr << "ERROR: Value field is missing." << std::endl;
   return (1);
 }
 
+/*
+  Extract the index and choice of an enumerated value structure.
+*/
+static long ExtractEnumeratedValue(PVA_OVERALL *pva, long index, epics::pvData::PVFieldPtr PVFieldPtr, bool monitorMode) {
+  long i;
+  epics::pvData::PVStructurePtr pvStructurePtr;
+  epics::pvData::PVEnumerated pvEnumerated;
+  std::string s;
+  pvStructurePtr = std::tr1::static_pointer_cast<epics::pvData::PVStructure>(PVFieldPtr);
+  pvEnumerated.attach(pvStructurePtr);
+  if (monitorMode) {
+    if (pva->pvaData[index].numMonitorReadings == 0) {
+      pva->pvaData[index].fieldType = pvStructurePtr->getField()->getType(); //should always be epics::pvData::structure
+      pva->pvaData[index].pvEnumeratedStructure = true;
+      pva->pvaData[index].numMonitorElements = 1;
+      pva->pvaData[index].numeric = true;
+      pva->pvaData[index].nonnumeric = true;
+      pva->pvaData[index].scalarType = epics::pvData::pvString;
+      if (pva->pvaData[index].monitorData[0].values == NULL) {
+        pva->pvaData[index].monitorData[0].values = (double *)PVAArenaAlloc(pva, sizeof(double));
+      }
+      if (pva->pvaData[index].monitorData[0].stringValues == NULL) {
+        pva->pvaData[index].monitorData[0].stringValues = PVAArenaStringArray(pva, 1);
+      }
+    }
+    pva->pvaData[index].monitorData[0].values[0] = pvEnumerated.getIndex();
+    s = pvEnumerated.getChoice();
+    pva->pvaData[index].monitorData[0].stringValues[0] = PVAArenaStrcpy(pva, pva->pvaData[index].monitorData[0].stringValues[0], s.c_str(), s.length());
+    pva->pvaData[index].numMonitorReadings = 1;
+  } else {
+    i = pva->pvaData[index].numGetReadings;
+    if (pva->pvaData[index].numGetReadings == 0) {
+      pva->pvaData[index].fieldType = pvStructurePtr->getField()->getType(); //should always be epics::pvData::structure
+      pva->pvaData[index].pvEnumeratedStructure = true;
+      pva->pvaData[index].numGetElements = 1;
+      pva->pvaData[index].numeric = true;
+      pva->pvaData[index].nonnumeric = true;
+      pva->pvaData[index].scalarType = epics::pvData::pvString;
+    } else if (pva->limitGetReadings) {
+      i = 0;
+    }
+    if (pva->pvaData[index].getData[i].values == NULL) {
+      pva->pvaData[index].getData[i].values = (double *)PVAArenaAlloc(pva, sizeof(double));
+    }
+    if (pva->pvaData[index].getData[i].stringValues == NULL) {
+      pva->pvaData[index].getData[i].stringValues = PVAArenaStringArray(pva, 1);
+    }
+    pva->pvaData[index].getData[i].values[0] = pvEnumerated.getIndex();
+    s = pvEnumerated.getChoice();
+    pva->pvaData[index].getData[i].stringValues[0] = PVAArenaStrcpy(pva, pva->pvaData[index].getData[i].stringValues[0], s.c_str(), s.length());
+    if (pva->limitGetReadings) {
+      pva->pvaData[index].numGetReadings = 1;
+    } else {
+      pva->pvaData[index].numGetReadings++;
+    }
+  }
+  pvEnumerated.detach();
+  return (0);
+}
+
 long ExtractStructureValue(PVA_OVERALL *pva, long index, epics::pvData::PVFieldPtr PVFieldPtr, bool monitorMode) {
   long fieldCount;
   epics::pvData::PVFieldPtrArray PVFieldPtrArray;
@@ -1558,179 +2685,261 @@ long ExtractPVAValuesOld(PVA_OVERALL *pva) {
   return (0);
 }
 
-long ExtractPVAValues(PVA_OVERALL *pva) {
-  long i, j;
+/*
+  Extract the get result of PV i. It only writes the PV's own pvaData[i] slot.
+*/
+static long ExtractPVAValue(PVA_OVERALL *pva, long i) {
+  long j;
   std::string id;
   bool monitorMode = false;
   epics::pvData::PVStructurePtr pvStructurePtr;
   epics::pvData::PVFieldPtr pvFieldPtr;
   std::string afterDot;
 
-  for (i = 0; i < pva->numPVs; i++) {
-    if (pva->pvaData[i].skip == true) {
-      continue;
-    }
-    if (pva->isConnected[i]) {
-      pvStructurePtr = pva->pvaClientGetPtr[i]->getData()->getPVStructure();
-      id = pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getStructure()->getID();
-      if (id == "epics:nt/NTScalar:1.0") {
-        if (ExtractNTScalarValue(pva, i, pvStructurePtr, monitorMode)) {
-          return (1);
-        }
-      } else if (id == "epics:nt/NTScalarArray:1.0") {
-        if (ExtractNTScalarArrayValue(pva, i, pvStructurePtr, monitorMode)) {
-          return (1);
-        }
-      } else if (id == "epics:nt/NTEnum:1.0") {
-        if (ExtractNTEnumValue(pva, i, pvStructurePtr, monitorMode)) {
-          return (1);
-        }
-      } else if (id == "structure") {
-        epics::pvData::PVFieldPtrArray PVFieldPtrArray;
-        long fieldCount;
-        PVFieldPtrArray = pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getPVFields();
-        fieldCount = pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getStructure()->getNumberFields();
-        if (fieldCount == 0) {
-          fprintf(stderr, "Error: sub-field does not exist for %s\n", pva->pvaChannelNames[i].c_str());
-          return (1);
-        }
-        if (fieldCount > 1) {
-          if (PVFieldPtrArray[0]->getFieldName() != "value") {
-            size_t pos = pva->pvaChannelNames[i].find('.');
-            if (pos != std::string::npos) {
-              afterDot = pva->pvaChannelNames[i].substr(pos + 1);
-            } else {
-              pva->pvaClientGetPtr[i]->getData()->getPVStructure()->dumpValue(std::cerr);
-              fprintf(stderr, "Error: sub-field is not specific enough\n");
+  if (pva->pvaData[i].skip == true) {
+    return (0);
+  }
+  if (pva->isConnected[i]) {
+    pvStructurePtr = pva->pvaClientGetPtr[i]->getData()->getPVStructure();
+    id = pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getStructure()->getID();
+    if (id == "epics:nt/NTScalar:1.0") {
+      if (ExtractNTScalarValue(pva, i, pvStructurePtr, monitorMode)) {
+        return (1);
+      }
+    } else if (id == "epics:nt/NTScalarArray:1.0") {
+      if (ExtractNTScalarArrayValue(pva, i, pvStructurePtr, monitorMode)) {
+        return (1);
+      }
+    } else if (id == "epics:nt/NTEnum:1.0") {
+      if (ExtractNTEnumValue(pva, i, pvStructurePtr, monitorMode)) {
+        return (1);
+      }
+    } else if (id == "structure") {
+      epics::pvData::PVFieldPtrArray PVFieldPtrArray;
+      long fieldCount;
+      PVFieldPtrArray = pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getPVFields();
+      fieldCount = pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getStructure()->getNumberFields();
+      if (fieldCount == 0) {
+        fprintf(stderr, "Error: sub-field does not exist for %s\n", pva->pvaChannelNames[i].c_str());
+        return (1);
+      }
+      if (fieldCount > 1) {
+        if (PVFieldPtrArray[0]->getFieldName() != "value") {
+          size_t pos = pva->pvaChannelNames[i].find('.');
+          if (pos != std::string::npos) {
+            afterDot = pva->pvaChannelNames[i].substr(pos + 1);
+          } else {
+            pva->pvaClientGetPtr[i]->getData()->getPVStructure()->dumpValue(std::cerr);
+            fprintf(stderr, "Error: sub-field is not specific enough\n");
+            return (1);
+          }
+          pvFieldPtr =  pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot);
+          if (pvFieldPtr == NULL) {
+            fprintf(stderr, "Error: sub-field does not exist for %s\n", pva->pvaChannelNames[i].c_str());
+            return (1);
+          }
+          if (afterDot.find_first_of("[(@") != std::string::npos) {
+            if (ExtractByPath(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure(), afterDot, monitorMode)) {
               return (1);
             }
-            pvFieldPtr =  pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot);
-            if (pvFieldPtr == NULL) {
-              fprintf(stderr, "Error: sub-field does not exist for %s\n", pva->pvaChannelNames[i].c_str());
+            return (0);
+          }
+          switch (pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot)->getField()->getType()) {
+          case epics::pvData::scalar: {
+            if (ExtractScalarValue(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot), monitorMode)) {
               return (1);
             }
-            if (afterDot.find_first_of("[(@") != std::string::npos) {
-              if (ExtractByPath(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure(), afterDot, monitorMode)) {
-                return (1);
-              }
-              continue;
-            }
-            switch (pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot)->getField()->getType()) {
-            case epics::pvData::scalar: {
-              if (ExtractScalarValue(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot), monitorMode)) {
-                return (1);
-              }
-              break;
-            }
-            case epics::pvData::scalarArray: {
-              if (ExtractScalarArrayValue(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot), monitorMode)) {
-                return (1);
-              }
-              break;
-            }
-            case epics::pvData::structure: {
-              if (ExtractStructureValue(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot), monitorMode)) {
-                return (1);
-              }
-              break;
-            }
-            case epics::pvData::union_: {
-              if (ExtractUnionValue(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot), monitorMode)) {
-                return (1);
-              }
-              break;
-            }
-            case epics::pvData::structureArray: {
-              std::cerr << "Error: structureArray requires an index and a member (e.g. dimension[0].size, dimension(0).size, or dimension@0.size)" << std::endl;
+            break;
+          }
+          case epics::pvData::scalarArray: {
+            if (ExtractScalarArrayValue(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot), monitorMode)) {
               return (1);
             }
-            default: {
-              std::cerr << "ERROR: Need code to handle " << pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot)->getField()->getType() << std::endl;
+            break;
+          }
+          case epics::pvData::structure: {
+            if (ExtractStructureValue(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot), monitorMode)) {
               return (1);
             }
+            break;
+          }
+          case epics::pvData::union_: {
+            if (ExtractUnionValue(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot), monitorMode)) {
+              return (1);
             }
-            continue;
+            break;
           }
-        }
-        switch (PVFieldPtrArray[0]->getField()->getType()) {
-        case epics::pvData::scalar: {
-          if (ExtractScalarValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
+          case epics::pvData::structureArray: {
+            std::cerr << "Error: structureArray requires an index and a member (e.g. dimension[0].size, dimension(0).size, or dimension@0.size)" << std::endl;
             return (1);
           }
-          break;
-        }
-        case epics::pvData::scalarArray: {
-          if (ExtractScalarArrayValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
+          default: {
+            std::cerr << "ERROR: Need code to handle " << pva->pvaClientGetPtr[i]->getData()->getPVStructure()->getSubField(afterDot)->getField()->getType() << std::endl;
             return (1);
           }
-          break;
-        }
-        case epics::pvData::structure: {
-          if (ExtractStructureValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
-            return (1);
           }
-          break;
+          return (0);
         }
-        case epics::pvData::union_: {
-          if (ExtractUnionValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
-            return (1);
-          }
-          break;
+      }
+      switch (PVFieldPtrArray[0]->getField()->getType()) {
+      case epics::pvData::scalar: {
+        if (ExtractScalarValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
+          return (1);
         }
-        case epics::pvData::structureArray: {
-          size_t pos = pva->pvaChannelNames[i].find('.');
-          if (pos != std::string::npos) {
-            afterDot = pva->pvaChannelNames[i].substr(pos + 1);
-            if (ExtractByPath(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure(), afterDot, monitorMode)) {
-              return (1);
-            }
-            break;
-          }
-          std::cerr << "Error: structureArray requires an index and a member (e.g. dimension[0].size, dimension(0).size, or dimension@0.size)" << std::endl;
+        break;
+      }
+      case epics::pvData::scalarArray: {
+        if (ExtractScalarArrayValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
           return (1);
         }
-        default: {
-          std::cerr << "ERROR: Need code to handle " << PVFieldPtrArray[0]->getField()->getType() << std::endl;
+        break;
+      }
+      case epics::pvData::structure: {
+        if (ExtractStructureValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
           return (1);
         }
+        break;
+      }
+      case epics::pvData::union_: {
+        if (ExtractUnionValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
+          return (1);
         }
-        if (pva->includeAlarmSeverity && (fieldCount > 1)) {
-          for (j = 0; j < fieldCount; j++) {
-            if (PVFieldPtrArray[j]->getFieldName() == "alarm") {
-              if (PVFieldPtrArray[j]->getField()->getType() == epics::pvData::structure) {
-                epics::pvData::PVStructurePtr alarmStructurePtr;
-                epics::pvData::PVFieldPtrArray AlarmFieldPtrArray;
-                long alarmFieldCount;
+        break;
+      }
+      case epics::pvData::structureArray: {
+        size_t pos = pva->pvaChannelNames[i].find('.');
+        if (pos != std::string::npos) {
+          afterDot = pva->pvaChannelNames[i].substr(pos + 1);
+          if (ExtractByPath(pva, i, pva->pvaClientGetPtr[i]->getData()->getPVStructure(), afterDot, monitorMode)) {
+            return (1);
+          }
+          break;
+        }
+        std::cerr << "Error: structureArray requires an index and a member (e.g. dimension[0].size, dimension(0).size, or dimension@0.size)" << std::endl;
+        return (1);
+      }
+      default: {
+        std::cerr << "ERROR: Need code to handle " << PVFieldPtrArray[0]->getField()->getType() << std::endl;
+        return (1);
+      }
+      }
+      if (pva->includeAlarmSeverity && (fieldCount > 1)) {
+        for (j = 0; j < fieldCount; j++) {
+          if (PVFieldPtrArray[j]->getFieldName() == "alarm") {
+            if (PVFieldPtrArray[j]->getField()->getType() == epics::pvData::structure) {
+              epics::pvData::PVStructurePtr alarmStructurePtr;
+              epics::pvData::PVFieldPtrArray AlarmFieldPtrArray;
+              long alarmFieldCount;
 
-                alarmStructurePtr = std::tr1::static_pointer_cast<epics::pvData::PVStructure>(PVFieldPtrArray[j]);
-                alarmFieldCount = alarmStructurePtr->getStructure()->getNumberFields();
-                AlarmFieldPtrArray = alarmStructurePtr->getPVFields();
-                if (alarmFieldCount > 0) {
-                  if (AlarmFieldPtrArray[0]->getFieldName() == "severity") {
-                    epics::pvData::PVScalarPtr pvScalarPtr;
-                    pvScalarPtr = std::tr1::static_pointer_cast<epics::pvData::PVScalar>(AlarmFieldPtrArray[0]);
-                    pva->pvaData[i].alarmSeverity = pvScalarPtr->getAs<int>();
-                  } else {
-                    pva->pvaClientGetPtr[i]->getData()->getPVStructure()->dumpValue(std::cerr);
-                    fprintf(stderr, "Error: alarm->severity field is not where it was expected to be\n");
-                    return (1);
-                  }
+              alarmStructurePtr = std::tr1::static_pointer_cast<epics::pvData::PVStructure>(PVFieldPtrArray[j]);
+              alarmFieldCount = alarmStructurePtr->getStructure()->getNumberFields();
+              AlarmFieldPtrArray = alarmStructurePtr->getPVFields();
+              if (alarmFieldCount > 0) {
+                if (AlarmFieldPtrArray[0]->getFieldName() == "severity") {
+                  epics::pvData::PVScalarPtr pvScalarPtr;
+                  pvScalarPtr = std::tr1::static_pointer_cast<epics::pvData::PVScalar>(AlarmFieldPtrArray[0]);
+                  pva->pvaData[i].alarmSeverity = pvScalarPtr->getAs<int>();
+                } else {
+                  pva->pvaClientGetPtr[i]->getData()->getPVStructure()->dumpValue(std::cerr);
+                  fprintf(stderr, "Error: alarm->severity field is not where it was expected to be\n");
+                  return (1);
                 }
               }
-              break;
             }
+            break;
           }
         }
-      } else {
+      }
+    } else {
 #ifdef DEBUG
-        pva->pvaClientGetPtr[i]->getData()->getPVStructure()->dumpValue(std::cerr);
+      pva->pvaClientGetPtr[i]->getData()->getPVStructure()->dumpValue(std::cerr);
 #endif
-        std::cerr << "Error: unrecognized structure ID (" << id << ")" << std::endl;
+      std::cerr << "Error: unrecognized structure ID (" << id << ")" << std::endl;
+      return (1);
+    }
+  }
+  return (0);
+}
+
+/*
+  True when extracting PV i only copies numbers into the buffers filled in by an earlier
+  extraction. Anything else may look up NELM over the network, allocate from the arena,
+  copy strings or resize the byte array and is left to the calling thread.
+*/
+static bool PVAExtractIsCopyOnly(PVA_OVERALL *pva, long i) {
+  PVA_DATA_ALL_READINGS *data = &(pva->pvaData[i]);
+  if (!pva->limitGetReadings || (data->numGetReadings == 0) || !data->numeric || data->nonnumeric ||
+      data->pvEnumeratedStructure) {
+    return (false);
+  }
+  if ((data->fieldType == epics::pvData::scalarArray) &&
+      ((data->scalarType == epics::pvData::pvByte) || (data->scalarType == epics::pvData::pvUByte))) {
+    return (false);
+  }
+  return (true);
+}
+
+/*
+  Extract the results of the last GetPVAValues call into pvaData. With extractThreads > 1
+  the PVs that still need setup (see PVAExtractIsCopyOnly) are extracted first on the
+  calling thread, then the remaining PVs are split into contiguous ranges of at least
+  PVA_EXTRACT_MIN_RANGE PVs, one per worker thread. A failure stops the other workers, and
+  an exception thrown by a worker is rethrown here, as it would be by the serial loop.
+*/
+long ExtractPVAValues(PVA_OVERALL *pva) {
+  long i, numThreads;
+  std::vector<long> copyOnly;
+  std::vector<std::thread> threads;
+  std::atomic<bool> failed(false);
+
+  numThreads = pva->numPVs / PVA_EXTRACT_MIN_RANGE;
+  if (numThreads > pva->extractThreads) {
+    numThreads = pva->extractThreads;
+  }
+  for (i = 0; i < pva->numPVs; i++) {
+    if ((numThreads > 1) && pva->isConnected[i] && !pva->pvaData[i].skip && PVAExtractIsCopyOnly(pva, i)) {
+      copyOnly.push_back(i);
+    } else if (ExtractPVAValue(pva, i)) {
+      return (1);
+    }
+  }
+  numThreads = copyOnly.size() / PVA_EXTRACT_MIN_RANGE;
+  if (numThreads > pva->extractThreads) {
+    numThreads = pva->extractThreads;
+  }
+  if (numThreads <= 1) {
+    for (i = 0; i < (long)copyOnly.size(); i++) {
+      if (ExtractPVAValue(pva, copyOnly[i])) {
         return (1);
       }
     }
+    return (0);
   }
-  return (0);
+  std::vector<std::exception_ptr> errors(numThreads);
+  for (long t = 0; t < numThreads; t++) {
+    threads.push_back(std::thread([pva, t, numThreads, &copyOnly, &errors, &failed]() {
+      long first = t * copyOnly.size() / numThreads, last = (t + 1) * copyOnly.size() / numThreads;
+      try {
+        for (long k = first; (k < last) && !failed; k++) {
+          if (ExtractPVAValue(pva, copyOnly[k])) {
+            failed = true;
+          }
+        }
+      } catch (...) {
+        errors[t] = std::current_exception();
+        failed = true;
+      }
+    }));
+  }
+  for (long t = 0; t < numThreads; t++) {
+    threads[t].join();
+  }
+  for (long t = 0; t < numThreads; t++) {
+    if (errors[t]) {
+      std::rethrow_exception(errors[t]);
+    }
+  }
+  return (failed ? 1 : 0);
 }
 
 long count_chars(char *string, char c) {
@@ -2148,29 +3357,47 @@ long PrepPut(PVA_OVERALL *pva, long index, char **value, long length) {
   Put the values from the pva structure and send them to the PVs. See cavput.cc for an example on how to populate this pva structure.
 */
 long PutPVAValues(PVA_OVERALL *pva) {
-  long i, j, num = 0;
+  long i, j, num = 0, failed = 0, pending;
+  double issueTime, now;
   std::string id;
   epics::pvData::Status status;
   epics::pvaClient::PvaClientChannelArray pvaClientChannelArray;
 
-  pva->isInternalConnected = pva->pvaClientMultiChannelPtr[0]->getIsConnected();
-  pvaClientChannelArray = pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray();
-  for (i = 1; i < pva->numMultiChannels; i++) {
-    epics::pvData::shared_vector<epics::pvData::boolean> isConnected;
-    epics::pvaClient::PvaClientChannelArray pvaClientChannelArrayAdd;
-    isConnected = pva->pvaClientMultiChannelPtr[i]->getIsConnected();
-    std::copy(isConnected.begin(), isConnected.end(), std::back_inserter(pva->isInternalConnected));
-    pvaClientChannelArrayAdd = pva->pvaClientMultiChannelPtr[i]->getPvaClientChannelArray();
-    std::copy(pvaClientChannelArrayAdd.begin(), pvaClientChannelArrayAdd.end(), std::back_inserter(pvaClientChannelArray));
+  if (pva->pipelinePuts && (pva->useGetCallbacks == false)) {
+    if (!pva->putCompletion) {
+      pva->putCompletion.reset(new PVA_PUT_COMPLETION);
+    }
+    epics::pvData::Lock guard(pva->putCompletion->mutex);
+    pva->putCompletion->done.assign(pva->numPVs, false);
+    pva->putCompletion->doneTime.assign(pva->numPVs, 0);
+    pva->putCompletion->active.resize(pva->numPVs, false);
+    pva->putCompletion->requesters.resize(pva->numPVs);
+    for (i = 0; i < pva->numPVs; i++) {
+      if (pva->putCompletion->active[i]) {
+        //The put timed out last time and is still active, so issuePut would throw. Start over with a new put.
+        pva->pvaClientPutPtr[i].reset();
+        pva->pvaData[i].havePutPtr = false;
+        pva->putCompletion->requesters[i].reset();
+        pva->putCompletion->active[i] = false;
+      }
+    }
   }
+
+  CollectPVAChannels(pva, pvaClientChannelArray);
   for (i = 0; i < pva->numPVs; i++) {
     if (pva->pvaData[i].skip == true) {
       continue;
     }
     pva->isConnected[i] = pva->isInternalConnected[pva->pvaData[i].L2Ptr];
+    pva->pvaData[i].putStatus = PVA_PUT_NONE;
+    pva->pvaData[i].putLatency = -1;
     if (pva->isConnected[i] == false) {
       if (pva->pvaData[i].numPutElements > 0) {
+        //Nothing is put unless every PV with a value is connected, with or without pipelinePuts
         fprintf(stderr, "Error: Can't put value to %s. Not connected.\n", pva->pvaChannelNames[i].c_str());
+        if (pva->pipelinePuts) {
+          pva->pvaData[i].putStatus = PVA_PUT_FAILED;
+        }
         return (1);
       }
       num++;
@@ -2179,6 +3406,8 @@ long PutPVAValues(PVA_OVERALL *pva) {
       pva->pvaData[i].havePutPtr = true;
       if (pva->useGetCallbacks) {
         pva->pvaClientPutPtr[i]->setRequester((epics::pvaClient::PvaClientPutRequesterPtr)pva->putReqPtr);
+      } else if (pva->pipelinePuts) {
+        SetPutCompletionRequester(pva, i);
       }
     }
   }
@@ -2265,16 +3494,83 @@ long PutPVAValues(PVA_OVERALL *pva) {
     }
   }
 
+  issueTime = MonotonicSeconds();
   for (i = 0; i < pva->numPVs; i++) {
     if (pva->pvaData[i].skip == true) {
       continue;
     }
     if (pva->pvaData[i].numPutElements > 0) {
-      pva->pvaClientPutPtr[i]->issuePut();
+      if (pva->pipelinePuts && (pva->useGetCallbacks == false)) {
+        epics::pvData::Lock guard(pva->putCompletion->mutex);
+        pva->putCompletion->active[i] = true;
+      }
+      try {
+        pva->pvaClientPutPtr[i]->issuePut();
+      } catch (std::exception &e) {
+        fprintf(stderr, "error: unable to put %s: %s\n", pva->pvaChannelNames[i].c_str(), e.what());
+        if (pva->pipelinePuts == false) {
+          return (1);
+        }
+        if (pva->useGetCallbacks == false) {
+          epics::pvData::Lock guard(pva->putCompletion->mutex);
+          pva->putCompletion->active[i] = false;
+        }
+        pva->pvaData[i].putStatus = PVA_PUT_FAILED;
+        failed++;
+      }
     }
   }
 
-  if (pva->useGetCallbacks == false) {
+  if (pva->pipelinePuts && (pva->useGetCallbacks == false)) {
+    /*
+      Wait for all outstanding puts at once against a single deadline so the total time is
+      set by the slowest IOC rather than the sum of the round trips.
+    */
+    while (1) {
+      double deadline = pva->putTimeout > 0 ? issueTime + pva->putTimeout : -1;
+      pending = 0;
+      now = MonotonicSeconds();
+      for (i = 0; i < pva->numPVs; i++) {
+        if ((pva->pvaData[i].skip == true) || (pva->pvaData[i].numPutElements <= 0) ||
+            (pva->pvaData[i].putStatus != PVA_PUT_NONE)) {
+          continue;
+        }
+        bool done;
+        double doneTime;
+        {
+          epics::pvData::Lock guard(pva->putCompletion->mutex);
+          done = pva->putCompletion->done[i];
+          doneTime = pva->putCompletion->doneTime[i];
+        }
+        if (done) {
+          //The put has completed so waitPut returns immediately with its status
+          status = pva->pvaClientPutPtr[i]->waitPut();
+          if (!status.isSuccess()) {
+            fprintf(stderr, "error: %s did not respond to the \"put\" request\n", pva->pvaChannelNames[i].c_str());
+            pva->pvaData[i].putStatus = PVA_PUT_FAILED;
+            failed++;
+          } else {
+            pva->pvaData[i].putStatus = PVA_PUT_OK;
+            pva->pvaData[i].putLatency = doneTime - issueTime;
+          }
+        } else if ((pva->putTimeout > 0) && (now >= issueTime + pva->putTimeout)) {
+          fprintf(stderr, "error: %s did not respond to the \"put\" request\n", pva->pvaChannelNames[i].c_str());
+          pva->pvaData[i].putStatus = PVA_PUT_TIMEOUT;
+          failed++;
+        } else {
+          pending++;
+        }
+      }
+      if (pending == 0) {
+        break;
+      }
+      if (deadline < 0) {
+        pva->putCompletion->event.wait();
+      } else {
+        pva->putCompletion->event.wait(deadline - now);
+      }
+    }
+  } else if (pva->useGetCallbacks == false) {
     for (i = 0; i < pva->numPVs; i++) {
       if (pva->pvaData[i].skip == true) {
         continue;
@@ -2301,6 +3597,9 @@ long PutPVAValues(PVA_OVERALL *pva) {
       pva->pvaData[i].numPutElements = 0;
     }
   }
+  if (failed) {
+    return (1);
+  }
   return (0);
 }
 
@@ -2309,7 +3608,7 @@ long PutPVAValues(PVA_OVERALL *pva) {
   FIX THIS There is a unique problem of what to do with PVs that are not connected when the program starts but become connected later
 */
 long MonitorPVAValues(PVA_OVERALL *pva) {
-  long i, num;
+  long i, num, queueSize;
   epics::pvData::Status status;
   epics::pvaClient::PvaClientChannelArray pvaClientChannelArray;
 
@@ -2317,16 +3616,16 @@ long MonitorPVAValues(PVA_OVERALL *pva) {
     return (0);
   }
   num = 0;
-  pva->isInternalConnected = pva->pvaClientMultiChannelPtr[0]->getIsConnected();
-  pvaClientChannelArray = pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray();
-  for (i = 1; i < pva->numMultiChannels; i++) {
-    epics::pvData::shared_vector<epics::pvData::boolean> isConnected;
-    epics::pvaClient::PvaClientChannelArray pvaClientChannelArrayAdd;
-    isConnected = pva->pvaClientMultiChannelPtr[i]->getIsConnected();
-    std::copy(isConnected.begin(), isConnected.end(), std::back_inserter(pva->isInternalConnected));
-    pvaClientChannelArrayAdd = pva->pvaClientMultiChannelPtr[i]->getPvaClientChannelArray();
-    std::copy(pvaClientChannelArrayAdd.begin(), pvaClientChannelArrayAdd.end(), std::back_inserter(pvaClientChannelArray));
+  //The list is also needed without useMonitorReadyList so the monitor callbacks can wake WaitAnyMonitoredPVA
+  if (!pva->monitorReadyList) {
+    pva->monitorReadyList.reset(new PVA_MONITOR_READY_LIST);
+    pva->monitorReadyList->waiter = NULL;
   }
+  if (pva->useMonitorReadyList) {
+    epics::pvData::Lock guard(pva->monitorReadyList->mutex);
+    pva->monitorReadyList->queued.resize(pva->numPVs, false);
+  }
+  CollectPVAChannels(pva, pvaClientChannelArray);
   for (i = 0; i < pva->numPVs; i++) {
     if (pva->pvaData[i].skip == true) {
       continue;
@@ -2334,11 +3633,23 @@ long MonitorPVAValues(PVA_OVERALL *pva) {
     pva->isConnected[i] = pva->isInternalConnected[pva->pvaData[i].L2Ptr];
     if (pva->isConnected[i]) {
       if (pva->pvaData[i].haveMonitorPtr == false) {
-        pva->pvaClientMonitorPtr[i] = pvaClientChannelArray[pva->pvaData[i].L2Ptr]->createMonitor(pva->pvaChannelNamesSub[i]);
-        pva->pvaData[i].haveMonitorPtr = true;
-        if (pva->useMonitorCallbacks) {
-          pva->pvaClientMonitorPtr[i]->setRequester((epics::pvaClient::PvaClientMonitorRequesterPtr)pva->monitorReqPtr);
+        queueSize = pva->monitorQueueSize;
+        if (pva->pvaData[i].monitorRequestQueueSize > 0) {
+          queueSize = pva->pvaData[i].monitorRequestQueueSize;
         }
+        if (queueSize > 0) {
+          //Ask the server to queue updates as well so none are dropped between polls
+          std::string request = "record[queueSize=" + std::to_string(queueSize) + "]";
+          if (pva->pvaChannelNamesSub[i].length() > 0) {
+            request += "field(" + pva->pvaChannelNamesSub[i] + ")";
+          }
+          pva->pvaClientMonitorPtr[i] = pvaClientChannelArray[pva->pvaData[i].L2Ptr]->createMonitor(request);
+        } else {
+          pva->pvaClientMonitorPtr[i] = pvaClientChannelArray[pva->pvaData[i].L2Ptr]->createMonitor(pva->pvaChannelNamesSub[i]);
+        }
+        pva->pvaData[i].haveMonitorPtr = true;
+        pva->pvaData[i].monitorExtractor = PVA_MONITOR_EXTRACT_UNRESOLVED;
+        SetReadyListMonitorRequester(pva, i);
         pva->pvaClientMonitorPtr[i]->issueConnect();
         status = pva->pvaClientMonitorPtr[i]->waitConnect();
         if (!status.isSuccess()) {
@@ -2416,16 +3727,18 @@ long PollMonitoredPVA(PVA_OVERALL *pva) {
 /* Returns number of events found or -1 for error
  */
 long PollMonitoredPVA(PVA_OVERALL **pva, long count) {
-  long result = 0, i, n;
-  std::string id;
-  bool monitorMode = true, connectionChange = false;
-  epics::pvData::PVStructurePtr pvStructurePtr;
+  long result = 0, i, k, n;
+  bool connectionChange = false;
 
   for (n = 0; n < count; n++) {
     if (pva[n] != NULL) {
+      double start = MonotonicSeconds();
       //A PV which was initially unconnected may have connected and we need to start monitoring it
+      if (PVAShardsChanged(pva[n])) {
+        connectionChange = true;
+      }
       for (i = 0; i < pva[n]->numMultiChannels; i++) {
-        if (pva[n]->pvaClientMultiChannelPtr[i]->connectionChange()) {
+        if (PVAShardReady(pva[n], i) && pva[n]->pvaClientMultiChannelPtr[i]->connectionChange()) {
           connectionChange = true;
         }
       }
@@ -2436,135 +3749,326 @@ long PollMonitoredPVA(PVA_OVERALL **pva, long count) {
         connectionChange = false;
       }
 
-      for (long i = 0; i < pva[n]->numPVs; i++) {
+      if (pva[n]->useMonitorReadyList && pva[n]->monitorReadyList) {
+        //Only visit the PVs whose monitor callbacks fired since the last poll
+        std::vector<long> ready, notConnected;
+        {
+          epics::pvData::Lock guard(pva[n]->monitorReadyList->mutex);
+          ready.swap(pva[n]->monitorReadyList->ready);
+          for (k = 0; k < (long)ready.size(); k++) {
+            pva[n]->monitorReadyList->queued[ready[k]] = false;
+          }
+        }
+        for (k = 0; k < (long)ready.size(); k++) {
+          i = ready[k];
+          if ((i >= pva[n]->numPVs) || (pva[n]->pvaData[i].skip == true)) {
+            continue;
+          }
+          if (pva[n]->isConnected[i] == false) {
+            //The event arrived before MonitorPVAValues saw the PV connect, keep it for a later poll
+            notConnected.push_back(i);
+            continue;
+          }
+          if (pva[n]->pvaClientMonitorPtr[i]->poll()) {
+            result++;
+            //Drain any queued events. The latest reading is left in monitorData and
+            //every reading is kept in the monitor queue when monitorQueueSize is set.
+            do {
+              if (ExtractMonitorEvent(pva[n], i)) {
+                return (-1);
+              }
+              pva[n]->pvaClientMonitorPtr[i]->releaseEvent();
+            } while (pva[n]->pvaClientMonitorPtr[i]->poll());
+          }
+        }
+        if (notConnected.size()) {
+          epics::pvData::Lock guard(pva[n]->monitorReadyList->mutex);
+          for (k = 0; k < (long)notConnected.size(); k++) {
+            i = notConnected[k];
+            if ((i < (long)pva[n]->monitorReadyList->queued.size()) && (pva[n]->monitorReadyList->queued[i] == false)) {
+              pva[n]->monitorReadyList->queued[i] = true;
+              pva[n]->monitorReadyList->ready.push_back(i);
+            }
+          }
+        }
+        pva[n]->extractTime += MonotonicSeconds() - start;
+        continue;
+      }
+
+      for (i = 0; i < pva[n]->numPVs; i++) {
         if (pva[n]->pvaData[i].skip == true) {
           continue;
         }
         if (pva[n]->isConnected[i]) {
           if (pva[n]->pvaClientMonitorPtr[i]->poll()) {
             result++;
-            pvStructurePtr = pva[n]->pvaClientMonitorPtr[i]->getData()->getPVStructure();
-            id = pvStructurePtr->getStructure()->getID();
-            if (id == "epics:nt/NTScalar:1.0") {
-              if (ExtractNTScalarValue(pva[n], i, pvStructurePtr, monitorMode)) {
-                return (-1);
-              }
-            } else if (id == "epics:nt/NTScalarArray:1.0") {
-              if (ExtractNTScalarArrayValue(pva[n], i, pvStructurePtr, monitorMode)) {
-                return (-1);
-              }
-            } else if (id == "epics:nt/NTEnum:1.0") {
-              if (ExtractNTEnumValue(pva[n], i, pvStructurePtr, monitorMode)) {
-                return (-1);
-              }
-            } else if (id == "structure") {
-              epics::pvData::PVFieldPtrArray PVFieldPtrArray;
-              long fieldCount;
-              PVFieldPtrArray = pvStructurePtr->getPVFields();
-              fieldCount = pvStructurePtr->getStructure()->getNumberFields();
-              if (fieldCount > 1) {
-                if (PVFieldPtrArray[0]->getFieldName() != "value") {
-                  pvStructurePtr->dumpValue(std::cerr);
-                  fprintf(stderr, "Error: sub-field is not specific enough\n");
-                  return (-1);
-                }
-              }
-              switch (PVFieldPtrArray[0]->getField()->getType()) {
-              case epics::pvData::scalar: {
-                if (ExtractScalarValue(pva[n], i, PVFieldPtrArray[0], monitorMode)) {
-                  return (-1);
-                }
-                break;
-              }
-              case epics::pvData::scalarArray: {
-                if (ExtractScalarArrayValue(pva[n], i, PVFieldPtrArray[0], monitorMode)) {
-                  return (-1);
-                }
-                break;
-              }
-              case epics::pvData::structure: {
-                if (ExtractStructureValue(pva[n], i, PVFieldPtrArray[0], monitorMode)) {
-                  return (-1);
-                }
-                break;
-              }
-              default: {
-                std::cerr << "ERROR: Need code to handle " << PVFieldPtrArray[0]->getField()->getType() << std::endl;
+            do {
+              if (ExtractMonitorEvent(pva[n], i)) {
                 return (-1);
               }
-              }
-            }
-            pva[n]->pvaClientMonitorPtr[i]->releaseEvent();
+              pva[n]->pvaClientMonitorPtr[i]->releaseEvent();
+            } while ((pva[n]->monitorQueueSize > 0) && (pva[n]->pvaClientMonitorPtr[i]->poll()));
           }
         }
       }
+      pva[n]->extractTime += MonotonicSeconds() - start;
+    }
+  }
+  return result;
+}
+
+/*
+  Register event as the waiter of the ready-list of each PVA structure, or clear it with NULL.
+*/
+static void SetMonitorReadyWaiter(PVA_OVERALL **pva, long count, epics::pvData::Event *event) {
+  long n;
+
+  for (n = 0; n < count; n++) {
+    if ((pva[n] != NULL) && pva[n]->monitorReadyList) {
+      epics::pvData::Lock guard(pva[n]->monitorReadyList->mutex);
+      pva[n]->monitorReadyList->waiter = event;
     }
   }
+}
+
+/*
+  Block until a monitor event arrives on any of the PVA structures, or until secondsToWait
+  has elapsed, and then extract the new values. The monitor callbacks wake this call with
+  or without useMonitorReadyList; the ready-list only saves visiting every PV on the poll.
+  Returns number of events found or -1 for error
+*/
+long WaitAnyMonitoredPVA(PVA_OVERALL *pva, double secondsToWait) {
+  long result;
+  PVA_OVERALL **pvaArray;
+  pvaArray = (PVA_OVERALL **)malloc(sizeof(PVA_OVERALL *));
+  pvaArray[0] = pva;
+  result = WaitAnyMonitoredPVA(pvaArray, 1, secondsToWait);
+  free(pvaArray);
+  return (result);
+}
+
+long WaitAnyMonitoredPVA(PVA_OVERALL **pva, long count, double secondsToWait) {
+  long result;
+  epics::pvData::Event event;
+
+  //Only the monitor callbacks of these PVA structures wake this call. Events arriving after
+  //the event is registered signal it, so none are lost between the poll and the wait.
+  SetMonitorReadyWaiter(pva, count, &event);
+  result = PollMonitoredPVA(pva, count);
+  if ((result == 0) && (secondsToWait > 0)) {
+    event.wait(secondsToWait);
+    result = PollMonitoredPVA(pva, count);
+  }
+  SetMonitorReadyWaiter(pva, count, NULL);
   return result;
 }
 
+/*
+  Resolve which extractor handles the monitor data of a PV and the offset of the field it
+  is given. The result is cached in pvaData[index] because the introspection interface does
+  not change for the lifetime of a monitor.
+*/
+static long ResolveMonitorExtractor(PVA_OVERALL *pva, long index, epics::pvData::PVStructurePtr pvStructurePtr) {
+  std::string id;
+  epics::pvData::PVFieldPtrArray PVFieldPtrArray;
+  epics::pvData::PVFieldPtr pvFieldPtr;
+  long j, fieldCount;
+  int extractor = PVA_MONITOR_EXTRACT_IGNORE;
+
+  id = pvStructurePtr->getStructure()->getID();
+  PVFieldPtrArray = pvStructurePtr->getPVFields();
+  fieldCount = pvStructurePtr->getStructure()->getNumberFields();
+  if ((id == "epics:nt/NTScalar:1.0") || (id == "epics:nt/NTScalarArray:1.0") || (id == "epics:nt/NTEnum:1.0")) {
+    for (j = 0; j < fieldCount; j++) {
+      if (PVFieldPtrArray[j]->getFieldName() == "value") {
+        pvFieldPtr = PVFieldPtrArray[j];
+        break;
+      }
+    }
+    if (!pvFieldPtr) {
+      std::cerr << "ERROR: Value field is missing." << std::endl;
+      return (1);
+    }
+    if (id == "epics:nt/NTScalar:1.0") {
+      extractor = PVA_MONITOR_EXTRACT_SCALAR;
+    } else if (id == "epics:nt/NTScalarArray:1.0") {
+      extractor = PVA_MONITOR_EXTRACT_SCALARARRAY;
+    } else {
+      extractor = PVA_MONITOR_EXTRACT_ENUM;
+    }
+  } else if (id == "structure") {
+    if (fieldCount > 1) {
+      if (PVFieldPtrArray[0]->getFieldName() != "value") {
+        pvStructurePtr->dumpValue(std::cerr);
+        fprintf(stderr, "Error: sub-field is not specific enough\n");
+        return (1);
+      }
+    }
+    pvFieldPtr = PVFieldPtrArray[0];
+    switch (pvFieldPtr->getField()->getType()) {
+    case epics::pvData::scalar: {
+      extractor = PVA_MONITOR_EXTRACT_SCALAR;
+      break;
+    }
+    case epics::pvData::scalarArray: {
+      extractor = PVA_MONITOR_EXTRACT_SCALARARRAY;
+      break;
+    }
+    case epics::pvData::structure: {
+      extractor = PVA_MONITOR_EXTRACT_STRUCTURE;
+      break;
+    }
+    default: {
+      std::cerr << "ERROR: Need code to handle " << pvFieldPtr->getField()->getType() << std::endl;
+      return (1);
+    }
+    }
+  }
+  pva->pvaData[index].monitorExtractor = extractor;
+  pva->monitorStructure[index] = pvStructurePtr->getStructure();
+  pva->pvaData[index].monitorFieldOffset = pvFieldPtr ? pvFieldPtr->getFieldOffset() : 0;
+  return (0);
+}
+
+/*
+  Extract the data from the current monitor event of a PV. The caller is responsible for
+  calling poll() before and releaseEvent() after.
+*/
+static long ExtractMonitorEvent(PVA_OVERALL *pva, long index) {
+  bool monitorMode = true;
+  epics::pvData::PVStructurePtr pvStructurePtr;
+  epics::pvData::PVFieldPtr pvFieldPtr;
+
+  pvStructurePtr = pva->pvaClientMonitorPtr[index]->getData()->getPVStructure();
+  //Re-resolve if the structure changed, which can happen after a reconnect
+  if ((pva->pvaData[index].monitorExtractor == PVA_MONITOR_EXTRACT_UNRESOLVED) ||
+      (pva->monitorStructure[index] != pvStructurePtr->getStructure())) {
+    if (ResolveMonitorExtractor(pva, index, pvStructurePtr)) {
+      return (1);
+    }
+  }
+  if (pva->pvaData[index].monitorExtractor == PVA_MONITOR_EXTRACT_IGNORE) {
+    return (0);
+  }
+  pvFieldPtr = pvStructurePtr->getSubField(pva->pvaData[index].monitorFieldOffset);
+  switch (pva->pvaData[index].monitorExtractor) {
+  case PVA_MONITOR_EXTRACT_SCALAR:
+    if (ExtractScalarValue(pva, index, pvFieldPtr, monitorMode)) {
+      return (1);
+    }
+    break;
+  case PVA_MONITOR_EXTRACT_SCALARARRAY:
+    if (ExtractScalarArrayValue(pva, index, pvFieldPtr, monitorMode)) {
+      return (1);
+    }
+    break;
+  case PVA_MONITOR_EXTRACT_ENUM:
+    if (ExtractEnumeratedValue(pva, index, pvFieldPtr, monitorMode)) {
+      return (1);
+    }
+    break;
+  case PVA_MONITOR_EXTRACT_STRUCTURE:
+    if (ExtractStructureValue(pva, index, pvFieldPtr, monitorMode)) {
+      return (1);
+    }
+    break;
+  }
+  if (pva->monitorQueueSize > 0) {
+    QueueMonitorReading(pva, index, pvStructurePtr);
+  }
+  return (0);
+}
+
+/*
+  Append the latest numeric scalar monitor reading to the PV's ring. When the ring is
+  full the oldest reading is overwritten and monitorQueueOverflows is incremented. Overruns
+  reported by the server are counted as overflows too. Array PVs are not queued since the
+  ring holds one value per reading.
+*/
+static void QueueMonitorReading(PVA_OVERALL *pva, long index, epics::pvData::PVStructurePtr pvStructurePtr) {
+  PVA_DATA_ALL_READINGS *data = &(pva->pvaData[index]);
+  epics::pvData::PVLongPtr secondsPtr;
+  epics::pvData::PVIntPtr nanosecondsPtr;
+  epics::pvData::BitSetPtr overrunBitSet;
+  long slot;
+  double timeStamp;
+
+  if ((data->numeric == false) || (data->numMonitorElements != 1) || (data->fieldType == epics::pvData::scalarArray) ||
+      (data->monitorData[0].values == NULL)) {
+    return;
+  }
+  if (data->monitorQueueValues == NULL) {
+    data->monitorQueueValues = (double *)PVAArenaAlloc(pva, sizeof(double) * pva->monitorQueueSize);
+    data->monitorQueueTimes = (double *)PVAArenaAlloc(pva, sizeof(double) * pva->monitorQueueSize);
+    data->monitorQueueHead = 0;
+    data->monitorQueueCount = 0;
+  }
+  secondsPtr = pvStructurePtr->getSubField<epics::pvData::PVLong>("timeStamp.secondsPastEpoch");
+  nanosecondsPtr = pvStructurePtr->getSubField<epics::pvData::PVInt>("timeStamp.nanoseconds");
+  if (secondsPtr && nanosecondsPtr) {
+    timeStamp = secondsPtr->get() + nanosecondsPtr->get() * 1e-9;
+  } else {
+    //The request did not include the time stamp, use the time the event was received
+    epics::pvData::TimeStamp now;
+    now.getCurrent();
+    timeStamp = now.toSeconds();
+  }
+  overrunBitSet = pva->pvaClientMonitorPtr[index]->getData()->getOverrunBitSet();
+  if (overrunBitSet && (overrunBitSet->nextSetBit(0) >= 0)) {
+    data->monitorQueueOverflows++;
+  }
+  if (data->monitorQueueCount == pva->monitorQueueSize) {
+    data->monitorQueueHead = (data->monitorQueueHead + 1) % pva->monitorQueueSize;
+    data->monitorQueueCount--;
+    data->monitorQueueOverflows++;
+  }
+  slot = (data->monitorQueueHead + data->monitorQueueCount) % pva->monitorQueueSize;
+  data->monitorQueueValues[slot] = data->monitorData[0].values[0];
+  data->monitorQueueTimes[slot] = timeStamp;
+  data->monitorQueueCount++;
+}
+
+/*
+  Copy up to maxReadings queued monitor readings of a PV, oldest first, and remove them
+  from the queue. Either output array may be NULL.
+  Returns the number of readings copied.
+*/
+long DrainPVAMonitorQueue(PVA_OVERALL *pva, long index, double *values, double *timeStamps, long maxReadings) {
+  PVA_DATA_ALL_READINGS *data;
+  long i, n;
+
+  if ((pva == NULL) || (pva->monitorQueueSize <= 0)) {
+    return (0);
+  }
+  data = &(pva->pvaData[index]);
+  n = data->monitorQueueCount;
+  if (n > maxReadings) {
+    n = maxReadings;
+  }
+  for (i = 0; i < n; i++) {
+    if (values) {
+      values[i] = data->monitorQueueValues[data->monitorQueueHead];
+    }
+    if (timeStamps) {
+      timeStamps[i] = data->monitorQueueTimes[data->monitorQueueHead];
+    }
+    data->monitorQueueHead = (data->monitorQueueHead + 1) % pva->monitorQueueSize;
+  }
+  data->monitorQueueCount -= n;
+  return (n);
+}
+
 /*
   Wait for an event on a monitored PV and place the data into the pva structure.
   result: -1 no event, 0 event, 1 error
 */
 long WaitEventMonitoredPVA(PVA_OVERALL *pva, long index, double secondsToWait) {
   long result = -1;
-  std::string id;
-  bool monitorMode = true;
-  epics::pvData::PVStructurePtr pvStructurePtr;
   for (long i = index; i <= index; i++) {
     if (pva->isConnected[i]) {
       if (pva->pvaClientMonitorPtr[i]->waitEvent(secondsToWait)) {
-        pvStructurePtr = pva->pvaClientMonitorPtr[i]->getData()->getPVStructure();
-        id = pvStructurePtr->getStructure()->getID();
-        if (id == "epics:nt/NTScalar:1.0") {
-          if (ExtractNTScalarValue(pva, i, pvStructurePtr, monitorMode)) {
-            return (1);
-          }
-        } else if (id == "epics:nt/NTScalarArray:1.0") {
-          if (ExtractNTScalarArrayValue(pva, i, pvStructurePtr, monitorMode)) {
-            return (1);
-          }
-        } else if (id == "epics:nt/NTEnum:1.0") {
-          if (ExtractNTEnumValue(pva, i, pvStructurePtr, monitorMode)) {
-            return (1);
-          }
-        } else if (id == "structure") {
-          epics::pvData::PVFieldPtrArray PVFieldPtrArray;
-          long fieldCount;
-          PVFieldPtrArray = pvStructurePtr->getPVFields();
-          fieldCount = pvStructurePtr->getStructure()->getNumberFields();
-          if (fieldCount > 1) {
-            if (PVFieldPtrArray[0]->getFieldName() != "value") {
-              pvStructurePtr->dumpValue(std::cerr);
-              fprintf(stderr, "Error: sub-field is not specific enough\n");
-              return (1);
-            }
-          }
-          switch (PVFieldPtrArray[0]->getField()->getType()) {
-          case epics::pvData::scalar: {
-            if (ExtractScalarValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
-              return (1);
-            }
-            break;
-          }
-          case epics::pvData::scalarArray: {
-            if (ExtractScalarArrayValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
-              return (1);
-            }
-            break;
-          }
-          case epics::pvData::structure: {
-            if (ExtractStructureValue(pva, i, PVFieldPtrArray[0], monitorMode)) {
-              return (1);
-            }
-            break;
-          }
-          default: {
-            std::cerr << "ERROR: Need code to handle " << PVFieldPtrArray[0]->getField()->getType() << std::endl;
-            return (1);
-          }
-          }
+        if (ExtractMonitorEvent(pva, i)) {
+          return (1);
         }
         pva->pvaClientMonitorPtr[i]->releaseEvent();
         result = 0;
@@ -2597,8 +4101,7 @@ long ExtractPVAUnits(PVA_OVERALL *pva) {
             if (PVFieldPtrArray2[n]->getFieldName() == "units") {
               pvScalarPtr = std::tr1::static_pointer_cast<epics::pvData::PVScalar>(PVFieldPtrArray2[n]);
               s = pvScalarPtr->getAs<std::string>();
-              pva->pvaData[i].units = (char *)malloc(sizeof(char) * (s.length() + 1));
-              strcpy(pva->pvaData[i].units, s.c_str());
+              pva->pvaData[i].units = PVAArenaStrcpy(pva, pva->pvaData[i].units, s.c_str(), s.length());
               break;
             }
           }
@@ -2613,12 +4116,12 @@ long ExtractPVAUnits(PVA_OVERALL *pva) {
 std::string GetProviderName(PVA_OVERALL *pva, long index) {
   if (pva->isConnected[index] == false)
     return "unknown";
-  return pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray()[pva->pvaData[index].L2Ptr]->getChannel()->getProvider()->getProviderName();
+  return GetPVAChannel(pva, index)->getChannel()->getProvider()->getProviderName();
 }
 std::string GetRemoteAddress(PVA_OVERALL *pva, long index) {
   if (pva->isConnected[index] == false)
     return "unknown";
-  return pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray()[pva->pvaData[index].L2Ptr]->getChannel()->getRemoteAddress();
+  return GetPVAChannel(pva, index)->getChannel()->getRemoteAddress();
 }
 bool HaveReadAccess(PVA_OVERALL *pva, long index) {
   epics::pvData::PVStructurePtr pvStructurePtr;
@@ -2629,7 +4132,7 @@ bool HaveReadAccess(PVA_OVERALL *pva, long index) {
     pvStructurePtr = pva->pvaClientGetPtr[index]->getData()->getPVStructure();
     fieldCount = pvStructurePtr->getStructure()->getNumberFields();
     if (fieldCount > 0) {
-      value = pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray()[pva->pvaData[index].L2Ptr]->getChannel()->getAccessRights(pvStructurePtr->getPVFields()[0]);
+      value = GetPVAChannel(pva, index)->getChannel()->getAccessRights(pvStructurePtr->getPVFields()[0]);
       if ((value == 1) || (value == 2))
         return true;
     }
@@ -2642,7 +4145,7 @@ bool HaveReadAccess(PVA_OVERALL *pva, long index) {
     return false;
     provider = GetProviderName(pva, index);
     if (provider == "ca") {
-    caChan = std::dynamic_pointer_cast<epics::pvAccess::ca::CAChannel>(pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray()[pva->pvaData[index].L2Ptr]->getChannel());
+    caChan = std::dynamic_pointer_cast<epics::pvAccess::ca::CAChannel>(GetPVAChannel(pva, index)->getChannel());
     if (ca_read_access(caChan->getChannelID()) == 0)
     return false;
     else
@@ -2661,7 +4164,7 @@ bool HaveWriteAccess(PVA_OVERALL *pva, long index) {
     pvStructurePtr = pva->pvaClientGetPtr[index]->getData()->getPVStructure();
     fieldCount = pvStructurePtr->getStructure()->getNumberFields();
     if (fieldCount > 0) {
-      value = pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray()[pva->pvaData[index].L2Ptr]->getChannel()->getAccessRights(pvStructurePtr->getPVFields()[0]);
+      value = GetPVAChannel(pva, index)->getChannel()->getAccessRights(pvStructurePtr->getPVFields()[0]);
       if (value == 2)
         return true;
     }
@@ -2674,7 +4177,7 @@ bool HaveWriteAccess(PVA_OVERALL *pva, long index) {
     epics::pvAccess::ca::CAChannel::shared_pointer caChan;
     provider = GetProviderName(pva, index);
     if (provider == "ca") {
-    caChan = std::dynamic_pointer_cast<epics::pvAccess::ca::CAChannel>(pva->pvaClientMultiChannelPtr[0]->getPvaClientChannelArray()[pva->pvaData[index].L2Ptr]->getChannel());
+    caChan = std::dynamic_pointer_cast<epics::pvAccess::ca::CAChannel>(GetPVAChannel(pva, index)->getChannel());
     if (ca_write_access(caChan->getChannelID()) == 0)
     return false;
     else